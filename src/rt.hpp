@@ -4,8 +4,12 @@
 #define RT_HPP_
 
 #include "rt_engine.hpp"
+#include "rt_texture_cache.hpp"
 #include "rt_timer.hpp"
+#include "rt_frame_pacer.hpp"
 #include "rt_input.hpp"
+#include "rt_capture.hpp"
+#include "rt_profiler.hpp"
 
 #endif // !defined(RT_HPP_)
 
@@ -0,0 +1,162 @@
+//! Aligned memory arena implementation file
+
+#ifndef RT_ARENA_HPP_
+#define RT_ARENA_HPP_
+
+#include <cstdlib>
+
+#include "rt_common.hpp"
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#elif defined(_WIN32)
+#include <malloc.h>
+#endif
+
+namespace rt {
+    /// Single growable memory block with cache-line alignment, backed by huge pages where possible.
+    /// Block is reused while requested size fits into it, contents are not preserved on growth.
+    class memory_arena {
+    public:
+
+        /// Alignment of the block (and granularity of `align`)
+        constexpr static std::size_t ALIGNMENT = 64;
+
+        /// Huge page size (the most common one, 2 MiB)
+        constexpr static std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+        /// Round size up to alignment
+        static constexpr std::size_t align(std::size_t size) noexcept {
+            return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        }
+
+        /// Construct empty arena
+        memory_arena(bool use_huge_pages = true) noexcept:
+            use_huge_pages(use_huge_pages)
+        {
+        }
+
+        /// Arena is not copyable
+        memory_arena(const memory_arena &) = delete;
+        memory_arena & operator=(const memory_arena &) = delete;
+
+        /// Arena destructor
+        ~memory_arena() {
+            release();
+        }
+
+        /// Get block of at least `size` bytes, null on allocation failure (current block stays valid then).
+        /// New block is allocated before the current one is released.
+        std::byte * reserve(std::size_t size) {
+            if (size <= capacity)
+                return data;
+
+            const block new_block = allocate(align(size));
+            if (new_block.data == nullptr)
+                return nullptr;
+
+            release();
+            data = new_block.data;
+            capacity = new_block.capacity;
+            is_huge = new_block.is_huge;
+            return data;
+        }
+
+        /// Get current block
+        std::byte * get_data() const noexcept {
+            return data;
+        }
+
+        /// Get current block size
+        std::size_t get_capacity() const noexcept {
+            return capacity;
+        }
+
+        /// Check if current block is backed by explicitly reserved huge pages
+        bool get_is_huge() const noexcept {
+            return is_huge;
+        }
+
+    private:
+
+        /// Allocated memory block
+        struct block {
+            /// Block memory (null if allocation failed)
+            std::byte *data = nullptr;
+
+            /// Block size
+            std::size_t capacity = 0;
+
+            /// True if block is backed by explicit huge pages
+            bool is_huge = false;
+        };
+
+        /// Allocate block of aligned size
+        block allocate(std::size_t size) const {
+#if defined(__linux__)
+            // Explicit huge pages are used only if the system has them reserved, transparent ones are requested otherwise
+            void *memory = MAP_FAILED;
+            std::size_t mapped_size = size;
+            bool is_huge_block = false;
+
+            if (use_huge_pages && size >= HUGE_PAGE_SIZE) {
+                mapped_size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+                memory = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+                is_huge_block = memory != MAP_FAILED;
+            }
+
+            if (memory == MAP_FAILED) {
+                mapped_size = size;
+                memory = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (memory == MAP_FAILED)
+                    return block {};
+
+                if (use_huge_pages)
+                    madvise(memory, mapped_size, MADV_HUGEPAGE);
+            }
+
+            return block {static_cast<std::byte *>(memory), mapped_size, is_huge_block};
+#elif defined(_WIN32)
+            // MSVC runtime has no std::aligned_alloc
+            std::byte *memory = static_cast<std::byte *>(_aligned_malloc(size, ALIGNMENT));
+            return block {memory, memory != nullptr ? size : 0, false};
+#else
+            std::byte *memory = static_cast<std::byte *>(std::aligned_alloc(ALIGNMENT, size));
+            return block {memory, memory != nullptr ? size : 0, false};
+#endif
+        }
+
+        /// Release current block
+        void release() noexcept {
+            if (data == nullptr)
+                return;
+
+#if defined(__linux__)
+            munmap(data, capacity);
+#elif defined(_WIN32)
+            _aligned_free(data);
+#else
+            std::free(data);
+#endif
+            data = nullptr;
+            capacity = 0;
+            is_huge = false;
+        }
+
+        /// Try to use huge pages
+        bool use_huge_pages;
+
+        /// True if block is backed by explicit huge pages
+        bool is_huge = false;
+
+        /// Current block
+        std::byte *data = nullptr;
+
+        /// Current block size
+        std::size_t capacity = 0;
+    };
+}
+
+#endif // !defined(RT_ARENA_HPP_)
+
+// rt_arena.hpp
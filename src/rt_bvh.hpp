@@ -0,0 +1,469 @@
+//! Bounding volume hierarchy implementation file
+
+#ifndef RT_BVH_HPP_
+#define RT_BVH_HPP_
+
+#include <bit>
+
+#include "rt_shape_common.hpp"
+
+namespace rt {
+    /// Bounding volume hierarchy over set of primitive bounding boxes
+    class bvh {
+    public:
+
+        /// Hierarchy node
+        struct node {
+            /// Node bounding box
+            aabb bounds = aabb::empty();
+
+            /// Index of first primitive (for leaves) or left child (for interior nodes, right child is `first + 1`)
+            std::uint32_t first = 0;
+
+            /// Count of primitives (zero for interior nodes)
+            std::uint32_t count = 0;
+        };
+
+        /// Maximal count of primitives in single leaf
+        constexpr static std::size_t MAX_LEAF_SIZE = 4;
+
+        /// Maximal leaf depth (root depth is zero), traversal stacks hold at most `MAX_DEPTH + 1` nodes
+        constexpr static std::size_t MAX_DEPTH = 63;
+
+        /// Build hierarchy from scratch, primitives with empty bounds are not indexed
+        void build(std::span<const aabb> bounds) {
+            nodes.clear();
+            primitives.clear();
+
+            primitives.reserve(bounds.size());
+            for (std::uint32_t i = 0; i < bounds.size(); i++)
+                if (!bounds[i].is_empty())
+                    primitives.push_back(i);
+
+            if (primitives.empty())
+                return;
+
+            nodes.reserve(primitives.size() * 2);
+            nodes.push_back(node {});
+            build_node(0, 0, primitives.size(), 0, bounds);
+        }
+
+        /// Recalculate node bounds keeping hierarchy topology
+        void refit(std::span<const aabb> bounds) {
+            // Children always have greater indices than their parents
+            for (std::size_t i = nodes.size(); i-- > 0;) {
+                node &n = nodes[i];
+                aabb box = aabb::empty();
+
+                if (n.count == 0) {
+                    box.extend(nodes[n.first].bounds).extend(nodes[n.first + 1].bounds);
+                } else {
+                    for (std::uint32_t p = n.first; p < n.first + n.count; p++)
+                        box.extend(bounds[primitives[p]]);
+                }
+                n.bounds = box;
+            }
+        }
+
+        /// Estimate hierarchy traversal cost (surface area heuristic normalized by root area)
+        float get_cost() const {
+            if (nodes.empty())
+                return 0.0f;
+
+            float root_area = nodes[0].bounds.surface_area();
+            if (root_area <= 0.0f)
+                return 0.0f;
+
+            float cost = 0.0f;
+            for (const node &n : nodes)
+                cost += n.bounds.surface_area() * (n.count == 0 ? TRAVERSAL_COST : (float)n.count);
+            return cost / root_area;
+        }
+
+        /// Check if hierarchy has no primitives
+        bool is_empty() const {
+            return nodes.empty();
+        }
+
+        /// Restore hierarchy from nodes and primitive order of another one (e.g. loaded from file).
+        /// Returns nothing if nodes don't form a tree traversal can handle (children must follow their parents,
+        /// every node except root must be referenced once, depth must fit traversal stacks), leaf ranges
+        /// exceed `primitives` or primitives are not less than `primitive_count`.
+        static std::optional<bvh> from_data(std::vector<node> nodes, std::vector<std::uint32_t> primitives, std::size_t primitive_count) {
+            // Packet traversal stack entries keep node index above 4 lane mask bits
+            if (nodes.size() >= (std::size_t {1} << 28))
+                return std::nullopt;
+
+            std::vector<std::uint8_t> depths(nodes.size(), 0);
+            std::vector<bool> is_referenced(nodes.size(), false);
+            for (std::size_t i = 0; i < nodes.size(); i++) {
+                const node &n = nodes[i];
+                if (i != 0 && !is_referenced[i])
+                    return std::nullopt;
+
+                if (n.count != 0) {
+                    if ((std::size_t)n.first + n.count > primitives.size())
+                        return std::nullopt;
+                    continue;
+                }
+
+                if (n.first <= i || (std::size_t)n.first + 1 >= nodes.size() || depths[i] >= MAX_DEPTH)
+                    return std::nullopt;
+                for (std::size_t child : {(std::size_t)n.first, (std::size_t)n.first + 1}) {
+                    if (is_referenced[child])
+                        return std::nullopt;
+                    is_referenced[child] = true;
+                    depths[child] = depths[i] + 1;
+                }
+            }
+
+            for (std::uint32_t primitive : primitives)
+                if (primitive >= primitive_count)
+                    return std::nullopt;
+
+            bvh hierarchy;
+            hierarchy.nodes = std::move(nodes);
+            hierarchy.primitives = std::move(primitives);
+            return hierarchy;
+        }
+
+        /// Get hierarchy nodes (root is the first one)
+        std::span<const node> get_nodes() const noexcept {
+            return nodes;
+        }
+
+        /// Get primitive order referenced by leaves
+        std::span<const std::uint32_t> get_primitives() const noexcept {
+            return primitives;
+        }
+
+        /// Get hierarchy root bounds
+        aabb get_bounds() const {
+            return nodes.empty() ? aabb::empty() : nodes[0].bounds;
+        }
+
+        /// Visit primitives whose leaves are hit by ray closer than `max_distance`.
+        /// Visitor is called as `bool(std::uint32_t primitive, float &max_distance)`, may shrink
+        /// `max_distance` and returns true to stop traversal.
+        template <typename visitor_type>
+        bool traverse(const ray &r, float max_distance, visitor_type &&visitor) const {
+            if (nodes.empty())
+                return false;
+
+            const vec3 inv_direction = vec3(1.0f) / r.direction;
+
+            std::uint32_t stack[64];
+            std::size_t stack_size = 0;
+
+            float entry;
+            if (!nodes[0].bounds.intersect(r, inv_direction, max_distance, entry))
+                return false;
+            stack[stack_size++] = 0;
+
+            while (stack_size != 0) {
+                const node &n = nodes[stack[--stack_size]];
+
+                if (n.count != 0) {
+                    for (std::uint32_t p = n.first; p < n.first + n.count; p++)
+                        if (visitor(primitives[p], max_distance))
+                            return true;
+                    continue;
+                }
+
+                float left_entry, right_entry;
+                bool left_hit = nodes[n.first].bounds.intersect(r, inv_direction, max_distance, left_entry);
+                bool right_hit = nodes[n.first + 1].bounds.intersect(r, inv_direction, max_distance, right_entry);
+
+                // Push farther child first to visit nearer one earlier
+                if (left_hit && right_hit) {
+                    bool left_first = left_entry <= right_entry;
+                    stack[stack_size++] = left_first ? n.first + 1 : n.first;
+                    stack[stack_size++] = left_first ? n.first : n.first + 1;
+                } else if (left_hit) {
+                    stack[stack_size++] = n.first;
+                } else if (right_hit) {
+                    stack[stack_size++] = n.first + 1;
+                }
+            }
+
+            return false;
+        }
+
+        /// Count of rays traversed together by `traverse_packet`
+        constexpr static std::size_t PACKET_SIZE = 4;
+
+        /// Visit primitives of leaves hit by packet of up to `PACKET_SIZE` rays closer than their `max_distances`.
+        /// Rays share traversal (boxes are tested against the whole packet at once), so coherent rays are much cheaper.
+        /// Visitor is called as `bool(std::size_t lane, std::uint32_t primitive, float &max_distance)` for every ray
+        /// whose leaf is hit, may shrink ray `max_distance` and returns true to finish ray traversal.
+        template <typename visitor_type>
+        void traverse_packet(std::span<const ray> rays, std::span<float> max_distances, visitor_type &&visitor) const {
+            if (nodes.empty() || rays.empty())
+                return;
+
+#if defined(__SSE2__)
+            if (rays.size() == 1) {
+                traverse(rays[0], max_distances[0], [&](std::uint32_t primitive, float &max_distance) {
+                    const bool is_done = visitor(0, primitive, max_distance);
+                    max_distances[0] = max_distance;
+                    return is_done;
+                });
+                return;
+            }
+
+            // Rays in SoA form, unused lanes never hit anything
+            alignas(16) float origins[3][PACKET_SIZE] = {};
+            alignas(16) float inv_directions[3][PACKET_SIZE] = {};
+            alignas(16) float distances[PACKET_SIZE] = {-1.0f, -1.0f, -1.0f, -1.0f};
+            for (std::size_t lane = 0; lane < rays.size(); lane++) {
+                const vec3 inv_direction = vec3(1.0f) / rays[lane].direction;
+                origins[0][lane] = rays[lane].origin.x;
+                origins[1][lane] = rays[lane].origin.y;
+                origins[2][lane] = rays[lane].origin.z;
+                inv_directions[0][lane] = inv_direction.x;
+                inv_directions[1][lane] = inv_direction.y;
+                inv_directions[2][lane] = inv_direction.z;
+                distances[lane] = max_distances[lane];
+            }
+
+            const __m128 origin_x = _mm_load_ps(origins[0]), origin_y = _mm_load_ps(origins[1]), origin_z = _mm_load_ps(origins[2]);
+            const __m128 inv_x = _mm_load_ps(inv_directions[0]), inv_y = _mm_load_ps(inv_directions[1]), inv_z = _mm_load_ps(inv_directions[2]);
+            __m128 max_distance = _mm_load_ps(distances);
+
+            // Returns mask of lanes that hit box, `entry` gets their entry distances
+            const auto test_box = [&](const aabb &box, __m128 &entry) {
+                const __m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.min.x), origin_x), inv_x);
+                const __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.max.x), origin_x), inv_x);
+                const __m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.min.y), origin_y), inv_y);
+                const __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.max.y), origin_y), inv_y);
+                const __m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.min.z), origin_z), inv_z);
+                const __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.max.z), origin_z), inv_z);
+
+                const __m128 near = _mm_max_ps(
+                    _mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)),
+                    _mm_max_ps(_mm_min_ps(t0z, t1z), _mm_setzero_ps())
+                );
+                const __m128 far = _mm_min_ps(
+                    _mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)),
+                    _mm_min_ps(_mm_max_ps(t0z, t1z), max_distance)
+                );
+                entry = near;
+                return (std::uint32_t)_mm_movemask_ps(_mm_cmple_ps(near, far));
+            };
+
+            // Stack entries are `node << 4 | lane mask`, mask is taken when node was pushed
+            std::uint32_t stack[64];
+            std::size_t stack_size = 0;
+
+            __m128 entry;
+            if (const std::uint32_t mask = test_box(nodes[0].bounds, entry))
+                stack[stack_size++] = mask;
+
+            while (stack_size != 0) {
+                const std::uint32_t top = stack[--stack_size];
+                std::uint32_t mask = top & 0xF;
+                const node &n = nodes[top >> 4];
+
+                if (n.count != 0) {
+                    _mm_store_ps(distances, max_distance);
+                    for (std::uint32_t p = n.first; p < n.first + n.count && mask != 0; p++)
+                        for (std::uint32_t lanes = mask; lanes != 0; lanes &= lanes - 1) {
+                            const std::size_t lane = std::countr_zero(lanes);
+                            if (distances[lane] >= 0.0f && visitor(lane, primitives[p], distances[lane])) {
+                                distances[lane] = -1.0f;
+                                mask &= ~(1u << lane);
+                            }
+                        }
+                    max_distance = _mm_load_ps(distances);
+                    continue;
+                }
+
+                __m128 left_entry, right_entry;
+                const std::uint32_t left_mask = test_box(nodes[n.first].bounds, left_entry) & mask;
+                const std::uint32_t right_mask = test_box(nodes[n.first + 1].bounds, right_entry) & mask;
+
+                // Farther child (for majority of rays that hit both) is pushed first
+                if (left_mask != 0 && right_mask != 0) {
+                    const std::uint32_t both = left_mask & right_mask;
+                    const int right_nearer = std::popcount((std::uint32_t)_mm_movemask_ps(_mm_cmplt_ps(right_entry, left_entry)) & both);
+                    const bool left_first = 2 * right_nearer <= std::popcount(both);
+                    const std::uint32_t left = n.first << 4 | left_mask, right = (n.first + 1) << 4 | right_mask;
+                    stack[stack_size++] = left_first ? right : left;
+                    stack[stack_size++] = left_first ? left : right;
+                } else if (left_mask != 0) {
+                    stack[stack_size++] = n.first << 4 | left_mask;
+                } else if (right_mask != 0) {
+                    stack[stack_size++] = (n.first + 1) << 4 | right_mask;
+                }
+            }
+
+            for (std::size_t lane = 0; lane < rays.size(); lane++)
+                if (distances[lane] >= 0.0f)
+                    max_distances[lane] = distances[lane];
+#else
+            for (std::size_t lane = 0; lane < rays.size(); lane++)
+                traverse(rays[lane], max_distances[lane], [&](std::uint32_t primitive, float &max_distance) {
+                    const bool is_done = visitor(lane, primitive, max_distance);
+                    max_distances[lane] = max_distance;
+                    return is_done;
+                });
+#endif
+        }
+
+    private:
+
+        /// Relative cost of interior node traversal compared to primitive intersection
+        constexpr static float TRAVERSAL_COST = 0.5f;
+
+        /// Count of bins used in SAH split search
+        constexpr static std::size_t BIN_COUNT = 12;
+
+        /// Build node of `depth` from `primitives[begin..end]` range
+        void build_node(std::size_t index, std::size_t begin, std::size_t end, std::size_t depth, std::span<const aabb> bounds) {
+            aabb box = aabb::empty();
+            aabb centroid_box = aabb::empty();
+            for (std::size_t i = begin; i < end; i++) {
+                box.extend(bounds[primitives[i]]);
+                centroid_box.extend(bounds[primitives[i]].center());
+            }
+            nodes[index].bounds = box;
+
+            // Skewed SAH splits may peel few primitives per level, so median splits are forced once the remaining depth
+            // is just enough for them (every median split halves the range), leaf is forced at the maximal depth
+            const std::size_t count = end - begin;
+            std::size_t middle = begin;
+            if (count > MAX_LEAF_SIZE && depth < MAX_DEPTH)
+                middle = depth + std::bit_width(count) >= MAX_DEPTH
+                    ? split_median(begin, end, centroid_box, bounds)
+                    : find_split(begin, end, centroid_box, bounds);
+
+            if (middle == begin || middle == end) {
+                nodes[index].first = begin;
+                nodes[index].count = count;
+                return;
+            }
+
+            const std::uint32_t left = nodes.size();
+            nodes[index].first = left;
+            nodes[index].count = 0;
+            nodes.push_back(node {});
+            nodes.push_back(node {});
+
+            build_node(left, begin, middle, depth + 1, bounds);
+            build_node(left + 1, middle, end, depth + 1, bounds);
+        }
+
+        /// Partition primitive range in halves by centroid along its longest axis, returns split point
+        std::size_t split_median(std::size_t begin, std::size_t end, const aabb &centroid_box, std::span<const aabb> bounds) {
+            const vec3 extent = centroid_box.max - centroid_box.min;
+            std::size_t axis = 0;
+            if (extent.y > extent[axis]) axis = 1;
+            if (extent.z > extent[axis]) axis = 2;
+
+            const std::size_t middle = begin + (end - begin) / 2;
+            std::nth_element(
+                primitives.begin() + begin,
+                primitives.begin() + middle,
+                primitives.begin() + end,
+                [&](std::uint32_t a, std::uint32_t b) { return bounds[a].center()[axis] < bounds[b].center()[axis]; }
+            );
+            return middle;
+        }
+
+        /// Partition primitive range using binned SAH, returns split point (`begin` if leaf is better)
+        std::size_t find_split(std::size_t begin, std::size_t end, const aabb &centroid_box, std::span<const aabb> bounds) {
+            vec3 extent = centroid_box.max - centroid_box.min;
+            std::size_t axis = 0;
+            if (extent.y > extent[axis]) axis = 1;
+            if (extent.z > extent[axis]) axis = 2;
+
+            const std::size_t count = end - begin;
+
+            // Degenerate centroids, split in the middle
+            if (!(extent[axis] > 0.0f)) {
+                if (count <= MAX_LEAF_SIZE * 4)
+                    return begin;
+                return begin + count / 2;
+            }
+
+            const float axis_min = centroid_box.min[axis];
+            const float bin_scale = BIN_COUNT / extent[axis];
+            auto bin_of = [&](std::uint32_t primitive) {
+                float c = bounds[primitive].center()[axis];
+                return std::min<std::size_t>(BIN_COUNT - 1, (std::size_t)((c - axis_min) * bin_scale));
+            };
+
+            aabb bin_bounds[BIN_COUNT];
+            std::size_t bin_counts[BIN_COUNT] = {};
+            for (aabb &b : bin_bounds)
+                b = aabb::empty();
+
+            for (std::size_t i = begin; i < end; i++) {
+                std::size_t bin = bin_of(primitives[i]);
+                bin_bounds[bin].extend(bounds[primitives[i]]);
+                bin_counts[bin]++;
+            }
+
+            // Sweep from the right to collect suffix areas
+            float right_areas[BIN_COUNT];
+            std::size_t right_counts[BIN_COUNT];
+            aabb accumulated = aabb::empty();
+            std::size_t accumulated_count = 0;
+            for (std::size_t b = BIN_COUNT; b-- > 1;) {
+                accumulated.extend(bin_bounds[b]);
+                accumulated_count += bin_counts[b];
+                right_areas[b] = accumulated.surface_area();
+                right_counts[b] = accumulated_count;
+            }
+
+            float best_cost = std::numeric_limits<float>::infinity();
+            std::size_t best_bin = 0;
+            accumulated = aabb::empty();
+            accumulated_count = 0;
+            for (std::size_t b = 0; b + 1 < BIN_COUNT; b++) {
+                accumulated.extend(bin_bounds[b]);
+                accumulated_count += bin_counts[b];
+                if (accumulated_count == 0 || right_counts[b + 1] == 0)
+                    continue;
+
+                float cost = accumulated.surface_area() * accumulated_count
+                    + right_areas[b + 1] * right_counts[b + 1];
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_bin = b;
+                }
+            }
+
+            // Compare with leaf cost
+            float parent_area = 0.0f;
+            {
+                aabb parent = aabb::empty();
+                for (std::size_t b = 0; b < BIN_COUNT; b++)
+                    parent.extend(bin_bounds[b]);
+                parent_area = parent.surface_area();
+            }
+            if (count <= MAX_LEAF_SIZE * 4 && best_cost >= (parent_area * count - TRAVERSAL_COST * parent_area))
+                return begin;
+
+            if (best_cost == std::numeric_limits<float>::infinity())
+                return begin + count / 2;
+
+            auto middle = std::partition(
+                primitives.begin() + begin,
+                primitives.begin() + end,
+                [&](std::uint32_t primitive) { return bin_of(primitive) <= best_bin; }
+            );
+            return middle - primitives.begin();
+        }
+
+        /// Hierarchy nodes (root is the first one)
+        std::vector<node> nodes {};
+
+        /// Primitive indices referenced by leaves
+        std::vector<std::uint32_t> primitives {};
+    };
+}
+
+#endif // !defined(RT_BVH_HPP_)
+
+// rt_bvh.hpp
@@ -0,0 +1,154 @@
+//! Asynchronous frame capture implementation file
+
+#ifndef RT_CAPTURE_HPP_
+#define RT_CAPTURE_HPP_
+
+#include <condition_variable>
+#include <deque>
+
+#include "rt_image.hpp"
+
+namespace rt {
+    /// Background image encoder with bounded job queue
+    class frame_writer {
+    public:
+
+        /// Construct writer (at most `queue_capacity` frames may wait for encoding)
+        frame_writer(std::size_t queue_capacity = 4):
+            queue_capacity(std::max<std::size_t>(queue_capacity, 1))
+        {
+            worker = std::thread([this]() { run(); });
+        }
+
+        /// Writer destructor, writes all queued frames
+        ~frame_writer() {
+            {
+                std::lock_guard guard {lock};
+                do_continue = false;
+            }
+            queue_changed.notify_all();
+            worker.join();
+        }
+
+        /// Enqueue frame saving, never blocks. Returns false (and drops the frame) if queue is full.
+        bool submit(image frame, std::string path, image_format format) {
+            {
+                std::lock_guard guard {lock};
+                if (jobs.size() >= queue_capacity) {
+                    dropped_count++;
+                    return false;
+                }
+                jobs.push_back(job {
+                    .frame = std::move(frame),
+                    .path = std::move(path),
+                    .format = format,
+                });
+            }
+            queue_changed.notify_all();
+            return true;
+        }
+
+        /// Enqueue frame saving, deducing format from path extension
+        bool submit(image frame, std::string path) {
+            std::optional<image_format> format = image_format_from_path(path);
+            if (!format.has_value()) {
+                std::lock_guard guard {lock};
+                failed_count++;
+                return false;
+            }
+            return submit(std::move(frame), std::move(path), *format);
+        }
+
+        /// Wait until all queued frames are written
+        void flush() {
+            std::unique_lock guard {lock};
+            queue_changed.wait(guard, [this]() { return jobs.empty() && !is_writing; });
+        }
+
+        /// Count of successfully written frames
+        std::size_t get_written_count() {
+            std::lock_guard guard {lock};
+            return written_count;
+        }
+
+        /// Count of frames dropped because of queue overflow
+        std::size_t get_dropped_count() {
+            std::lock_guard guard {lock};
+            return dropped_count;
+        }
+
+        /// Count of frames failed to write
+        std::size_t get_failed_count() {
+            std::lock_guard guard {lock};
+            return failed_count;
+        }
+
+    private:
+
+        /// Frame saving job
+        struct job {
+            /// Frame contents
+            image frame;
+
+            /// Destination path
+            std::string path;
+
+            /// Destination format
+            image_format format;
+        };
+
+        /// Encoder thread function
+        void run() {
+            std::unique_lock guard {lock};
+
+            for (;;) {
+                queue_changed.wait(guard, [this]() { return !jobs.empty() || !do_continue; });
+                if (jobs.empty())
+                    return;
+
+                job current = std::move(jobs.front());
+                jobs.pop_front();
+                is_writing = true;
+
+                // Encode without holding the lock
+                guard.unlock();
+                bool is_written = current.frame.save(current.path, current.format);
+                guard.lock();
+
+                is_writing = false;
+                (is_written ? written_count : failed_count)++;
+                queue_changed.notify_all();
+            }
+        }
+
+        /// Maximal count of queued jobs
+        std::size_t queue_capacity;
+
+        /// Queue lock
+        std::mutex lock;
+
+        /// Queue change (or writer stop) notification
+        std::condition_variable queue_changed;
+
+        /// Pending jobs
+        std::deque<job> jobs {};
+
+        /// Continue if true (used to stop encoder on destruction)
+        bool do_continue = true;
+
+        /// True while encoder processes a job
+        bool is_writing = false;
+
+        /// Statistics
+        std::size_t written_count = 0;
+        std::size_t dropped_count = 0;
+        std::size_t failed_count = 0;
+
+        /// Encoder thread
+        std::thread worker;
+    };
+}
+
+#endif // !defined(RT_CAPTURE_HPP_)
+
+// rt_capture.hpp
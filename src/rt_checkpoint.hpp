@@ -0,0 +1,228 @@
+//! Accumulation checkpoint file implementation file
+
+#ifndef RT_CHECKPOINT_HPP_
+#define RT_CHECKPOINT_HPP_
+
+#include <cstdio>
+#include <string>
+
+#include "rt_denoiser.hpp"
+#include "rt_mapped_file.hpp"
+
+namespace rt {
+    /// Checkpoint of accumulated samples, kept in memory-mapped file.
+    /// File has two slots written alternately, header points to the last completely written one,
+    /// so process (or system) death during write leaves the previous checkpoint intact.
+    class checkpoint_file {
+    public:
+
+        /// Slot parameters (everything needed to continue accumulation besides row data)
+        struct slot_header {
+            /// Count of checkpoints written before this one
+            std::uint64_t sequence = 0;
+
+            /// Hash of rendered scene and its shading
+            std::uint64_t scene_hash = 0;
+
+            /// Random seed epoch of rendering threads
+            std::uint64_t random_epoch = 0;
+
+            /// Camera location, forward, right and up vectors
+            float camera[12] = {};
+
+            /// Render mode
+            std::uint32_t render_mode = 0;
+
+            /// Count of diffuse bounces
+            std::uint32_t max_bounces = 0;
+        };
+
+        /// Create empty checkpoint file for frame of specified size (null on failure)
+        static std::unique_ptr<checkpoint_file> create(const std::string &path, std::size_t width, std::size_t height) {
+            std::unique_ptr<mapped_file> file = mapped_file::open(path, get_file_size(width, height));
+            if (file == nullptr)
+                return nullptr;
+
+            file_header &header = *reinterpret_cast<file_header *>(file->get_data());
+            std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+            header.width = width;
+            header.height = height;
+            header.active_slot = NO_SLOT;
+            return std::unique_ptr<checkpoint_file>(new checkpoint_file(std::move(file)));
+        }
+
+        /// Atomically replace checkpoint file at `path` by file at `source_path` (open mappings of it stay valid)
+        static bool replace(const std::string &source_path, const std::string &path) {
+            return std::rename(source_path.c_str(), path.c_str()) == 0;
+        }
+
+        /// Open existing checkpoint file (null if it is missing or invalid)
+        static std::unique_ptr<checkpoint_file> open(const std::string &path) {
+            std::unique_ptr<mapped_file> file = mapped_file::open(path);
+            if (file == nullptr || file->get_size() < sizeof(file_header))
+                return nullptr;
+
+            const file_header &header = *reinterpret_cast<const file_header *>(file->get_data());
+            if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || file->get_size() != get_file_size(header.width, header.height))
+                return nullptr;
+            if (header.active_slot != NO_SLOT && header.active_slot >= SLOT_COUNT)
+                return nullptr;
+
+            return std::unique_ptr<checkpoint_file>(new checkpoint_file(std::move(file)));
+        }
+
+        /// Get frame width
+        std::size_t get_width() const noexcept {
+            return get_header().width;
+        }
+
+        /// Get frame height
+        std::size_t get_height() const noexcept {
+            return get_header().height;
+        }
+
+        /// Get slot of the last complete checkpoint (nullopt if there is none)
+        std::optional<std::uint32_t> get_active_slot() const noexcept {
+            const std::uint32_t slot = get_header().active_slot;
+            return slot == NO_SLOT ? std::nullopt : std::optional(slot);
+        }
+
+        /// Get slot to write the next checkpoint to
+        std::uint32_t get_write_slot() const noexcept {
+            const std::uint32_t slot = get_header().active_slot;
+            return slot == NO_SLOT ? 0 : (slot + 1) % SLOT_COUNT;
+        }
+
+        /// Get slot parameters
+        slot_header & get_slot_header(std::uint32_t slot) const noexcept {
+            return *reinterpret_cast<slot_header *>(get_slot_data(slot));
+        }
+
+        /// Write row `y` of slot: `collected_count` samples accumulated in `color` and `aov` (`get_width()` pixels)
+        void store_row(std::uint32_t slot, std::size_t y, std::uint32_t collected_count, const vec3 *color, const aov_sample *aov) const {
+            std::byte *row = get_row_data(slot, y);
+            std::memcpy(row, &collected_count, sizeof(collected_count));
+
+            float *pixel = reinterpret_cast<float *>(row + ROW_HEADER_SIZE);
+            for (std::size_t x = 0; x < get_width(); x++) {
+                const float values[PIXEL_FLOAT_COUNT] = {
+                    color[x].x, color[x].y, color[x].z,
+                    aov[x].normal.x, aov[x].normal.y, aov[x].normal.z,
+                    aov[x].albedo.x, aov[x].albedo.y, aov[x].albedo.z,
+                    aov[x].depth,
+                };
+                pixel = std::copy_n(values, PIXEL_FLOAT_COUNT, pixel);
+            }
+        }
+
+        /// Read row `y` of slot into `color` and `aov`, returns count of samples accumulated in it
+        std::uint32_t load_row(std::uint32_t slot, std::size_t y, vec3 *color, aov_sample *aov) const {
+            const std::byte *row = get_row_data(slot, y);
+            std::uint32_t collected_count;
+            std::memcpy(&collected_count, row, sizeof(collected_count));
+
+            const float *pixel = reinterpret_cast<const float *>(row + ROW_HEADER_SIZE);
+            for (std::size_t x = 0; x < get_width(); x++, pixel += PIXEL_FLOAT_COUNT) {
+                color[x] = vec3(pixel[0], pixel[1], pixel[2]);
+                aov[x] = aov_sample {
+                    .normal = vec3(pixel[3], pixel[4], pixel[5]),
+                    .albedo = vec3(pixel[6], pixel[7], pixel[8]),
+                    .depth = pixel[9],
+                };
+            }
+            return collected_count;
+        }
+
+        /// Make completely written slot the active one, slot data is written to storage before the header
+        bool commit(std::uint32_t slot) const {
+            if (!file->sync(get_slot_offset(slot), get_slot_size(get_width(), get_height())))
+                return false;
+
+            get_header().active_slot = slot;
+            return file->sync(0, sizeof(file_header));
+        }
+
+    private:
+
+        /// File signature
+        constexpr static char MAGIC[8] = {'R', 'T', 'C', 'K', 'P', 'T', '0', '1'};
+
+        /// Count of slots
+        constexpr static std::uint32_t SLOT_COUNT = 2;
+
+        /// Active slot value of file without complete checkpoints
+        constexpr static std::uint32_t NO_SLOT = ~0u;
+
+        /// Row header size (sample count, padded)
+        constexpr static std::size_t ROW_HEADER_SIZE = 8;
+
+        /// Count of floats stored per pixel (color, normal, albedo, depth)
+        constexpr static std::size_t PIXEL_FLOAT_COUNT = 10;
+
+        /// File header
+        struct file_header {
+            /// File signature
+            char magic[8];
+
+            /// Frame width
+            std::uint32_t width;
+
+            /// Frame height
+            std::uint32_t height;
+
+            /// Slot of the last complete checkpoint
+            std::uint32_t active_slot;
+
+            /// Padding
+            std::uint32_t reserved;
+        };
+
+        /// Get row size
+        static constexpr std::size_t get_row_size(std::size_t width) noexcept {
+            return ROW_HEADER_SIZE + width * PIXEL_FLOAT_COUNT * sizeof(float);
+        }
+
+        /// Get slot size
+        static constexpr std::size_t get_slot_size(std::size_t width, std::size_t height) noexcept {
+            return sizeof(slot_header) + height * get_row_size(width);
+        }
+
+        /// Get file size
+        static constexpr std::size_t get_file_size(std::size_t width, std::size_t height) noexcept {
+            return sizeof(file_header) + SLOT_COUNT * get_slot_size(width, height);
+        }
+
+        /// Construct checkpoint of mapped file
+        checkpoint_file(std::unique_ptr<mapped_file> file):
+            file(std::move(file))
+        {
+        }
+
+        /// Get file header
+        file_header & get_header() const noexcept {
+            return *reinterpret_cast<file_header *>(file->get_data());
+        }
+
+        /// Get slot offset in file
+        std::size_t get_slot_offset(std::uint32_t slot) const noexcept {
+            return sizeof(file_header) + slot * get_slot_size(get_width(), get_height());
+        }
+
+        /// Get slot data
+        std::byte * get_slot_data(std::uint32_t slot) const noexcept {
+            return file->get_data() + get_slot_offset(slot);
+        }
+
+        /// Get row data
+        std::byte * get_row_data(std::uint32_t slot, std::size_t y) const noexcept {
+            return get_slot_data(slot) + sizeof(slot_header) + y * get_row_size(get_width());
+        }
+
+        /// Mapped file
+        std::unique_ptr<mapped_file> file;
+    };
+}
+
+#endif // !defined(RT_CHECKPOINT_HPP_)
+
+// rt_checkpoint.hpp
@@ -3,15 +3,22 @@
 #ifndef RT_DEF_H_
 #define RT_DEF_H_
 
+#include <algorithm>
 #include <atomic>
+#include <cassert>
 #include <cstring>
 #include <chrono>
+#include <condition_variable>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <numeric>
 #include <optional>
 #include <random>
 #include <span>
 #include <thread>
+#include <utility>
+#include <vector>
 
 /// Project namespace
 namespace rt {
@@ -23,6 +30,15 @@ namespace rt {
             true
         #endif
         ;
+
+    /// Approximate primary ray normalization flag (enabled by RT_FAST_MATH definition)
+    constexpr bool IS_FAST_MATH =
+        #ifdef RT_FAST_MATH
+            true
+        #else
+            false
+        #endif
+        ;
 }
 
 #endif // !defined(RT_DEF_H_)
@@ -0,0 +1,409 @@
+//! Edge-aware a-trous wavelet denoiser implementation file
+
+#ifndef RT_DENOISER_HPP_
+#define RT_DENOISER_HPP_
+
+#include <bit>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "rt_shape_common.hpp"
+#include "rt_executor.hpp"
+
+namespace rt {
+    /// First-hit auxiliary data of pixel sample (AOV)
+    struct aov_sample {
+        /// Depth written for rays that hit nothing
+        constexpr static float MISS_DEPTH = 1.0e6f;
+
+        /// Surface normal (negated ray direction for misses)
+        vec3 normal;
+
+        /// Surface albedo (sky radiance for misses)
+        vec3 albedo;
+
+        /// Distance to the first hit
+        float depth = 0.0f;
+
+        /// Sum of samples
+        aov_sample operator+(const aov_sample &other) const {
+            return aov_sample {
+                .normal = normal + other.normal,
+                .albedo = albedo + other.albedo,
+                .depth = depth + other.depth,
+            };
+        }
+
+        /// Sample scaled by factor
+        aov_sample operator*(float factor) const {
+            return aov_sample {
+                .normal = normal * vec3(factor),
+                .albedo = albedo * vec3(factor),
+                .depth = depth * factor,
+            };
+        }
+    };
+
+    /// Edge-avoiding a-trous wavelet filter guided by normal, albedo and depth buffers.
+    /// Data is stored in per-channel planes, so every filter tap is a contiguous loop processed four pixels at once.
+    class denoiser {
+    public:
+
+        /// Filter settings
+        struct settings {
+            /// Count of wavelet passes (kernel footprint is `4 * 2^iterations + 1` pixels)
+            std::size_t iterations = 5;
+
+            /// Color difference tolerance (halved every pass)
+            float color_sigma = 0.6f;
+
+            /// Albedo difference tolerance
+            float albedo_sigma = 0.1f;
+
+            /// Relative depth difference tolerance
+            float depth_sigma = 0.05f;
+        };
+
+        /// Construct denoiser, rows are filtered by `row_executor` threads (and the calling thread) if it's not null
+        denoiser(executor *row_executor = nullptr):
+            row_executor(row_executor)
+        {
+        }
+
+        /// Set filter settings
+        void set_settings(settings new_settings) {
+            filter_settings = new_settings;
+        }
+
+        /// Resize input/output buffers (contents become undefined)
+        void resize(std::size_t new_width, std::size_t new_height) {
+            if (new_width == width && new_height == height)
+                return;
+
+            width = new_width;
+            height = new_height;
+            for (auto &plane : planes)
+                plane.assign(width * height, 0.0f);
+        }
+
+        /// Load input row, color and AOV sums are multiplied by `scale`
+        void load_row(std::size_t y, const vec3 *color, const aov_sample *aov, float scale) {
+            const std::size_t offset = y * width;
+            for (std::size_t x = 0; x < width; x++) {
+                planes[COLOR_R][offset + x] = color[x].x * scale;
+                planes[COLOR_G][offset + x] = color[x].y * scale;
+                planes[COLOR_B][offset + x] = color[x].z * scale;
+                planes[NORMAL_X][offset + x] = aov[x].normal.x * scale;
+                planes[NORMAL_Y][offset + x] = aov[x].normal.y * scale;
+                planes[NORMAL_Z][offset + x] = aov[x].normal.z * scale;
+                planes[ALBEDO_R][offset + x] = aov[x].albedo.x * scale;
+                planes[ALBEDO_G][offset + x] = aov[x].albedo.y * scale;
+                planes[ALBEDO_B][offset + x] = aov[x].albedo.z * scale;
+                planes[DEPTH][offset + x] = aov[x].depth * scale;
+            }
+        }
+
+        /// Filter loaded image
+        void run() {
+            float color_sigma = filter_settings.color_sigma;
+
+            for (std::size_t pass = 0; pass < filter_settings.iterations; pass++) {
+                const std::size_t step = std::size_t(1) << pass;
+                const float inv_color_variance = 1.0f / (color_sigma * color_sigma);
+
+                parallel_rows([&](std::size_t y) { filter_row(y, step, inv_color_variance); });
+
+                std::swap(planes[COLOR_R], planes[FILTERED_R]);
+                std::swap(planes[COLOR_G], planes[FILTERED_G]);
+                std::swap(planes[COLOR_B], planes[FILTERED_B]);
+                color_sigma *= 0.5f;
+            }
+        }
+
+        /// Get filtered pixel
+        vec3 get(std::size_t x, std::size_t y) const {
+            const std::size_t index = y * width + x;
+            return vec3(planes[COLOR_R][index], planes[COLOR_G][index], planes[COLOR_B][index]);
+        }
+
+    private:
+
+        /// Plane indices
+        enum plane_index : std::size_t {
+            COLOR_R, COLOR_G, COLOR_B,
+            NORMAL_X, NORMAL_Y, NORMAL_Z,
+            ALBEDO_R, ALBEDO_G, ALBEDO_B,
+            DEPTH,
+            FILTERED_R, FILTERED_G, FILTERED_B,
+            PLANE_COUNT,
+        };
+
+        /// B3-spline kernel
+        constexpr static float KERNEL[5] = {1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f};
+
+        /// Executor weight of row jobs (frame display waits for filtering, so it's preferred to rendering)
+        constexpr static float ROW_JOB_WEIGHT = 16.0f;
+
+        /// Exponent is clamped to this value to keep `fast_exp` result normal
+        constexpr static float MIN_EXPONENT = -80.0f;
+
+        /// exp(x) approximation (relative error is below 1e-5), 2^round(t) is built from float bits
+        /// and 2^fraction is approximated by polynomial
+        static float fast_exp(float x) {
+            const float t = std::max(x, MIN_EXPONENT) * 1.44269504f;
+            const float shifted = t + 12582912.0f; // 1.5 * 2^23, rounds `t` to integer
+            const float f = t - (shifted - 12582912.0f);
+            const float p = 1.0f + f * (0.69314718f + f * (0.24022650f + f * (0.05550411f + f * (0.00961813f + f * 0.00133336f))));
+            const std::int32_t i = std::bit_cast<std::int32_t>(shifted) - 0x4B400000;
+            return std::bit_cast<float>(std::bit_cast<std::int32_t>(p) + i * (1 << 23));
+        }
+
+        /// Normal similarity weight, x^64
+        static float normal_power(float x) {
+            x *= x;
+            x *= x;
+            x *= x;
+            x *= x;
+            x *= x;
+            return x * x;
+        }
+
+#if defined(__SSE2__)
+        /// Four-lane `fast_exp`
+        static __m128 fast_exp(__m128 x) {
+            const __m128 magic = _mm_set1_ps(12582912.0f);
+            const __m128 t = _mm_mul_ps(_mm_max_ps(x, _mm_set1_ps(MIN_EXPONENT)), _mm_set1_ps(1.44269504f));
+            const __m128 shifted = _mm_add_ps(t, magic);
+            const __m128 f = _mm_sub_ps(t, _mm_sub_ps(shifted, magic));
+
+            __m128 p = _mm_set1_ps(0.00133336f);
+            p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.00961813f));
+            p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.05550411f));
+            p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.24022650f));
+            p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.69314718f));
+            p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.0f));
+
+            const __m128i i = _mm_sub_epi32(_mm_castps_si128(shifted), _mm_set1_epi32(0x4B400000));
+            return _mm_castsi128_ps(_mm_add_epi32(_mm_castps_si128(p), _mm_slli_epi32(i, 23)));
+        }
+
+        /// Four-lane `normal_power`
+        static __m128 normal_power(__m128 x) {
+            x = _mm_mul_ps(x, x);
+            x = _mm_mul_ps(x, x);
+            x = _mm_mul_ps(x, x);
+            x = _mm_mul_ps(x, x);
+            x = _mm_mul_ps(x, x);
+            return _mm_mul_ps(x, x);
+        }
+#endif
+
+        /// Filter single row of the current pass
+        void filter_row(std::size_t y, std::size_t step, float inv_color_variance) {
+            thread_local std::vector<float> sums;
+            sums.assign(width * 4, 0.0f);
+            float *sum_r = sums.data();
+            float *sum_g = sum_r + width;
+            float *sum_b = sum_g + width;
+            float *sum_w = sum_b + width;
+
+            const std::size_t center = y * width;
+            const float *cr = &planes[COLOR_R][center], *cg = &planes[COLOR_G][center], *cb = &planes[COLOR_B][center];
+            const float *nx = &planes[NORMAL_X][center], *ny = &planes[NORMAL_Y][center], *nz = &planes[NORMAL_Z][center];
+            const float *ar = &planes[ALBEDO_R][center], *ag = &planes[ALBEDO_G][center], *ab = &planes[ALBEDO_B][center];
+            const float *depth = &planes[DEPTH][center];
+
+            const float inv_albedo_variance = 1.0f / (filter_settings.albedo_sigma * filter_settings.albedo_sigma);
+            const float inv_depth_sigma = 1.0f / (filter_settings.depth_sigma * step);
+
+            for (int ky = -2; ky <= 2; ky++) {
+                const std::ptrdiff_t ty = (std::ptrdiff_t)y + ky * (std::ptrdiff_t)step;
+                if (ty < 0 || ty >= (std::ptrdiff_t)height)
+                    continue;
+
+                for (int kx = -2; kx <= 2; kx++) {
+                    const std::ptrdiff_t dx = kx * (std::ptrdiff_t)step;
+                    const std::size_t begin = std::max<std::ptrdiff_t>(0, -dx);
+                    const std::size_t end = std::min<std::ptrdiff_t>(width, (std::ptrdiff_t)width - dx);
+                    if (begin >= end)
+                        continue;
+
+                    // Taps outside of image are skipped, weights are renormalized
+                    const std::size_t tap_row = ty * width;
+                    const float *tr = &planes[COLOR_R][tap_row], *tg = &planes[COLOR_G][tap_row], *tb = &planes[COLOR_B][tap_row];
+                    const float *tnx = &planes[NORMAL_X][tap_row], *tny = &planes[NORMAL_Y][tap_row], *tnz = &planes[NORMAL_Z][tap_row];
+                    const float *tar = &planes[ALBEDO_R][tap_row], *tag = &planes[ALBEDO_G][tap_row], *tab = &planes[ALBEDO_B][tap_row];
+                    const float *tdepth = &planes[DEPTH][tap_row];
+                    const float h = KERNEL[kx + 2] * KERNEL[ky + 2];
+
+                    std::size_t x = begin;
+
+#if defined(__SSE2__)
+                    const __m128 h4 = _mm_set1_ps(h);
+                    const __m128 inv_color_variance4 = _mm_set1_ps(inv_color_variance);
+                    const __m128 inv_albedo_variance4 = _mm_set1_ps(inv_albedo_variance);
+                    const __m128 inv_depth_sigma4 = _mm_set1_ps(inv_depth_sigma);
+                    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+                    for (; x + 4 <= end; x += 4) {
+                        const std::size_t t = x + dx;
+                        const __m128 tr4 = _mm_loadu_ps(tr + t), tg4 = _mm_loadu_ps(tg + t), tb4 = _mm_loadu_ps(tb + t);
+
+                        const __m128 dr = _mm_sub_ps(_mm_loadu_ps(cr + x), tr4);
+                        const __m128 dg = _mm_sub_ps(_mm_loadu_ps(cg + x), tg4);
+                        const __m128 db = _mm_sub_ps(_mm_loadu_ps(cb + x), tb4);
+                        const __m128 da_r = _mm_sub_ps(_mm_loadu_ps(ar + x), _mm_loadu_ps(tar + t));
+                        const __m128 da_g = _mm_sub_ps(_mm_loadu_ps(ag + x), _mm_loadu_ps(tag + t));
+                        const __m128 da_b = _mm_sub_ps(_mm_loadu_ps(ab + x), _mm_loadu_ps(tab + t));
+
+                        const __m128 normal_dot = _mm_add_ps(
+                            _mm_add_ps(
+                                _mm_mul_ps(_mm_loadu_ps(nx + x), _mm_loadu_ps(tnx + t)),
+                                _mm_mul_ps(_mm_loadu_ps(ny + x), _mm_loadu_ps(tny + t))
+                            ),
+                            _mm_mul_ps(_mm_loadu_ps(nz + x), _mm_loadu_ps(tnz + t))
+                        );
+                        const __m128 normal_weight = normal_power(_mm_max_ps(normal_dot, _mm_setzero_ps()));
+
+                        const __m128 color_distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+                        const __m128 albedo_distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(da_r, da_r), _mm_mul_ps(da_g, da_g)), _mm_mul_ps(da_b, da_b));
+                        const __m128 center_depth = _mm_loadu_ps(depth + x);
+                        const __m128 depth_distance = _mm_div_ps(
+                            _mm_and_ps(_mm_sub_ps(center_depth, _mm_loadu_ps(tdepth + t)), abs_mask),
+                            _mm_max_ps(center_depth, _mm_set1_ps(1.0e-3f))
+                        );
+
+                        const __m128 exponent = _mm_add_ps(
+                            _mm_add_ps(_mm_mul_ps(color_distance, inv_color_variance4), _mm_mul_ps(albedo_distance, inv_albedo_variance4)),
+                            _mm_mul_ps(depth_distance, inv_depth_sigma4)
+                        );
+
+                        const __m128 weight = _mm_mul_ps(_mm_mul_ps(h4, normal_weight), fast_exp(_mm_sub_ps(_mm_setzero_ps(), exponent)));
+                        _mm_storeu_ps(sum_r + x, _mm_add_ps(_mm_loadu_ps(sum_r + x), _mm_mul_ps(tr4, weight)));
+                        _mm_storeu_ps(sum_g + x, _mm_add_ps(_mm_loadu_ps(sum_g + x), _mm_mul_ps(tg4, weight)));
+                        _mm_storeu_ps(sum_b + x, _mm_add_ps(_mm_loadu_ps(sum_b + x), _mm_mul_ps(tb4, weight)));
+                        _mm_storeu_ps(sum_w + x, _mm_add_ps(_mm_loadu_ps(sum_w + x), weight));
+                    }
+#endif
+
+                    // Scalar tail (or whole row if SIMD is unavailable)
+                    for (; x < end; x++) {
+                        const std::size_t t = x + dx;
+                        const float dr = cr[x] - tr[t], dg = cg[x] - tg[t], db = cb[x] - tb[t];
+                        const float da_r = ar[x] - tar[t], da_g = ag[x] - tag[t], da_b = ab[x] - tab[t];
+
+                        const float normal_weight = normal_power(std::max(nx[x] * tnx[t] + ny[x] * tny[t] + nz[x] * tnz[t], 0.0f));
+
+                        const float exponent = 0
+                            + (dr * dr + dg * dg + db * db) * inv_color_variance
+                            + (da_r * da_r + da_g * da_g + da_b * da_b) * inv_albedo_variance
+                            + std::abs(depth[x] - tdepth[t]) / std::max(depth[x], 1.0e-3f) * inv_depth_sigma;
+
+                        const float weight = h * normal_weight * fast_exp(-exponent);
+                        sum_r[x] += tr[t] * weight;
+                        sum_g[x] += tg[t] * weight;
+                        sum_b[x] += tb[t] * weight;
+                        sum_w[x] += weight;
+                    }
+                }
+            }
+
+            float *out_r = &planes[FILTERED_R][center], *out_g = &planes[FILTERED_G][center], *out_b = &planes[FILTERED_B][center];
+            for (std::size_t x = 0; x < width; x++) {
+                // Pixels without similar neighbors (including themselves, e.g. for degenerate normals) are kept as-is
+                const bool is_valid = sum_w[x] > 1.0e-12f;
+                const float inv_weight = is_valid ? 1.0f / sum_w[x] : 0.0f;
+                out_r[x] = is_valid ? sum_r[x] * inv_weight : cr[x];
+                out_g[x] = is_valid ? sum_g[x] * inv_weight : cg[x];
+                out_b[x] = is_valid ? sum_b[x] * inv_weight : cb[x];
+            }
+        }
+
+        /// Job that runs function for every row of the image
+        class row_job : public executor_job {
+        public:
+
+            /// Construct job
+            row_job(const std::function<void(std::size_t)> &fn, std::size_t height):
+                fn(fn),
+                height(height)
+            {
+            }
+
+            /// Process single row
+            virtual status run_task(std::size_t) override {
+                return process_row() ? status::done : status::finished;
+            }
+
+            /// Process next row, returns false if all rows are taken
+            bool process_row() {
+                const std::size_t y = next_row.fetch_add(1, std::memory_order_relaxed);
+                if (y >= height)
+                    return false;
+
+                fn(y);
+                if (finished_rows.fetch_add(1, std::memory_order_acq_rel) + 1 == height)
+                    finished_rows.notify_all();
+                return true;
+            }
+
+            /// Wait until all rows are processed
+            void wait() {
+                for (std::size_t count = finished_rows.load(std::memory_order_acquire); count != height; count = finished_rows.load(std::memory_order_acquire))
+                    finished_rows.wait(count, std::memory_order_acquire);
+            }
+
+        private:
+
+            /// Row function (valid until all rows are processed)
+            const std::function<void(std::size_t)> &fn;
+
+            /// Count of rows
+            const std::size_t height;
+
+            /// Index of the next row to process
+            std::atomic_size_t next_row = 0;
+
+            /// Count of processed rows
+            std::atomic_size_t finished_rows = 0;
+        };
+
+        /// Run function for every row in parallel, returns when all rows are processed
+        void parallel_rows(const std::function<void(std::size_t)> &fn) {
+            if (row_executor == nullptr) {
+                for (std::size_t y = 0; y < height; y++)
+                    fn(y);
+                return;
+            }
+
+            // Calling thread takes rows too, so filtering completes even if all executor threads are busy
+            // (e.g. when denoiser runs inside executor task)
+            const std::shared_ptr<row_job> job = std::make_shared<row_job>(fn, height);
+            row_executor->add_job(job, ROW_JOB_WEIGHT);
+            while (job->process_row())
+                ;
+            job->wait();
+        }
+
+        /// Filter settings
+        settings filter_settings {};
+
+        /// Image width
+        std::size_t width = 0;
+
+        /// Image height
+        std::size_t height = 0;
+
+        /// Image planes
+        std::vector<float> planes[PLANE_COUNT];
+
+        /// Executor that filters rows (null if filtering is single-threaded)
+        executor *row_executor = nullptr;
+    };
+}
+
+#endif // !defined(RT_DENOISER_HPP_)
+
+// rt_denoiser.hpp
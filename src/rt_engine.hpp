@@ -5,99 +5,16 @@
 
 #include "rt_shape.hpp"
 #include "rt_random.hpp"
+#include "rt_environment.hpp"
+#include "rt_denoiser.hpp"
+#include "rt_executor.hpp"
+#include "rt_render_task.hpp"
+#include "rt_arena.hpp"
+#include "rt_checkpoint.hpp"
+#include "rt_frame_export.hpp"
 
 namespace rt {
 
-    /// 'Mutex' synchronization primitive
-    class spinlock {
-    public:
-
-        /// Lock
-        void lock() {
-            for (;;) {
-                if (!lock_.exchange(true, std::memory_order_acquire))
-                    break;
-
-                while (lock_.load(std::memory_order_relaxed))
-                    pause(); // something like _mm_pause
-            }
-        }
-
-        /// Unlock
-        void unlock() {
-            lock_.store(false, std::memory_order_release);
-        }
-
-    private:
-
-        /// Function that does nothing
-        static void pause() {
-            static volatile unsigned int counter = 0;
-            counter += 4;
-            counter += 4;
-            counter += 4;
-            counter += 4;
-        }
-
-        /// Spinlock state
-        std::atomic_bool lock_ = false;
-    };
-
-    /// Parallel execution handler
-    class executor {
-    public:
-
-        /// Construct task executor
-        executor(
-            std::size_t task_count,
-            std::vector<std::function<void(std::size_t)>> thread_functions,
-            std::uint64_t task_random_seed = 47
-        ) {
-            // Construct task vector
-            tasks.reserve(task_count);
-            for (std::size_t i = 0; i < task_count; i++)
-                tasks.push_back(i);
-
-            /// Randomize rendering order
-            random::xoshiro256pp random {task_random_seed};
-            for (std::size_t i = 0; i < tasks.size(); i++)
-                std::swap(
-                    tasks[random.next() % tasks.size()],
-                    tasks[random.next() % tasks.size()]
-                );
-
-            /// Spawn rendering threads
-            threads.reserve(thread_functions.size());
-            for (auto fn : thread_functions)
-                threads.push_back(std::thread([this, fn]() {
-                    while (do_continue.load(std::memory_order_relaxed))
-                        fn(tasks[task_index.fetch_add(1, std::memory_order_relaxed) % tasks.size()]);
-                }));
-        }
-
-        /// Executor destructor
-        ~executor() {
-            do_continue.store(false, std::memory_order_relaxed);
-            /// Join all threads
-            for (auto &thr : threads)
-                thr.join();
-        }
-
-    private:
-
-        /// Current task index
-        std::atomic_uint32_t task_index = 0;
-
-        /// Continue if true (used to stop worker thread execution on destruction)
-        std::atomic_bool do_continue = true;
-
-        /// Array of tasks
-        std::vector<std::uint32_t> tasks = {};
-
-        /// Array of threads
-        std::vector<std::thread> threads = {};
-    };
-
     /// Camera location descriptor
     class camera {
     public:
@@ -128,22 +45,68 @@ namespace rt {
         vec3 up {0.0f, 1.0f, 0.0f};
     };
 
+    /// Camera ray hit cached by viewport rows, so shading changes don't require tracing camera rays again
+    struct first_hit {
+        /// Camera ray direction (hit point is camera location + direction * distance)
+        vec3 direction {0.0f};
+
+        /// Surface normal at hit point
+        vec3 normal {0.0f};
+
+        /// Distance to hit point (`intersection::INF_DISTANCE` if ray missed the scene)
+        float distance = intersection::INF_DISTANCE;
+
+        /// Horizontal texture coordinate
+        float u = 0.0f;
+
+        /// Vertical texture coordinate
+        float v = 0.0f;
+
+        /// Texture coordinate change per unit of surface distance
+        float uv_density = 0.0f;
+
+        /// Hit material, identifies it while scene geometry stays the same (null if ray missed the scene)
+        material *hit_material = nullptr;
+    };
+
     /// Single rendering 'task'
     class render_row {
     public:
-        /// Construct single rendering row
-        render_row(std::size_t width):
-            source(std::make_unique<vec3[]>(width)),
-            destination(std::make_unique<vec3[]>(width))
-        {
+
+        /// Get size of row memory (row planes are padded to arena alignment)
+        static constexpr std::size_t get_memory_size(std::size_t width) noexcept {
+            return 2 * memory_arena::align(width * sizeof(vec3))
+                + 2 * memory_arena::align(width * sizeof(aov_sample))
+                + memory_arena::align(width * sizeof(first_hit));
+        }
+
+        /// Construct single rendering row in `memory` of `get_memory_size(width)` bytes
+        render_row(std::byte *memory, std::size_t width) {
+            const std::size_t color_size = memory_arena::align(width * sizeof(vec3));
+            const std::size_t aov_size = memory_arena::align(width * sizeof(aov_sample));
+
+            source = std::uninitialized_fill_n(reinterpret_cast<vec3 *>(memory), width, vec3(0.0f)) - width;
+            destination = std::uninitialized_fill_n(reinterpret_cast<vec3 *>(memory + color_size), width, vec3(0.0f)) - width;
+            source_aov = std::uninitialized_fill_n(reinterpret_cast<aov_sample *>(memory + 2 * color_size), width, aov_sample {}) - width;
+            destination_aov = std::uninitialized_fill_n(reinterpret_cast<aov_sample *>(memory + 2 * color_size + aov_size), width, aov_sample {}) - width;
+            first_hits = std::uninitialized_fill_n(reinterpret_cast<first_hit *>(memory + 2 * color_size + 2 * aov_size), width, first_hit {}) - width;
         }
 
         /// Move constructor
         render_row(render_row &&other):
             collected_count(other.collected_count),
             frame_revision(other.frame_revision),
-            source(std::move(other.source)),
-            destination(std::move(other.destination))
+            scene_revision(other.scene_revision),
+            shading_revision(other.shading_revision),
+            deferral_count(other.deferral_count),
+            first_hit_revision(other.first_hit_revision),
+            first_hit_geometry_revision(other.first_hit_geometry_revision),
+            first_hit_seed(other.first_hit_seed),
+            source(other.source),
+            destination(other.destination),
+            source_aov(other.source_aov),
+            destination_aov(other.destination_aov),
+            first_hits(other.first_hits)
         {
         }
 
@@ -159,230 +122,2316 @@ namespace rt {
         /// 'hash' of current renderer state, used for non-blocking camera movement
         std::uint32_t frame_revision = 0;
 
-        /// Source pointer
-        std::unique_ptr<vec3[]> source;
+        /// Revision of the scene row is rendered with, used for non-blocking scene updates
+        std::uint32_t scene_revision = 0;
+
+        /// Revision of shading row is rendered with
+        std::uint32_t shading_revision = 0;
+
+        /// Count of successive row samples deferred because of non-resident geometry
+        std::uint32_t deferral_count = 0;
+
+        /// Camera revision of cached camera ray hits (zero if cache is empty), cache is guarded by destination lock
+        std::uint32_t first_hit_revision = 0;
+
+        /// Scene geometry revision of cached camera ray hits
+        std::uint32_t first_hit_geometry_revision = 0;
+
+        /// Seed of deterministic camera rays of cached hits (nullopt if they were traced with non-deterministic jitter)
+        std::optional<std::uint64_t> first_hit_seed = std::nullopt;
+
+        /// Source pointer (points to viewport framebuffer arena)
+        vec3 *source = nullptr;
 
         /// Destination pointer
-        std::unique_ptr<vec3[]> destination;
+        vec3 *destination = nullptr;
+
+        /// First-hit AOV source pointer (swapped together with `source`)
+        aov_sample *source_aov = nullptr;
+
+        /// First-hit AOV destination pointer
+        aov_sample *destination_aov = nullptr;
+
+        /// Cached camera ray hits of the first row sample
+        first_hit *first_hits = nullptr;
     };
 
-    /// Ray-tracing engine
-    class engine {
+    /// Mapping of pixel coordinates to camera image plane
+    class frame_projection {
     public:
 
-        /// Default sky tracing function
-        static vec3 default_sky_trace(vec3 _dir) {
-            return vec3(0.30f, 0.47f, 0.80f);
-        }
-
-        /// engine constructor
-        engine(
-            std::unique_ptr<shape::shape> object,
-            std::function<vec3(vec3)> trace_sky = default_sky_trace
-        ) :
-            object(std::move(object)),
-            sky_trace_function(std::move(trace_sky))
+        /// Construct projection of frame with specified resolution
+        frame_projection(std::size_t width, std::size_t height):
+            width(width),
+            height(height)
         {
-            set_render_resolution(160, 100);
-            start_rendering();
+            if (width > height)
+                x_scale = (float)width / height;
+            else
+                y_scale = (float)height / width;
+
+            x_mul = 2.0f * x_scale / width;
+            y_mul = 2.0f * y_scale / height;
         }
 
-        /// Set size of displayed buffer (does nothing if current size is equal to requested)
-        void set_render_resolution(std::size_t width, std::size_t height) {
-            // Do not resize if it's not required
-            if (width == render_width && height == render_height)
-                return;
+        /// Frame width
+        std::size_t width;
 
-            stop_rendering();
+        /// Frame height
+        std::size_t height;
 
-            render_width = width;
-            render_height = height;
+        /// Image plane half-width
+        float x_scale = 1.0f;
 
-            rows.clear();
-            for (std::size_t y = 0; y < height; y++)
-                rows.push_back(render_row(width));
+        /// Image plane half-height
+        float y_scale = 1.0f;
 
-            start_rendering();
-        }
+        /// Image plane width of single pixel
+        float x_mul;
 
-        /// Set new camera state
-        void set_camera(camera new_camera) {
-            auto curr = dynamic_state.load();
+        /// Image plane height of single pixel
+        float y_mul;
+    };
 
-            // Update dynamic state
-            dynamic_state.store(std::make_shared<dynamic_frame_state>(dynamic_frame_state {
-                .render_camera = new_camera,
-                .revision = get_dynamic_state_revision(), // Generate new identifier
-            }));
+    /// Animation sequence rendering statistics
+    struct sequence_statistics {
+        /// Count of rendered frames
+        std::size_t frame_count = 0;
+
+        /// Total rendering time (including output callbacks)
+        float seconds = 0.0f;
+
+        /// Rendering throughput
+        float frames_per_hour = 0.0f;
+    };
+
+    /// Closest hit of batched ray query
+    struct ray_hit {
+        /// Distance to hit point (`intersection::INF_DISTANCE` if ray missed)
+        float distance = intersection::INF_DISTANCE;
+
+        /// Identifier of hit scene object (`shape::scene::NO_OBJECT` if ray missed)
+        shape::scene::object_id object = shape::scene::NO_OBJECT;
+
+        /// Surface normal at hit point
+        vec3 normal {0.0f};
+    };
+
+    /// Ray tracing algorithm
+    enum class render_mode {
+        /// Every pixel path is followed through intersection and shading at once
+        per_pixel,
+
+        /// Paths of row are traced bounce by bounce: rays are sorted by direction and origin cell
+        /// before intersection, hits are shaded grouped by material, shadow rays are traced as separate batch
+        wavefront,
+    };
+
+    /// Rendering settings (accumulated samples are dropped when they change)
+    struct render_settings {
+        /// Ray tracing algorithm
+        render_mode mode = render_mode::per_pixel;
+
+        /// Count of diffuse bounces, zero for preview shading (ambient or fixed directional light, no indirect lighting)
+        std::uint32_t max_bounces = 0;
+
+        /// Every pixel sample gets own random stream derived from `seed`, pixel and sample index, so result
+        /// after the same count of samples is bit-identical at any thread count and scheduling (a bit slower)
+        bool is_deterministic = false;
+
+        /// Seed of deterministic random streams
+        std::uint64_t seed = 0;
+    };
+
+    /// Shading parameters that don't change ray hits. Their changes restart accumulation, but viewports
+    /// take the first sample from cached camera ray hits then, so only shading and secondary rays are traced.
+    struct shading_settings {
+        /// Direction to fixed light of preview mode in scenes without lights
+        vec3 preview_light_direction = vec3(0.30f, 0.47f, 0.80f).normalized();
+
+        /// Scene materials replaced in shading (scene material and its replacement)
+        std::vector<std::pair<std::shared_ptr<const material>, material>> material_overrides {};
+
+        /// Get material that scene material `m` is shaded with
+        const material & get_material(const material &m) const noexcept {
+            for (const auto &[scene_material, replacement] : material_overrides)
+                if (scene_material.get() == &m)
+                    return replacement;
+            return m;
         }
 
-        /// Display frame
-        void display_frame(std::byte *frame_ptr, std::size_t pitch) {
+        /// Get hash of shading parameters
+        std::uint64_t get_hash() const {
+            hasher h;
+            h.add(preview_light_direction);
+            for (const auto &[scene_material, replacement] : material_overrides)
+                h.add(scene_material->get_hash()).add(replacement.get_hash());
+            return h.get();
+        }
+    };
+
+    /// Frame region sampled more (or less) often than the rest of frame
+    struct priority_region {
+        /// Left column
+        std::size_t x = 0;
+
+        /// Top row
+        std::size_t y = 0;
+
+        /// Width in pixels
+        std::size_t width = 0;
+
+        /// Height in pixels
+        std::size_t height = 0;
+
+        /// Sampling rate relative to pixels outside of all regions
+        float weight = 1.0f;
+    };
+
+    /// Ray-tracing engine
+    class engine {
+    public:
+
+        /// Engine scene view with its own camera and framebuffer.
+        /// All viewports share engine scene and executor, every viewport gets share of threads proportional to its weight.
+        class viewport {
+        public:
+
+            /// Construct viewport (rendering starts on the first resolution set)
+            viewport(engine &owner, float weight):
+                owner(owner),
+                dynamic_state(std::make_shared<dynamic_frame_state>(dynamic_frame_state {
+                    .shading = owner.shading,
+                })),
+                weight(weight)
+            {
+            }
+
+            /// Viewport destructor
+            ~viewport() {
+                stop_checkpointing();
+                stop_rendering();
+            }
+
+            /// Set size of displayed buffer (does nothing if current size is equal to requested).
+            /// Accumulated samples are resampled to the new size and kept as history with reduced sample count.
+            /// Returns false if framebuffer can't be allocated, previous resolution and samples are kept then.
+            bool set_render_resolution(std::size_t width, std::size_t height) {
+                // Do not resize if it's not required
+                if (width == render_width && height == render_height)
+                    return true;
 
-            for (auto &row : rows) {
-                std::lock_guard row_source_lock {row.source_lock};
+                RT_PROFILE_ZONE("set render resolution");
 
-                const float color_coef = 255.0f / row.collected_count;
+                const std::size_t row_size = render_row::get_memory_size(width);
+                if (height != 0 && row_size > std::numeric_limits<std::size_t>::max() / height)
+                    return false;
 
-                vec3 *data = row.source.get();
-                std::size_t counter = render_width;
-                while (counter--) {
-                    std::uint32_t compressed = 0
-                        | (static_cast<std::uint8_t>(data->x * color_coef) << 16)
-                        | (static_cast<std::uint8_t>(data->y * color_coef) <<  8)
-                        | (static_cast<std::uint8_t>(data->z * color_coef) <<  0);
+                std::lock_guard rows_guard {rows_lock};
+                stop_rendering();
 
-                    std::memcpy(frame_ptr, &compressed, 4);
-                    frame_ptr += 4;
-                    data++;
+                // New rows may reuse framebuffer memory, so history is copied aside
+                const accumulation_history history = get_accumulation_history();
+
+                // Whole framebuffer is single arena block, reused if new size fits into it.
+                // Current block is released only after new one is allocated, so current rows survive failure.
+                std::byte *memory = framebuffer.reserve(std::max<std::size_t>(row_size * height, 1));
+                if (memory == nullptr) {
+                    start_rendering();
+                    return false;
                 }
-                frame_ptr += pitch - render_width * 4;
+
+                render_width = width;
+                render_height = height;
+
+                rows.clear();
+                rows.reserve(height);
+                for (std::size_t y = 0; y < height; y++)
+                    rows.push_back(render_row(memory + y * row_size, width));
+
+                apply_accumulation_history(history);
+                start_rendering();
+                return true;
             }
-        }
 
-    private:
+            /// Set new camera state
+            void set_camera(camera new_camera) {
+                std::lock_guard update_guard {dynamic_state_update_lock};
+                const std::shared_ptr current_state = dynamic_state.load();
+
+                // Update dynamic state
+                dynamic_state.store(std::make_shared<dynamic_frame_state>(dynamic_frame_state {
+                    .render_camera = new_camera,
+                    .shading = current_state->shading,
+                    .revision = owner.get_dynamic_state_revision(), // Generate new identifier
+                    .shading_revision = current_state->shading_revision,
+                }));
+            }
 
-        /// Run executor of rendering process
-        void start_rendering() {
-            if (render_executor.has_value())
-                return;
+            /// Set shading parameters of viewport. Accumulation restarts, but the first sample reuses
+            /// camera ray hits cached for the current camera if scene geometry didn't change since.
+            void set_shading(shading_settings new_shading) {
+                std::lock_guard update_guard {dynamic_state_update_lock};
+                const std::shared_ptr current_state = dynamic_state.load();
+
+                dynamic_state.store(std::make_shared<dynamic_frame_state>(dynamic_frame_state {
+                    .render_camera = current_state->render_camera,
+                    .shading = std::make_shared<const shading_settings>(std::move(new_shading)),
+                    .revision = current_state->revision,
+                    .shading_revision = owner.get_dynamic_state_revision(),
+                }));
+            }
 
-            std::size_t thread_count = std::thread::hardware_concurrency() - 1;
-            std::vector<std::function<void(std::size_t)>> thread_fns;
-            thread_fns.reserve(thread_count);
+            /// Get viewport shading parameters
+            shading_settings get_shading() const {
+                return *dynamic_state.load()->shading;
+            }
+
+            /// Get current camera
+            camera get_camera() const {
+                return dynamic_state.load()->render_camera;
+            }
+
+            /// Set share of rendering threads the viewport gets
+            void set_weight(float new_weight) {
+                weight = new_weight;
+                if (render_job != nullptr)
+                    owner.render_executor.set_job_weight(render_job.get(), weight);
+            }
 
-            for (std::size_t thread_index = 0; thread_index < thread_count; thread_index++) {
-                random::xoshiro256pp thread_random{thread_index};
-                const std::size_t width = render_width;
-                const std::size_t height = render_height;
+            /// Set regions sampled proportionally to their weights (rows are scheduling unit, so whole rows crossing region
+            /// get its rate, the greatest weight wins for overlapping regions). Takes effect without rendering restart.
+            void set_priority_regions(std::vector<priority_region> regions) {
+                priority_regions = std::move(regions);
+                update_row_weights();
+            }
 
-                float x_scale = 1.0f;
-                float y_scale = 1.0f;
-                if (width > height)
-                    x_scale = (float)width / height;
-                else
-                    y_scale = (float)height / width;
+            /// Get minimal count of samples accumulated by pixels of region for the current camera and scene
+            std::uint32_t get_region_sample_count(const priority_region &region) {
+                const std::shared_ptr frame_dynamic_state = dynamic_state.load();
+                const std::shared_ptr frame_scene_state = owner.scene_state.load();
 
-                const float x_mul = 2.0f * x_scale / width;
-                const float y_mul = 2.0f * y_scale / height;
+                // Rows may be reallocated by resolution change
+                std::lock_guard rows_guard {rows_lock};
 
-                thread_fns.push_back([
-                    thread_random,
-                    width,
-                    height,
-                    x_mul,
-                    y_mul,
-                    x_scale,
-                    y_scale,
-                    this
-                ](std::size_t y) mutable {
+                std::uint32_t min_count = ~0u;
+                for (std::size_t y = region.y; y < std::min(region.y + region.height, rows.size()); y++) {
+                    render_row &row = rows[y];
+                    std::lock_guard source_guard {row.source_lock};
+                    const bool is_current = is_row_current(row, *frame_dynamic_state, frame_scene_state->revision);
+                    min_count = std::min(min_count, is_current ? row.collected_count : 0);
+                }
+                return min_count == ~0u ? 0 : min_count;
+            }
+
+            /// Enable or disable denoising of displayed frames
+            void set_denoising(bool is_enabled) {
+                if (!is_enabled)
+                    display_denoiser.reset();
+                else if (display_denoiser == nullptr)
+                    display_denoiser = std::make_unique<denoiser>(&owner.render_executor);
+            }
+
+            /// Set denoiser settings (has effect only if denoising is enabled)
+            void set_denoiser_settings(denoiser::settings settings) {
+                if (display_denoiser != nullptr)
+                    display_denoiser->set_settings(settings);
+            }
+
+            /// Get total count of pixel samples collected by viewport (grows with every row sample, never reset).
+            /// Displayed frame can't change while it stays the same.
+            std::uint64_t get_sample_count() const noexcept {
+                return sample_count.load(std::memory_order_relaxed);
+            }
+
+            /// Display frame
+            void display_frame(std::byte *frame_ptr, std::size_t pitch) {
+                RT_PROFILE_ZONE("display frame");
+
+                if (display_denoiser != nullptr) {
+                    display_denoised_frame(frame_ptr, pitch);
+                    return;
+                }
+
+                for (auto &row : rows) {
+                    std::lock_guard row_source_lock {row.source_lock};
+
+                    const float color_coef = 255.0f / row.collected_count;
+
+                    vec3 *data = row.source;
+                    std::size_t counter = render_width;
+                    while (counter--) {
+                        std::uint32_t compressed = pack_color(*data, color_coef);
+
+                        std::memcpy(frame_ptr, &compressed, 4);
+                        frame_ptr += 4;
+                        data++;
+                    }
+                    frame_ptr += pitch - render_width * 4;
+                }
+            }
+
+            /// Snapshot accumulated frame (rows are copied under their locks, so rendering is not paused).
+            /// Frame is passed through denoiser if denoising is enabled.
+            image capture_frame() {
+                RT_PROFILE_ZONE("capture frame");
+
+                image frame {render_width, render_height};
+
+                if (display_denoiser != nullptr) {
+                    denoise_rows();
+                    for (std::size_t y = 0; y < render_height; y++)
+                        for (std::size_t x = 0; x < render_width; x++)
+                            frame.set(x, y, display_denoiser->get(x, y));
+                    return frame;
+                }
+
+                for (std::size_t y = 0; y < rows.size(); y++) {
                     render_row &row = rows[y];
+                    std::span<vec3> destination = frame.get_row(y);
 
-                    // Disallow concurrent destination data access
-                    std::lock_guard destination_guard {row.destination_lock};
+                    // Only copy is done under lock, normalization happens after it
+                    std::uint32_t collected_count;
+                    {
+                        std::lock_guard row_source_lock {row.source_lock};
+                        std::memcpy(destination.data(), row.source, sizeof(vec3) * render_width);
+                        collected_count = row.collected_count;
+                    }
 
-                    // Acquire target dynamic frame state revision
-                    std::shared_ptr frame_dynamic_state = dynamic_state.load(std::memory_order_relaxed);
+                    const vec3 scale {1.0f / collected_count};
+                    for (vec3 &pixel : destination)
+                        pixel = pixel * scale;
+                }
 
-                    const camera camera = frame_dynamic_state->render_camera;
+                return frame;
+            }
 
-                    const bool is_new_revision = row.frame_revision != frame_dynamic_state->revision;
+            /// Resolve frame (denoised if denoising is enabled) right into the next slot of export ring and publish it.
+            /// Returns false if frame is larger than ring slots.
+            bool export_frame(frame_export &target) {
+                RT_PROFILE_ZONE("export frame");
 
-                    vec3 *destination = row.destination.get();
-                    const vec3 *source = is_new_revision ? destination : row.source.get();
+                std::byte *frame_ptr = target.begin_frame(render_width, render_height);
+                if (frame_ptr == nullptr)
+                    return false;
 
-                    if (is_new_revision)
-                        std::memset(destination, 0, sizeof(vec3) * width);
+                // Count is taken before resolve, so frame has at least that many samples
+                std::uint32_t min_count = rows.empty() ? 0 : ~0u;
+                for (auto &row : rows) {
+                    std::lock_guard row_source_lock {row.source_lock};
+                    min_count = std::min(min_count, row.collected_count);
+                }
 
-                    constexpr double bias_norm = (double)std::numeric_limits<std::uint64_t>::max();
-                    float bias_y = (double)thread_random.next() / bias_norm;
+                display_frame(frame_ptr, target.get_pitch());
+                target.publish_frame(min_count);
+                return true;
+            }
 
-                    float y_float = y_scale - (bias_y + y) * y_mul;
-                    const vec3 base_direction = camera.forward + camera.up * vec3(y_float);
-                    ray r {
-                        .origin = camera.location,
-                        .direction = vec3(0.0),
-                    };
-                    intersection intr;
-                    const vec3 light_dir = vec3(0.30, 0.47, 0.80).normalized();
+            /// Write checkpoint of accumulated samples to `path` every `interval` from background thread.
+            /// Rendering is not paused, rows are copied under their locks.
+            void start_checkpointing(std::string path, std::chrono::milliseconds interval) {
+                stop_checkpointing();
 
-                    for (std::size_t x = 0; x < width; x++) {
-                        float x_float = ((double)thread_random.next() / bias_norm + x) * x_mul - x_scale;
-                        r.direction = (base_direction + camera.right * vec3(x_float)).normalized();
+                checkpoint_thread = std::jthread([this, path = std::move(path), interval](std::stop_token stop_token) {
+                    std::unique_ptr<checkpoint_file> file;
+                    std::mutex wait_lock;
+                    std::condition_variable_any stop_notification;
 
-                        vec3 color;
-                        if (object->intersect(r, intr)) {
-                            float nv = std::clamp(light_dir.dot(intr.normal), 0.1f, 1.0f);
+                    // Wait is interrupted by stop request
+                    std::unique_lock wait_guard {wait_lock};
+                    while (!stop_notification.wait_for(wait_guard, stop_token, interval, [&]() { return stop_token.stop_requested(); }))
+                        write_checkpoint(path, file);
+                });
+            }
 
-                            color = intr.hit_material->color * vec3(nv);
-                        } else {
-                            color = sky_trace_function(r.direction);
-                        }
+            /// Stop background checkpoint writes (waits for the running write)
+            void stop_checkpointing() {
+                if (checkpoint_thread.joinable()) {
+                    checkpoint_thread.request_stop();
+                    checkpoint_thread.join();
+                }
+            }
 
-                        *destination++ = *source++ + color;
+            /// Write checkpoint to `path` now, returns false on failure
+            bool write_checkpoint(const std::string &path) {
+                std::unique_ptr<checkpoint_file> file;
+                return write_checkpoint(path, file);
+            }
+
+            /// Continue accumulation from the last complete checkpoint in `path`, resolution and camera are taken from it.
+            /// Returns false if there is no checkpoint or it was made with other scene or render settings.
+            bool resume_from_checkpoint(const std::string &path) {
+                const std::unique_ptr<checkpoint_file> file = checkpoint_file::open(path);
+                if (file == nullptr || !file->get_active_slot().has_value())
+                    return false;
+
+                const std::uint32_t slot = *file->get_active_slot();
+                const checkpoint_file::slot_header &header = file->get_slot_header(slot);
+                const std::shared_ptr frame_scene_state = owner.scene_state.load();
+
+                if (header.scene_hash != get_content_hash(*dynamic_state.load(), *frame_scene_state->render_scene)
+                    || header.render_mode != (std::uint32_t)frame_scene_state->settings.mode
+                    || header.max_bounces != frame_scene_state->settings.max_bounces)
+                    return false;
+
+                if (!set_render_resolution(file->get_width(), file->get_height()))
+                    return false;
+
+                std::lock_guard rows_guard {rows_lock};
+                stop_rendering();
+
+                const float *c = header.camera;
+                set_camera(camera {
+                    .location = vec3(c[0], c[1], c[2]),
+                    .forward = vec3(c[3], c[4], c[5]),
+                    .right = vec3(c[6], c[7], c[8]),
+                    .up = vec3(c[9], c[10], c[11]),
+                });
+                const std::shared_ptr frame_dynamic_state = dynamic_state.load();
+
+                for (std::size_t y = 0; y < rows.size(); y++) {
+                    render_row &row = rows[y];
+                    std::lock_guard source_guard {row.source_lock};
+
+                    const std::uint32_t collected_count = file->load_row(slot, y, row.source, row.source_aov);
+                    if (collected_count != 0) {
+                        row.collected_count = collected_count;
+                        row.frame_revision = frame_dynamic_state->revision;
+                        row.scene_revision = frame_scene_state->revision;
+                        row.shading_revision = frame_dynamic_state->shading_revision;
+                    } else {
+                        // Row is restarted by the first sample
+                        std::fill_n(row.source, render_width, vec3(0.0f));
+                        std::fill_n(row.source_aov, render_width, aov_sample {});
+                        row.collected_count = 1;
+                        row.frame_revision = 0;
                     }
+                }
 
-                    // Update row information, 'present' rendered data
-                    {
+                // Rendering continues with new random streams, not the saved ones again
+                random_epoch.store(header.random_epoch, std::memory_order_relaxed);
+                start_rendering();
+                return true;
+            }
+
+        private:
+
+            /// Engine is allowed to pause viewport rendering
+            friend class engine;
+
+            /// Write checkpoint to `file`, file is (re)opened at `path` if it's null or has other frame size.
+            /// Checkpoint of other size is replaced only after the new one is complete.
+            bool write_checkpoint(const std::string &path, std::unique_ptr<checkpoint_file> &file) {
+                std::size_t width, height;
+                std::shared_ptr<dynamic_frame_state> frame_dynamic_state;
+                std::shared_ptr<scene_frame_state> frame_scene_state;
+                std::uint64_t epoch;
+
+                // Rows are copied aside under locks, file is written and synced to storage after they are released
+                std::vector<vec3> color;
+                std::vector<aov_sample> aov;
+                std::vector<std::uint32_t> collected_counts;
+                {
+                    std::lock_guard rows_guard {rows_lock};
+                    if (render_height == 0)
+                        return false;
+
+                    width = render_width;
+                    height = render_height;
+                    frame_dynamic_state = dynamic_state.load();
+                    frame_scene_state = owner.scene_state.load();
+                    epoch = random_epoch.load(std::memory_order_relaxed);
+
+                    color.resize(width * height, vec3(0.0f));
+                    aov.resize(width * height);
+                    collected_counts.resize(height, 0);
+                    for (std::size_t y = 0; y < rows.size(); y++) {
+                        render_row &row = rows[y];
                         std::lock_guard source_guard {row.source_lock};
+                        if (is_row_current(row, *frame_dynamic_state, frame_scene_state->revision)) {
+                            collected_counts[y] = row.collected_count;
+                            std::copy_n(row.source, width, color.data() + y * width);
+                            std::copy_n(row.source_aov, width, aov.data() + y * width);
+                        }
+                    }
+                }
+
+                const std::string temporary_path = path + ".tmp";
+                bool is_replacing = false;
+                if (file == nullptr || file->get_width() != width || file->get_height() != height) {
+                    // Existing checkpoint of the same size keeps its last complete slot
+                    file = checkpoint_file::open(path);
+                    if (file == nullptr || file->get_width() != width || file->get_height() != height) {
+                        file = checkpoint_file::create(temporary_path, width, height);
+                        is_replacing = true;
+                    }
+                    if (file == nullptr)
+                        return false;
+                }
+
+                const std::uint32_t slot = file->get_write_slot();
+                for (std::size_t y = 0; y < height; y++)
+                    file->store_row(slot, y, collected_counts[y], color.data() + y * width, aov.data() + y * width);
+
+                const std::optional<std::uint32_t> active_slot = file->get_active_slot();
+                const camera &c = frame_dynamic_state->render_camera;
+                checkpoint_file::slot_header &header = file->get_slot_header(slot);
+                header = checkpoint_file::slot_header {
+                    .sequence = active_slot.has_value() ? file->get_slot_header(*active_slot).sequence + 1 : 0,
+                    .scene_hash = get_content_hash(*frame_dynamic_state, *frame_scene_state->render_scene),
+                    .random_epoch = epoch,
+                    .camera = {
+                        c.location.x, c.location.y, c.location.z,
+                        c.forward.x, c.forward.y, c.forward.z,
+                        c.right.x, c.right.y, c.right.z,
+                        c.up.x, c.up.y, c.up.z,
+                    },
+                    .render_mode = (std::uint32_t)frame_scene_state->settings.mode,
+                    .max_bounces = frame_scene_state->settings.max_bounces,
+                };
+
+                // Mapping stays valid after rename, so the next checkpoints go to the replaced file
+                if (!file->commit(slot) || (is_replacing && !checkpoint_file::replace(temporary_path, path))) {
+                    file.reset();
+                    return false;
+                }
+                return true;
+            }
+
+            /// Accumulated frame averages
+            struct accumulation_history {
+                /// Frame width
+                std::size_t width = 0;
+
+                /// Frame height
+                std::size_t height = 0;
+
+                /// Average pixel colors
+                std::vector<vec3> color;
+
+                /// Average pixel AOVs
+                std::vector<aov_sample> aov;
+
+                /// Count of samples accumulated by rows (zero for rows of outdated camera or scene)
+                std::vector<std::uint32_t> collected_counts;
+            };
+
+            /// Fraction of sample count kept by resampled history (resampling blurs it and may hide features)
+            constexpr static float HISTORY_CONFIDENCE = 0.5f;
+
+            /// Get averages of current accumulated rows (rendering must be stopped)
+            accumulation_history get_accumulation_history() const {
+                const std::shared_ptr frame_dynamic_state = dynamic_state.load();
+                const std::shared_ptr frame_scene_state = owner.scene_state.load();
+
+                accumulation_history history {
+                    .width = render_width,
+                    .height = render_height,
+                    .color = std::vector<vec3>(render_width * render_height),
+                    .aov = std::vector<aov_sample>(render_width * render_height),
+                    .collected_counts = std::vector<std::uint32_t>(render_height, 0),
+                };
+
+                for (std::size_t y = 0; y < rows.size(); y++) {
+                    const render_row &row = rows[y];
+                    if (!is_row_current(row, *frame_dynamic_state, frame_scene_state->revision))
+                        continue;
+
+                    const float scale = 1.0f / row.collected_count;
+                    for (std::size_t x = 0; x < render_width; x++) {
+                        history.color[y * render_width + x] = row.source[x] * vec3(scale);
+                        history.aov[y * render_width + x] = row.source_aov[x] * scale;
+                    }
+                    history.collected_counts[y] = row.collected_count;
+                }
+                return history;
+            }
+
+            /// Initialize rows with bilinearly resampled history (rendering must be stopped).
+            /// Row keeps the smallest count of history rows it's interpolated from, scaled by confidence
+            /// and by area ratio when upscaling (every history sample covers several new pixels then).
+            void apply_accumulation_history(const accumulation_history &history) {
+                if (history.width == 0 || history.height == 0)
+                    return;
+
+                const std::shared_ptr frame_dynamic_state = dynamic_state.load();
+                const std::uint32_t scene_revision = owner.scene_state.load()->revision;
+                const float confidence = HISTORY_CONFIDENCE * std::min(
+                    (float)(history.width * history.height) / (float)(render_width * render_height),
+                    1.0f
+                );
+
+                // Sample coordinate of history for new pixel center
+                auto locate = [](std::size_t i, std::size_t size, std::size_t history_size, std::size_t &i0, std::size_t &i1, float &t) {
+                    const float position = std::clamp((i + 0.5f) * history_size / size - 0.5f, 0.0f, history_size - 1.0f);
+                    i0 = (std::size_t)position;
+                    i1 = std::min(i0 + 1, history_size - 1);
+                    t = position - i0;
+                };
+
+                std::vector<std::size_t> x0s(render_width), x1s(render_width);
+                std::vector<float> txs(render_width);
+                for (std::size_t x = 0; x < render_width; x++)
+                    locate(x, render_width, history.width, x0s[x], x1s[x], txs[x]);
+
+                for (std::size_t y = 0; y < rows.size(); y++) {
+                    std::size_t y0, y1;
+                    float ty;
+                    locate(y, render_height, history.height, y0, y1, ty);
+
+                    const std::uint32_t history_count = std::min(
+                        history.collected_counts[y0],
+                        ty > 0.0f ? history.collected_counts[y1] : history.collected_counts[y0]
+                    );
+                    const std::uint32_t collected_count = (std::uint32_t)(history_count * confidence);
+                    if (collected_count == 0)
+                        continue;
+
+                    render_row &row = rows[y];
+                    const vec3 *color0 = &history.color[y0 * history.width];
+                    const vec3 *color1 = &history.color[y1 * history.width];
+                    const aov_sample *aov0 = &history.aov[y0 * history.width];
+                    const aov_sample *aov1 = &history.aov[y1 * history.width];
+
+                    // Rows store sums, so averages are scaled by new sample count
+                    for (std::size_t x = 0; x < render_width; x++) {
+                        const std::size_t x0 = x0s[x], x1 = x1s[x];
+                        const float w00 = (1.0f - txs[x]) * (1.0f - ty) * collected_count;
+                        const float w10 = txs[x] * (1.0f - ty) * collected_count;
+                        const float w01 = (1.0f - txs[x]) * ty * collected_count;
+                        const float w11 = txs[x] * ty * collected_count;
+
+                        row.source[x] = color0[x0] * vec3(w00) + color0[x1] * vec3(w10) + color1[x0] * vec3(w01) + color1[x1] * vec3(w11);
+                        row.source_aov[x] = aov0[x0] * w00 + aov0[x1] * w10 + aov1[x0] * w01 + aov1[x1] * w11;
+                    }
+                    row.collected_count = collected_count;
+                    row.frame_revision = frame_dynamic_state->revision;
+                    row.scene_revision = scene_revision;
+                    row.shading_revision = frame_dynamic_state->shading_revision;
+                }
+            }
+
+            /// Load current rows into denoiser and run it
+            void denoise_rows() {
+                RT_PROFILE_ZONE("denoise");
+
+                display_denoiser->resize(render_width, render_height);
+
+                for (std::size_t y = 0; y < rows.size(); y++) {
+                    render_row &row = rows[y];
+                    std::lock_guard row_source_lock {row.source_lock};
+
+                    display_denoiser->load_row(y, row.source, row.source_aov, 1.0f / row.collected_count);
+                }
+
+                display_denoiser->run();
+            }
+
+            /// Recalculate row sampling weights from priority regions, rendering job is updated if they changed
+            void update_row_weights() {
+                std::vector<float> weights;
+                if (!priority_regions.empty()) {
+                    weights.assign(render_height, 0.0f);
+                    for (const priority_region &region : priority_regions)
+                        for (std::size_t y = region.y; y < std::min(region.y + region.height, render_height); y++)
+                            if (region.width != 0 && region.x < render_width)
+                                weights[y] = std::max(weights[y], region.weight);
+                    for (float &weight : weights)
+                        weight = weight > 0.0f ? weight : 1.0f;
+                }
+
+                if (weights == row_weights)
+                    return;
+                row_weights = std::move(weights);
+                if (render_job != nullptr)
+                    render_job->set_task_weights(row_weights);
+            }
+
+            /// Display frame passed through denoiser
+            void display_denoised_frame(std::byte *frame_ptr, std::size_t pitch) {
+                denoise_rows();
+
+                for (std::size_t y = 0; y < render_height; y++) {
+                    for (std::size_t x = 0; x < render_width; x++) {
+                        std::uint32_t compressed = pack_color(display_denoiser->get(x, y), 255.0f);
+                        std::memcpy(frame_ptr + x * 4, &compressed, 4);
+                    }
+                    frame_ptr += pitch;
+                }
+            }
+
+            /// Add rendering job of the viewport to engine executor
+            void start_rendering() {
+                if (render_job != nullptr || render_height == 0)
+                    return;
+
+                const std::size_t thread_count = owner.render_executor.get_thread_count();
+                std::vector<std::function<void(std::size_t)>> thread_fns;
+                thread_fns.reserve(thread_count);
+
+                // Every start gets new random streams, so restarted rows don't repeat samples
+                const std::uint64_t epoch = random_epoch.fetch_add(1, std::memory_order_relaxed) + 1;
+
+                for (std::size_t thread_index = 0; thread_index < thread_count; thread_index++) {
+                    random::xoshiro256pp thread_random{epoch << 16 | thread_index};
+                    const frame_projection projection {render_width, render_height};
+
+                    thread_fns.push_back([
+                        thread_random,
+                        projection,
+                        this
+                    ](std::size_t y) mutable {
+                        render_row &row = rows[y];
+
+                        // Disallow concurrent destination data access
+                        std::lock_guard destination_guard {row.destination_lock};
+
+                        // Acquire target dynamic frame state revision
+                        std::shared_ptr frame_dynamic_state = dynamic_state.load(std::memory_order_relaxed);
+                        std::shared_ptr frame_scene_state = owner.scene_state.load(std::memory_order_relaxed);
+
+                        const render_settings &settings = frame_scene_state->settings;
+                        const bool is_new_revision = !is_row_current(row, *frame_dynamic_state, frame_scene_state->revision);
+
+                        // The first sample of revision goes through camera ray hit cache: hits are reused if they were traced
+                        // for the same camera and geometry (e.g. only lighting or materials changed) and stored otherwise
+                        const bool is_first_hit_cached = is_new_revision
+                            && row.first_hit_revision == frame_dynamic_state->revision
+                            && row.first_hit_geometry_revision == frame_scene_state->geometry_revision
+                            && (!settings.is_deterministic || row.first_hit_seed == settings.seed);
+                        if (is_new_revision && !is_first_hit_cached)
+                            row.first_hit_revision = 0;
+
+                        vec3 *destination = row.destination;
+                        const vec3 *source = is_new_revision ? destination : row.source;
+                        aov_sample *destination_aov = row.destination_aov;
+                        const aov_sample *source_aov = is_new_revision ? destination_aov : row.source_aov;
 
                         if (is_new_revision) {
-                            row.collected_count = 0;
-                            row.frame_revision = frame_dynamic_state->revision;
+                            std::fill_n(destination, projection.width, vec3(0.0f));
+                            std::fill_n(destination_aov, projection.width, aov_sample {});
                         }
-                        row.collected_count++;
-                        std::swap(row.source, row.destination);
-                    }
 
-                });
+                        // Sample that needs non-resident geometry is dropped, row is retried on the next cycle
+                        shape::query_context::get().is_blocking = row.deferral_count >= MAX_ROW_DEFERRALS;
+                        const bool is_complete = owner.trace_row(
+                            *frame_scene_state->render_scene,
+                            settings,
+                            *frame_dynamic_state->shading,
+                            frame_dynamic_state->render_camera,
+                            projection,
+                            y,
+                            is_new_revision ? 0 : row.collected_count,
+                            thread_random,
+                            source,
+                            destination,
+                            source_aov,
+                            destination_aov,
+                            is_new_revision ? row.first_hits : nullptr,
+                            is_first_hit_cached
+                        );
+                        row.deferral_count = is_complete ? 0 : row.deferral_count + 1;
+                        if (!is_complete)
+                            return;
+
+                        if (is_new_revision && !is_first_hit_cached) {
+                            row.first_hit_revision = frame_dynamic_state->revision;
+                            row.first_hit_geometry_revision = frame_scene_state->geometry_revision;
+                            row.first_hit_seed = settings.is_deterministic ? std::optional(settings.seed) : std::nullopt;
+                        }
+
+                        // Update row information, 'present' rendered data
+                        {
+                            std::lock_guard source_guard {row.source_lock};
+
+                            if (is_new_revision) {
+                                row.collected_count = 0;
+                                row.frame_revision = frame_dynamic_state->revision;
+                                row.scene_revision = frame_scene_state->revision;
+                                row.shading_revision = frame_dynamic_state->shading_revision;
+                            }
+                            row.collected_count++;
+                            std::swap(row.source, row.destination);
+                            std::swap(row.source_aov, row.destination_aov);
+                        }
+                        sample_count.fetch_add(projection.width, std::memory_order_relaxed);
+
+                    });
+                }
+
+                // Restart viewport rendering job
+                render_job = std::make_shared<task_cycle_job>(render_height, thread_fns);
+                row_weights.clear();
+                update_row_weights();
+                owner.render_executor.add_job(render_job, weight);
             }
 
-            // Restart executor
-            render_executor.emplace(render_height, thread_fns);
-        }
+            /// Stop viewport rendering, waits for its running tasks
+            void stop_rendering() {
+                if (render_job == nullptr)
+                    return;
 
-        /// Stop rendering process, kill executor
-        void stop_rendering() {
-            render_executor.reset();
-        }
+                owner.render_executor.remove_job(render_job.get());
+                render_job.reset();
+            }
 
-        /// Things that may be changed 'on-fly' (e.g. without executor stopping>)
-        struct dynamic_frame_state {
-            /// Frame camera
-            camera render_camera {};
+            /// Things that may be changed 'on-fly' (e.g. without executor stopping>)
+            struct dynamic_frame_state {
+                /// Frame camera
+                camera render_camera {};
 
-            /// Revision of the dynamic state
-            std::uint32_t revision = 0;
-        };
+                /// Shading parameters
+                std::shared_ptr<const shading_settings> shading = std::make_shared<const shading_settings>();
 
-        /// Current dynamic render state
-        std::atomic<std::shared_ptr<dynamic_frame_state>> dynamic_state = std::make_shared<dynamic_frame_state>();
+                /// Revision of the camera (cached camera ray hits stay valid while it's the same)
+                std::uint32_t revision = 0;
 
-        /// Last revision of the dynamic state
-        std::atomic_uint32_t last_dynamic_state_revision = 1;
+                /// Revision of the shading
+                std::uint32_t shading_revision = 0;
+            };
 
-        /// Generate new unique dynamic state revision
-        std::uint32_t get_dynamic_state_revision() noexcept {
-            return last_dynamic_state_revision.fetch_add(1, std::memory_order::relaxed);
-        }
+            /// Check if row accumulates samples of current camera, shading and scene
+            static bool is_row_current(const render_row &row, const dynamic_frame_state &frame_dynamic_state, std::uint32_t scene_revision) noexcept {
+                return row.frame_revision == frame_dynamic_state.revision
+                    && row.shading_revision == frame_dynamic_state.shading_revision
+                    && row.scene_revision == scene_revision;
+            }
+
+            /// Get hash of scene and shading (checkpoint samples are valid only for both of them)
+            static std::uint64_t get_content_hash(const dynamic_frame_state &frame_dynamic_state, const shape::scene &render_scene) {
+                return hasher {}
+                    .add(render_scene.get_hash())
+                    .add(frame_dynamic_state.shading->get_hash())
+                    .get();
+            }
+
+            /// Viewport owner
+            engine &owner;
+
+            /// Current dynamic render state
+            std::atomic<std::shared_ptr<dynamic_frame_state>> dynamic_state;
+
+            /// Dynamic state modification lock (camera and shading updates keep each other)
+            std::mutex dynamic_state_update_lock;
 
-        /// Rendered frame width
-        std::size_t render_width;
+            /// Rendered frame width
+            std::size_t render_width = 0;
 
-        /// Rendered frame height
-        std::size_t render_height;
+            /// Rendered frame height
+            std::size_t render_height = 0;
 
-        /// Rendered shape (yes, single object)
-        std::unique_ptr<shape::shape> object;
+            /// Framebuffer memory
+            memory_arena framebuffer;
+
+            /// Rendered 'lines'
+            std::vector<render_row> rows;
+
+            /// Share of rendering threads
+            float weight;
+
+            /// Total count of collected pixel samples
+            std::atomic_uint64_t sample_count = 0;
+
+            /// Random seed epoch of rendering threads (incremented on every rendering start)
+            std::atomic_uint64_t random_epoch = 0;
+
+            /// Row set lock (held by resolution changes and checkpoint writes, row contents have their own locks)
+            std::mutex rows_lock;
+
+            /// Background checkpoint writer
+            std::jthread checkpoint_thread;
+
+            /// Viewport rendering job (null if rendering is stopped)
+            std::shared_ptr<task_cycle_job> render_job = nullptr;
+
+            /// Regions with non-default sampling rate
+            std::vector<priority_region> priority_regions;
+
+            /// Sampling weights of rows (empty if all rows are sampled equally)
+            std::vector<float> row_weights;
+
+            /// Denoiser of displayed frames (null if denoising is disabled)
+            std::unique_ptr<denoiser> display_denoiser = nullptr;
+        };
+
+        /// Viewport identifier
+        using viewport_id = std::uint32_t;
+
+        /// Viewport created with the engine, engine frame functions operate with it
+        constexpr static viewport_id MAIN_VIEWPORT = 0;
+
+        /// Default sky tracing function
+        static vec3 default_sky_trace(vec3 _dir) {
+            return vec3(0.30f, 0.47f, 0.80f);
+        }
+
+        /// engine constructor (`thread_count` of zero selects count of rendering threads by hardware)
+        engine(
+            shape::scene render_scene,
+            environment_map sky = environment_map::bake(default_sky_trace),
+            std::size_t thread_count = 0
+        ) :
+            sky(std::move(sky)),
+            render_executor(thread_count != 0 ? thread_count : get_worker_count())
+        {
+            set_scene(std::move(render_scene));
+            add_viewport();
+            set_render_resolution(160, 100);
+        }
+
+        /// Add viewport, `weight` is its share of rendering threads
+        viewport_id add_viewport(float weight = 1.0f) {
+            for (viewport_id id = 0; id < viewports.size(); id++)
+                if (viewports[id] == nullptr) {
+                    viewports[id] = std::make_unique<viewport>(*this, weight);
+                    return id;
+                }
+
+            viewports.push_back(std::make_unique<viewport>(*this, weight));
+            return (viewport_id)(viewports.size() - 1);
+        }
+
+        /// Remove viewport (main viewport can't be removed), waits for its running tasks
+        void remove_viewport(viewport_id id) {
+            if (id != MAIN_VIEWPORT && id < viewports.size())
+                viewports[id].reset();
+        }
+
+        /// Get viewport by identifier (viewport must exist)
+        viewport &get_viewport(viewport_id id) {
+            return *viewports[id];
+        }
+
+        /// Set main viewport buffer size (does nothing if current size is equal to requested), returns false on allocation failure
+        bool set_render_resolution(std::size_t width, std::size_t height) {
+            return get_viewport(MAIN_VIEWPORT).set_render_resolution(width, height);
+        }
+
+        /// Set main viewport camera
+        void set_camera(camera new_camera) {
+            get_viewport(MAIN_VIEWPORT).set_camera(new_camera);
+        }
+
+        /// Enable or disable denoising of main viewport frames
+        void set_denoising(bool is_enabled) {
+            get_viewport(MAIN_VIEWPORT).set_denoising(is_enabled);
+        }
+
+        /// Set main viewport denoiser settings
+        void set_denoiser_settings(denoiser::settings settings) {
+            get_viewport(MAIN_VIEWPORT).set_denoiser_settings(settings);
+        }
+
+        /// Set main viewport priority regions
+        void set_priority_regions(std::vector<priority_region> regions) {
+            get_viewport(MAIN_VIEWPORT).set_priority_regions(std::move(regions));
+        }
+
+        /// Get minimal count of samples accumulated by pixels of main viewport region
+        std::uint32_t get_region_sample_count(const priority_region &region) {
+            return get_viewport(MAIN_VIEWPORT).get_region_sample_count(region);
+        }
+
+        /// Get main viewport camera
+        camera get_camera() {
+            return get_viewport(MAIN_VIEWPORT).get_camera();
+        }
+
+        /// Resolve main viewport frame into export ring
+        bool export_frame(frame_export &target) {
+            return get_viewport(MAIN_VIEWPORT).export_frame(target);
+        }
+
+        /// Write checkpoint of main viewport to `path` every `interval` in background
+        void start_checkpointing(std::string path, std::chrono::milliseconds interval) {
+            get_viewport(MAIN_VIEWPORT).start_checkpointing(std::move(path), interval);
+        }
+
+        /// Stop background checkpoint writes of main viewport
+        void stop_checkpointing() {
+            get_viewport(MAIN_VIEWPORT).stop_checkpointing();
+        }
+
+        /// Write main viewport checkpoint now
+        bool write_checkpoint(const std::string &path) {
+            return get_viewport(MAIN_VIEWPORT).write_checkpoint(path);
+        }
+
+        /// Continue main viewport accumulation from checkpoint
+        bool resume_from_checkpoint(const std::string &path) {
+            return get_viewport(MAIN_VIEWPORT).resume_from_checkpoint(path);
+        }
+
+        /// Get total count of pixel samples collected by main viewport
+        std::uint64_t get_sample_count() {
+            return get_viewport(MAIN_VIEWPORT).get_sample_count();
+        }
+
+        /// Display main viewport frame
+        void display_frame(std::byte *frame_ptr, std::size_t pitch) {
+            get_viewport(MAIN_VIEWPORT).display_frame(frame_ptr, pitch);
+        }
+
+        /// Snapshot main viewport frame
+        image capture_frame() {
+            return get_viewport(MAIN_VIEWPORT).capture_frame();
+        }
+
+        /// Replace rendered scene, returns new scene revision
+        std::uint32_t set_scene(shape::scene new_scene) {
+            std::lock_guard update_guard {scene_update_lock};
+
+            return publish_scene(std::move(new_scene), false);
+        }
+
+        /// Modify rendered scene without rendering stop, returns new scene revision.
+        /// `update` is applied to copy of the current scene, acceleration structure is refitted
+        /// (or rebuilt if its quality degraded too much) and result is published atomically.
+        /// Updates that change only lights keep camera ray hits cached by viewports.
+        std::uint32_t update_scene(const std::function<void(shape::scene &)> &update) {
+            std::lock_guard update_guard {scene_update_lock};
+
+            const std::shared_ptr current_state = scene_state.load();
+            shape::scene new_scene = *current_state->render_scene;
+            update(new_scene);
+
+            const bool is_geometry_kept = new_scene.get_geometry_version() == current_state->render_scene->get_geometry_version();
+            return publish_scene(std::move(new_scene), is_geometry_kept);
+        }
+
+        /// Get current scene revision
+        std::uint32_t get_scene_revision() const {
+            return scene_state.load()->revision;
+        }
+
+        /// Set rendering settings, returns new scene revision (all viewports restart accumulation)
+        std::uint32_t set_render_settings(render_settings settings) {
+            std::lock_guard update_guard {scene_update_lock};
+
+            return publish_state(scene_state.load()->render_scene, settings, true);
+        }
+
+        /// Get current rendering settings
+        render_settings get_render_settings() const {
+            return scene_state.load()->settings;
+        }
+
+        /// Set shading parameters of all viewports and later renders (see `viewport::set_shading`)
+        void set_shading(shading_settings new_shading) {
+            std::lock_guard update_guard {scene_update_lock};
+
+            shading = std::make_shared<const shading_settings>(std::move(new_shading));
+            for (std::unique_ptr<viewport> &view : viewports)
+                if (view != nullptr)
+                    view->set_shading(*shading);
+        }
+
+        /// Get shading parameters
+        shading_settings get_shading() {
+            std::lock_guard update_guard {scene_update_lock};
+
+            return *shading;
+        }
+
+        /// Render camera path offline with fixed per-frame sample budget (blocks until all frames are done).
+        /// Rows continue with next frames while previous frame tail rows finish, up to `max_frames_in_flight`
+        /// frames are rendered at once. `on_frame` is called on the calling thread in frame order,
+        /// so it may encode output while workers keep rendering. Viewport rendering is paused meanwhile.
+        sequence_statistics render_sequence(
+            std::span<const camera> path,
+            std::size_t width,
+            std::size_t height,
+            std::uint32_t samples_per_frame,
+            const std::function<void(std::size_t, image)> &on_frame,
+            std::size_t max_frames_in_flight = 3
+        ) {
+            using clock = std::chrono::steady_clock;
+
+            if (path.empty() || width == 0 || height == 0)
+                return sequence_statistics {};
+
+            for (std::unique_ptr<viewport> &view : viewports)
+                if (view != nullptr)
+                    view->stop_rendering();
+            const clock::time_point start_time = clock::now();
+
+            const std::size_t frame_count = path.size();
+            const std::uint32_t sample_budget = std::max<std::uint32_t>(samples_per_frame, 1);
+            const std::size_t slot_count = std::max<std::size_t>(max_frames_in_flight, 1);
+            const std::shared_ptr frame_scene_state = scene_state.load();
+            const shading_settings frame_shading = get_shading();
+            const frame_projection projection {width, height};
+
+            /// Row accumulation state
+            struct sequence_row {
+                /// Row access lock (busy rows are skipped, not waited for)
+                spinlock lock;
+
+                /// Frame row is rendered for
+                std::size_t frame = 0;
+
+                /// Count of collected samples
+                std::uint32_t collected_count = 0;
+
+                /// Count of successive samples deferred because of non-resident geometry
+                std::uint32_t deferral_count = 0;
+
+                /// Accumulated samples
+                std::unique_ptr<vec3[]> accumulator;
+            };
+
+            std::vector<sequence_row> sequence_rows(height);
+            for (sequence_row &row : sequence_rows)
+                row.accumulator = std::make_unique<vec3[]>(width);
+
+            // Output frame ring, frame `f` is collected in slot `f % slot_count`
+            std::vector<image> slots(slot_count, image {width, height});
+            std::unique_ptr<std::atomic_size_t[]> slot_remaining_rows = std::make_unique<std::atomic_size_t[]>(slot_count);
+            for (std::size_t slot = 0; slot < slot_count; slot++)
+                slot_remaining_rows[slot].store(height, std::memory_order_relaxed);
+
+            // Count of frames passed to `on_frame`, rows can't run further than `slot_count` frames ahead
+            std::atomic_size_t released_count = 0;
+
+            std::mutex completion_lock;
+            std::condition_variable completion_changed;
+            std::size_t completed_count = 0;
+
+            std::vector<std::function<void(std::size_t)>> thread_fns;
+            for (std::size_t thread_index = 0; thread_index < render_executor.get_thread_count(); thread_index++) {
+                thread_fns.push_back([
+                    &,
+                    thread_random = random::xoshiro256pp {thread_index},
+                    sample = std::vector<vec3>(width)
+                ](std::size_t y) mutable {
+                    sequence_row &row = sequence_rows[y];
+
+                    if (!row.lock.try_lock())
+                        return;
+                    std::lock_guard row_guard {row.lock, std::adopt_lock};
+
+                    // Row is done or waits for output slot
+                    if (row.frame >= frame_count || row.frame >= released_count.load(std::memory_order_acquire) + slot_count) {
+                        std::this_thread::yield();
+                        return;
+                    }
+
+                    // Sample is traced aside, so deferred one doesn't spoil the accumulator
+                    vec3 *accumulator = row.accumulator.get();
+                    shape::query_context::get().is_blocking = row.deferral_count >= MAX_ROW_DEFERRALS;
+                    const bool is_complete = trace_row(
+                        *frame_scene_state->render_scene,
+                        frame_scene_state->settings,
+                        frame_shading,
+                        path[row.frame],
+                        projection,
+                        y,
+                        (std::uint32_t)(row.frame * sample_budget + row.collected_count),
+                        thread_random,
+                        accumulator,
+                        sample.data()
+                    );
+                    row.deferral_count = is_complete ? 0 : row.deferral_count + 1;
+                    if (!is_complete)
+                        return;
+                    std::copy_n(sample.data(), width, accumulator);
+
+                    if (++row.collected_count < sample_budget)
+                        return;
+
+                    // Resolve row into output frame and start the next one
+                    const std::size_t slot = row.frame % slot_count;
+                    const vec3 scale {1.0f / sample_budget};
+                    std::span<vec3> output = slots[slot].get_row(y);
+                    for (std::size_t x = 0; x < width; x++)
+                        output[x] = accumulator[x] * scale;
+
+                    std::fill_n(accumulator, width, vec3(0.0f));
+                    row.collected_count = 0;
+                    row.frame++;
+
+                    if (slot_remaining_rows[slot].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                        {
+                            std::lock_guard completion_guard {completion_lock};
+                            completed_count++;
+                        }
+                        completion_changed.notify_all();
+                    }
+                });
+            }
+
+            {
+                const std::shared_ptr sequence_job = std::make_shared<task_cycle_job>(height, thread_fns);
+                render_executor.add_job(sequence_job);
+
+                // Frames complete in order, because every row finishes frames sequentially
+                for (std::size_t frame = 0; frame < frame_count; frame++) {
+                    {
+                        std::unique_lock completion_guard {completion_lock};
+                        completion_changed.wait(completion_guard, [&]() { return completed_count > frame; });
+                    }
+
+                    const std::size_t slot = frame % slot_count;
+                    image result = std::exchange(slots[slot], image {width, height});
+                    slot_remaining_rows[slot].store(height, std::memory_order_relaxed);
+                    released_count.store(frame + 1, std::memory_order_release);
+
+                    on_frame(frame, std::move(result));
+                }
+
+                render_executor.remove_job(sequence_job.get());
+            }
+
+            for (std::unique_ptr<viewport> &view : viewports)
+                if (view != nullptr)
+                    view->start_rendering();
+
+            const float seconds = std::chrono::duration<float>(clock::now() - start_time).count();
+            return sequence_statistics {
+                .frame_count = frame_count,
+                .seconds = seconds,
+                .frames_per_hour = seconds > 0.0f ? frame_count * 3600.0f / seconds : 0.0f,
+            };
+        }
+
+        /// Request asynchronous rendering of single frame with fixed per-pixel sample budget.
+        /// Requests share rendering threads with viewports and each other,
+        /// every job gets share of threads proportional to its `priority`.
+        /// Scene is captured at request time, later scene updates don't affect the result.
+        /// Result is passed through denoiser with `denoising` settings if they are specified.
+        render_task render(
+            camera render_camera,
+            std::size_t width,
+            std::size_t height,
+            std::uint32_t samples,
+            float priority = 1.0f,
+            std::optional<denoiser::settings> denoising = std::nullopt
+        ) {
+            std::shared_ptr state = std::make_shared<render_task_state>();
+
+            if (width == 0 || height == 0) {
+                state->complete(image {width, height});
+                return render_task {std::move(state)};
+            }
+
+            render_executor.add_job(std::make_shared<render_request_job>(
+                *this,
+                scene_state.load(),
+                std::make_shared<const shading_settings>(get_shading()),
+                render_camera,
+                frame_projection {width, height},
+                std::max<std::uint32_t>(samples, 1),
+                denoising,
+                state
+            ), priority);
+
+            return render_task {std::move(state)};
+        }
+
+        /// Find closest hits of `rays` in the current scene, `hits[i]` gets hit of `rays[i]`.
+        /// Blocks until done, batch chunks are traced by calling thread and rendering threads (with `priority` share).
+        /// Requires `hits.size() >= rays.size()`, returns false without tracing anything otherwise.
+        bool intersect_batch(std::span<const ray> rays, std::span<ray_hit> hits, float priority = 1.0f) {
+            assert(hits.size() >= rays.size());
+            if (hits.size() < rays.size())
+                return false;
+
+            const std::shared_ptr frame_scene_state = scene_state.load();
+            const shape::scene &object = *frame_scene_state->render_scene;
+
+            run_batch(rays, priority, [&](std::span<const std::uint32_t> packet) {
+                ray packet_rays[shape::scene::PACKET_SIZE];
+                intersection packet_intrs[shape::scene::PACKET_SIZE];
+                shape::scene::object_id packet_ids[shape::scene::PACKET_SIZE];
+                for (std::size_t lane = 0; lane < packet.size(); lane++)
+                    packet_rays[lane] = rays[packet[lane]];
+
+                object.intersect_packet(std::span(packet_rays, packet.size()), packet_intrs, packet_ids);
+
+                for (std::size_t lane = 0; lane < packet.size(); lane++)
+                    hits[packet[lane]] = packet_ids[lane] == shape::scene::NO_OBJECT
+                        ? ray_hit {}
+                        : ray_hit {
+                            .distance = packet_intrs[lane].distance,
+                            .object = packet_ids[lane],
+                            .normal = packet_intrs[lane].normal,
+                        };
+            });
+            return true;
+        }
+
+        /// Check if `rays` hit anything in the current scene closer than `max_distances` (all distances are infinite
+        /// if it's empty), `occluded[i]` is set to 1 or 0. Blocks until done, parallelized the same way as `intersect_batch`.
+        /// Requires `occluded.size() >= rays.size()` and empty or at least `rays.size()` long `max_distances`,
+        /// returns false without tracing anything otherwise.
+        bool occluded_batch(std::span<const ray> rays, std::span<const float> max_distances, std::span<std::uint8_t> occluded, float priority = 1.0f) {
+            assert(occluded.size() >= rays.size());
+            assert(max_distances.empty() || max_distances.size() >= rays.size());
+            if (occluded.size() < rays.size() || (!max_distances.empty() && max_distances.size() < rays.size()))
+                return false;
+
+            const std::shared_ptr frame_scene_state = scene_state.load();
+            const shape::scene &object = *frame_scene_state->render_scene;
+
+            run_batch(rays, priority, [&](std::span<const std::uint32_t> packet) {
+                ray packet_rays[shape::scene::PACKET_SIZE];
+                float packet_distances[shape::scene::PACKET_SIZE];
+                bool packet_occluded[shape::scene::PACKET_SIZE];
+                for (std::size_t lane = 0; lane < packet.size(); lane++) {
+                    packet_rays[lane] = rays[packet[lane]];
+                    packet_distances[lane] = max_distances.empty() ? intersection::INF_DISTANCE : max_distances[packet[lane]];
+                }
+
+                object.check_intersection_packet(std::span(packet_rays, packet.size()), packet_distances, packet_occluded);
+
+                for (std::size_t lane = 0; lane < packet.size(); lane++)
+                    occluded[packet[lane]] = packet_occluded[lane];
+            });
+            return true;
+        }
+
+    private:
+
+        /// Count of rays in batched query chunk (unit of parallel work, rays are sorted within it)
+        constexpr static std::size_t BATCH_CHUNK_SIZE = 1024;
+
+        /// Batched ray query, chunks are taken by executor threads and by thread that waits for the batch
+        class ray_batch_job : public executor_job {
+        public:
+
+            /// Construct job of `size` queries, `run_chunk` is called with query ranges
+            ray_batch_job(std::size_t size, std::function<void(std::size_t, std::size_t)> run_chunk):
+                size(size),
+                chunk_count((size + BATCH_CHUNK_SIZE - 1) / BATCH_CHUNK_SIZE),
+                run_chunk(std::move(run_chunk)),
+                remaining_chunks(chunk_count)
+            {
+            }
+
+            /// Trace next chunk
+            virtual status run_task(std::size_t) override {
+                return run_next_chunk() ? status::done : status::finished;
+            }
+
+            /// Trace chunks on calling thread while there are any, then wait for chunks taken by other threads
+            void run_and_wait() {
+                while (run_next_chunk())
+                    ;
+
+                std::unique_lock guard {lock};
+                completion_changed.wait(guard, [&]() { return is_complete; });
+            }
+
+        private:
+
+            /// Trace chunk, returns false if there are no chunks left (`run_chunk` is never called after that)
+            bool run_next_chunk() {
+                const std::size_t chunk = next_chunk.fetch_add(1, std::memory_order_relaxed);
+                if (chunk >= chunk_count)
+                    return false;
+
+                run_chunk(chunk * BATCH_CHUNK_SIZE, std::min(size, (chunk + 1) * BATCH_CHUNK_SIZE));
+
+                if (remaining_chunks.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    {
+                        std::lock_guard guard {lock};
+                        is_complete = true;
+                    }
+                    completion_changed.notify_all();
+                }
+                return true;
+            }
+
+            /// Count of queries
+            const std::size_t size;
+
+            /// Count of chunks
+            const std::size_t chunk_count;
+
+            /// Chunk function (references caller data, so it's only called for taken chunks)
+            std::function<void(std::size_t, std::size_t)> run_chunk;
+
+            /// Next chunk to take
+            std::atomic_size_t next_chunk = 0;
+
+            /// Count of chunks that aren't traced yet
+            std::atomic_size_t remaining_chunks;
+
+            /// Completion lock
+            std::mutex lock;
+
+            /// True if all chunks are traced
+            bool is_complete = false;
+
+            /// Completion notification
+            std::condition_variable completion_changed;
+        };
+
+        /// Minimal cosine between directions of packet rays traced together
+        constexpr static float MIN_PACKET_COHERENCE = 0.9f;
+
+        /// Check if packet rays have close directions
+        static bool is_coherent_packet(std::span<const ray> rays, std::span<const std::uint32_t> packet) {
+            const vec3 direction = rays[packet[0]].direction;
+            for (std::uint32_t index : packet.subspan(1))
+                if (rays[index].direction.dot(direction) < MIN_PACKET_COHERENCE)
+                    return false;
+            return true;
+        }
+
+        /// Run batched query: rays of every chunk are sorted for coherence and passed to `trace_packet`
+        /// by packets of `shape::scene::PACKET_SIZE` indices. Non-resident geometry is always waited for.
+        template <typename packet_tracer>
+        void run_batch(std::span<const ray> rays, float priority, packet_tracer &&trace_packet) {
+            if (rays.empty())
+                return;
+
+            const std::shared_ptr job = std::make_shared<ray_batch_job>(rays.size(), [&](std::size_t begin, std::size_t end) {
+                RT_PROFILE_ZONE("ray batch chunk");
+
+                shape::query_context &context = shape::query_context::get();
+                const bool was_blocking = context.is_blocking;
+                context.is_blocking = true;
+
+                thread_local std::vector<std::uint64_t> order;
+                thread_local std::vector<std::uint32_t> indices;
+                sort_rays(end - begin, [&](std::size_t i) -> const ray & { return rays[begin + i]; }, order);
+                indices.resize(order.size());
+                for (std::size_t i = 0; i < order.size(); i++)
+                    indices[i] = (std::uint32_t)(begin + (std::uint32_t)order[i]);
+
+                // Rays that diverge are traced alone, shared traversal of them would only visit more nodes
+                for (std::size_t i = 0; i < indices.size(); i += shape::scene::PACKET_SIZE) {
+                    const std::span<const std::uint32_t> packet = std::span(indices).subspan(i, std::min(shape::scene::PACKET_SIZE, indices.size() - i));
+                    if (is_coherent_packet(rays, packet))
+                        trace_packet(packet);
+                    else
+                        for (std::size_t lane = 0; lane < packet.size(); lane++)
+                            trace_packet(packet.subspan(lane, 1));
+                }
+
+                context.is_blocking = was_blocking;
+            });
+
+            // Single chunk isn't worth waking up executor threads
+            if (rays.size() > BATCH_CHUNK_SIZE)
+                render_executor.add_job(job, priority);
+            job->run_and_wait();
+            render_executor.remove_job(job.get());
+        }
+
+        /// Convert color to BGRX pixel
+        static std::uint32_t pack_color(vec3 color, float color_coef) {
+            return 0
+                | (static_cast<std::uint8_t>(color.x * color_coef) << 16)
+                | (static_cast<std::uint8_t>(color.y * color_coef) <<  8)
+                | (static_cast<std::uint8_t>(color.z * color_coef) <<  0);
+        }
+
+        /// Count of successive deferrals after which row sample waits for non-resident geometry
+        constexpr static std::uint32_t MAX_ROW_DEFERRALS = 8;
+
+        /// Get count of rendering threads
+        static std::size_t get_worker_count() {
+            // One core is left to the display thread, but at least one worker is always spawned
+            return std::max(std::thread::hardware_concurrency(), 2u) - 1;
+        }
+
+        /// Scene and settings that may be changed 'on-fly'
+        struct scene_frame_state {
+            /// Rendered scene (immutable, modifications produce new state)
+            std::shared_ptr<const shape::scene> render_scene;
+
+            /// Rendering settings
+            render_settings settings {};
+
+            /// Revision of the scene
+            std::uint32_t revision = 0;
+
+            /// Revision of the scene geometry (kept by updates that don't change ray hits, e.g. light changes)
+            std::uint32_t geometry_revision = 0;
+        };
+
+        /// Ambient lighting of surfaces in preview mode of scenes with lights
+        constexpr static float AMBIENT_LIGHT = 0.1f;
+
+        /// Secondary ray origin offset along surface normal
+        constexpr static float SURFACE_BIAS = 1e-3f;
+
+        /// Light sample waiting for shadow test
+        struct shadow_query {
+            /// Ray from surface point to light
+            ray shadow_ray;
+
+            /// Distance to light along shadow ray
+            float max_distance;
+
+            /// Radiance added if shadow ray is not occluded
+            vec3 contribution;
+        };
+
+        /// Sample light chosen by light tree for surface point, writes shadow test to `query`.
+        /// Contribution is irradiance divided by pi, returns false if sampled light can't contribute.
+        /// Lights are not visible to camera rays, only their contribution to surfaces is.
+        static bool sample_light(const shape::scene &object, vec3 point, vec3 normal, random::xoshiro256pp &random, shadow_query &query) {
+            std::uint32_t light_index;
+            float probability;
+            if (!object.get_light_tree().select(point, normal, random.next_float(), light_index, probability))
+                return false;
+
+            const float u0 = random.next_float();
+            const float u1 = random.next_float();
+            const light_sample sample = object.get_lights()[light_index].sample(point, u0, u1);
+
+            const float cos_theta = normal.dot(sample.direction);
+            if (cos_theta <= 0.0f || sample.distance <= SURFACE_BIAS * 2.0f)
+                return false;
+
+            query = shadow_query {
+                .shadow_ray = ray {
+                    .origin = point + normal * vec3(SURFACE_BIAS),
+                    .direction = sample.direction,
+                },
+                .max_distance = sample.distance - SURFACE_BIAS * 2.0f,
+                .contribution = sample.radiance * vec3(cos_theta / (std::numbers::pi_v<float> * probability)),
+            };
+            return true;
+        }
+
+        /// Get lighting of surface point that doesn't need rays: ambient or fixed directional light in preview mode, zero otherwise
+        static vec3 get_local_lighting(const shading_settings &shading, bool has_lights, std::uint32_t max_bounces, vec3 normal) {
+            if (max_bounces != 0)
+                return vec3(0.0f);
+            if (has_lights)
+                return vec3(AMBIENT_LIGHT);
+
+            // Scenes without lights are lit by fixed directional light
+            return vec3(std::clamp(shading.preview_light_direction.dot(normal), 0.1f, 1.0f));
+        }
+
+        /// Get power heuristic MIS weight of sampling strategy with density `pdf` combined with strategy of density `other_pdf`
+        static float get_mis_weight(float pdf, float other_pdf) {
+            return pdf * pdf / (pdf * pdf + other_pdf * other_pdf);
+        }
+
+        /// Sample sky radiance coming to surface point by environment map distribution, writes shadow test to `query`.
+        /// Contribution is as in `sample_light` and MIS-weighted against diffuse bounce ray, returns false if sample can't contribute.
+        bool sample_environment(vec3 point, vec3 normal, random::xoshiro256pp &random, shadow_query &query) const {
+            const float u0 = random.next_float();
+            const float u1 = random.next_float();
+            const environment_sample sample = sky.sample(u0, u1);
+
+            const float cos_theta = normal.dot(sample.direction);
+            if (cos_theta <= 0.0f || sample.pdf <= 0.0f)
+                return false;
+
+            const float bounce_pdf = cos_theta * std::numbers::inv_pi_v<float>;
+            query = shadow_query {
+                .shadow_ray = ray {
+                    .origin = point + normal * vec3(SURFACE_BIAS),
+                    .direction = sample.direction,
+                },
+                .max_distance = intersection::INF_DISTANCE,
+                .contribution = sample.radiance * vec3(bounce_pdf / sample.pdf * get_mis_weight(sample.pdf, bounce_pdf)),
+            };
+            return true;
+        }
+
+        /// Get sky radiance seen by ray that missed the scene. `bounce_pdf` is solid angle density of diffuse bounce ray
+        /// if environment was sampled at its origin (radiance is MIS-weighted then) and zero otherwise (e.g. for camera rays).
+        vec3 get_sky_radiance(vec3 direction, float bounce_pdf) const {
+            const vec3 radiance = sky.lookup(direction);
+            return bounce_pdf > 0.0f ? radiance * vec3(get_mis_weight(bounce_pdf, sky.pdf(direction))) : radiance;
+        }
+
+        /// Get solid angle density of diffuse bounce ray `r` leaving surface with `normal` (zero if environment is not sampled)
+        static float get_bounce_pdf(bool is_sky_sampled, vec3 normal, const ray &r) {
+            return is_sky_sampled ? std::max(normal.dot(r.direction), 0.0f) * std::numbers::inv_pi_v<float> : 0.0f;
+        }
+
+        /// Generate cosine-distributed diffuse bounce ray
+        static ray get_bounce_ray(vec3 point, vec3 normal, random::xoshiro256pp &random) {
+            const float u0 = random.next_float();
+            const float phi = 2.0f * std::numbers::pi_v<float> * random.next_float();
+            const float radius = std::sqrt(u0);
+
+            vec3 tangent, bitangent;
+            math::make_basis(normal, tangent, bitangent);
+            return ray {
+                .origin = point + normal * vec3(SURFACE_BIAS),
+                .direction = tangent * vec3(radius * std::cos(phi))
+                    + bitangent * vec3(radius * std::sin(phi))
+                    + normal * vec3(std::sqrt(1.0f - u0)),
+            };
+        }
+
+        /// Get surface normal facing against ray direction
+        static vec3 get_facing_normal(vec3 normal, vec3 direction) {
+            return normal.dot(direction) > 0.0f ? vec3(0.0f) - normal : normal;
+        }
+
+        /// Get surface color at hit, `cone_width` is width of ray footprint at hit point (selects texture level)
+        static vec3 get_albedo(const shading_settings &shading, const intersection &intr, float cone_width) {
+            return shading.get_material(*intr.hit_material).get_color(intr.u, intr.v, cone_width * intr.uv_density);
+        }
+
+        /// Get cache entry of camera ray `r` hit (`intr` is not used if ray missed)
+        static first_hit get_first_hit(const ray &r, bool is_hit, const intersection &intr) {
+            if (!is_hit)
+                return first_hit {.direction = r.direction};
+
+            return first_hit {
+                .direction = r.direction,
+                .normal = intr.normal,
+                .distance = intr.distance,
+                .u = intr.u,
+                .v = intr.v,
+                .uv_density = intr.uv_density,
+                .hit_material = intr.hit_material.get(),
+            };
+        }
+
+        /// Restore camera ray direction and its hit from cache entry, returns false if ray missed.
+        /// Restored material pointer doesn't own material, scene of the same geometry keeps it alive.
+        static bool load_first_hit(const first_hit &hit, ray &r, intersection &intr) {
+            r.direction = hit.direction;
+            if (hit.hit_material == nullptr)
+                return false;
+
+            intr.normal = hit.normal;
+            intr.distance = hit.distance;
+            intr.u = hit.u;
+            intr.v = hit.v;
+            intr.uv_density = hit.uv_density;
+            intr.hit_material = std::shared_ptr<material>(std::shared_ptr<material> {}, hit.hit_material);
+            return true;
+        }
+
+        /// Get first-hit AOV of ray hit
+        static aov_sample get_hit_aov(const intersection &intr, vec3 albedo) {
+            return aov_sample {
+                .normal = intr.normal,
+                .albedo = albedo,
+                .depth = intr.distance,
+            };
+        }
+
+        /// Get first-hit AOV of ray that missed the scene
+        static aov_sample get_miss_aov(vec3 direction, vec3 sky_radiance) {
+            return aov_sample {
+                .normal = vec3(0.0f) - direction,
+                .albedo = sky_radiance,
+                .depth = aov_sample::MISS_DEPTH,
+            };
+        }
+
+        /// Trace path of camera ray `r`, writes first-hit AOV to `aov`.
+        /// `spread` is angle between neighbouring camera rays, texture footprint grows with path length by it.
+        /// If `cached_hit` is not null, camera ray hit is taken from it if `is_hit_cached` is set and stored to it otherwise.
+        vec3 trace_path(
+            const shape::scene &object,
+            const shading_settings &shading,
+            std::uint32_t max_bounces,
+            ray r,
+            float spread,
+            random::xoshiro256pp &random,
+            aov_sample &aov,
+            first_hit *cached_hit = nullptr,
+            bool is_hit_cached = false
+        ) const {
+            const bool has_lights = !object.get_light_tree().is_empty();
+            const bool is_sky_sampled = sky.has_distribution();
+            intersection intr;
+            vec3 radiance {0.0f};
+            vec3 throughput {1.0f};
+            float path_length = 0.0f;
+            float bounce_pdf = 0.0f;
+
+            for (std::uint32_t depth = 0;; depth++) {
+                bool is_hit;
+                if (depth == 0 && cached_hit != nullptr && is_hit_cached)
+                    is_hit = load_first_hit(*cached_hit, r, intr);
+                else {
+                    is_hit = object.intersect(r, intr);
+                    if (depth == 0 && cached_hit != nullptr)
+                        *cached_hit = get_first_hit(r, is_hit, intr);
+                }
+
+                if (!is_hit) {
+                    const vec3 sky_radiance = get_sky_radiance(r.direction, bounce_pdf);
+                    if (depth == 0)
+                        aov = get_miss_aov(r.direction, sky_radiance);
+                    return radiance + throughput * sky_radiance;
+                }
+                path_length += intr.distance;
+                const vec3 albedo = get_albedo(shading, intr, path_length * spread);
+                if (depth == 0)
+                    aov = get_hit_aov(intr, albedo);
+
+                const vec3 point = r.at(intr.distance);
+                const vec3 normal = get_facing_normal(intr.normal, r.direction);
+                const vec3 weight = throughput * albedo;
+
+                radiance = radiance + weight * get_local_lighting(shading, has_lights, max_bounces, intr.normal);
+
+                shadow_query query;
+                if (has_lights && sample_light(object, point, normal, random, query) && !object.check_intersection(query.shadow_ray, query.max_distance))
+                    radiance = radiance + weight * query.contribution;
+
+                if (depth == max_bounces)
+                    return radiance;
+
+                // Sky is sampled only at vertices that continue path, its bounce ray hits are MIS-weighted
+                if (is_sky_sampled && sample_environment(point, normal, random, query) && !object.check_intersection(query.shadow_ray, query.max_distance))
+                    radiance = radiance + weight * query.contribution;
+
+                throughput = weight;
+                r = get_bounce_ray(point, normal, random);
+                bounce_pdf = get_bounce_pdf(is_sky_sampled, normal, r);
+            }
+        }
+
+        /// Wavefront path state
+        struct wavefront_path {
+            /// Current path ray
+            ray r;
+
+            /// Path weight
+            vec3 throughput {1.0f};
+
+            /// Collected radiance
+            vec3 radiance {0.0f};
+
+            /// Distance travelled by path
+            float path_length = 0.0f;
+
+            /// Solid angle density of the current ray if it's MIS-weighted diffuse bounce (see `get_sky_radiance`)
+            float bounce_pdf = 0.0f;
+
+            /// Path random stream
+            random::xoshiro256pp random {0};
+
+            /// Last ray hit
+            intersection hit {};
+        };
+
+        /// Shadow test queued by wavefront shading
+        struct wavefront_shadow {
+            /// Index of path shadow test belongs to
+            std::uint32_t path_index;
+
+            /// Shadow test (contribution is already multiplied by path weight)
+            shadow_query query;
+
+            /// True if shadow ray is not occluded
+            bool is_visible = false;
+        };
+
+        /// Per-thread wavefront buffers, reused between rows
+        struct wavefront_buffers {
+            /// Paths (one per row pixel)
+            std::vector<wavefront_path> paths;
+
+            /// First-hit AOVs of paths
+            std::vector<aov_sample> aovs;
+
+            /// Indices of paths that are not terminated
+            std::vector<std::uint32_t> active;
+
+            /// Sort buffer of `(key << 32) | index` entries
+            std::vector<std::uint64_t> order;
+
+            /// Queued shadow tests
+            std::vector<wavefront_shadow> shadows;
+        };
+
+        /// Spread lower 9 bits of value to every third bit
+        static std::uint32_t spread_bits(std::uint32_t value) {
+            value &= 0x1FF;
+            value = (value | value << 16) & 0x030000FF;
+            value = (value | value << 8) & 0x0300F00F;
+            value = (value | value << 4) & 0x030C30C3;
+            value = (value | value << 2) & 0x09249249;
+            return value;
+        }
+
+        /// Fill `order` with indices of `count` rays sorted by direction octant and Morton code of origin cell.
+        /// `get_ray` is called as `const ray &(std::size_t index)`.
+        template <typename ray_getter>
+        static void sort_rays(std::size_t count, ray_getter &&get_ray, std::vector<std::uint64_t> &order) {
+            aabb origin_bounds = aabb::empty();
+            for (std::size_t i = 0; i < count; i++)
+                origin_bounds.extend(get_ray(i).origin);
+            const vec3 cell_scale = vec3(511.0f) / (origin_bounds.max - origin_bounds.min).max(vec3(1e-6f));
+
+            order.clear();
+            for (std::size_t i = 0; i < count; i++) {
+                const ray &r = get_ray(i);
+                const vec3 cell = (r.origin - origin_bounds.min) * cell_scale;
+                const std::uint32_t octant = (r.direction.x < 0.0f) << 2 | (r.direction.y < 0.0f) << 1 | (r.direction.z < 0.0f);
+                const std::uint32_t key = octant << 27
+                    | spread_bits((std::uint32_t)cell.x) << 2
+                    | spread_bits((std::uint32_t)cell.y) << 1
+                    | spread_bits((std::uint32_t)cell.z);
+                order.push_back((std::uint64_t)key << 32 | i);
+            }
+            std::sort(order.begin(), order.end());
+        }
+
+        /// Trace paths of `buffers.paths` bounce by bounce, writing first-hit AOVs to `buffers.aovs`.
+        /// `spread` is as in `trace_path`, `first_hits` (one per path) are used as `cached_hit` of `trace_path`.
+        void trace_wavefront(
+            const shape::scene &object,
+            const shading_settings &shading,
+            std::uint32_t max_bounces,
+            float spread,
+            wavefront_buffers &buffers,
+            first_hit *first_hits = nullptr,
+            bool is_first_hit_cached = false
+        ) const {
+            const bool has_lights = !object.get_light_tree().is_empty();
+            const bool is_sky_sampled = sky.has_distribution();
+            std::vector<wavefront_path> &paths = buffers.paths;
+            std::vector<std::uint32_t> &active = buffers.active;
+            std::vector<std::uint64_t> &order = buffers.order;
+            std::vector<wavefront_shadow> &shadows = buffers.shadows;
+
+            active.resize(paths.size());
+            std::iota(active.begin(), active.end(), 0);
+
+            for (std::uint32_t depth = 0; !active.empty(); depth++) {
+                // Camera rays of row are coherent already, secondary ones are binned
+                if (depth != 0) {
+                    sort_rays(active.size(), [&](std::size_t i) -> const ray & { return paths[active[i]].r; }, order);
+                    for (std::size_t i = 0; i < order.size(); i++)
+                        order[i] = active[(std::uint32_t)order[i]];
+                    std::copy(order.begin(), order.end(), active.begin());
+                }
+
+                // Intersect batch, terminated paths are removed from active ones
+                std::size_t hit_count = 0;
+                for (std::uint32_t index : active) {
+                    wavefront_path &path = paths[index];
+
+                    bool is_hit;
+                    if (depth == 0 && first_hits != nullptr && is_first_hit_cached)
+                        is_hit = load_first_hit(first_hits[index], path.r, path.hit);
+                    else {
+                        is_hit = object.intersect(path.r, path.hit);
+                        if (depth == 0 && first_hits != nullptr)
+                            first_hits[index] = get_first_hit(path.r, is_hit, path.hit);
+                    }
+
+                    if (is_hit) {
+                        path.path_length += path.hit.distance;
+                        if (depth == 0)
+                            buffers.aovs[index] = get_hit_aov(path.hit, get_albedo(shading, path.hit, path.path_length * spread));
+                        active[hit_count++] = index;
+                    } else {
+                        const vec3 sky_radiance = get_sky_radiance(path.r.direction, path.bounce_pdf);
+                        if (depth == 0)
+                            buffers.aovs[index] = get_miss_aov(path.r.direction, sky_radiance);
+                        path.radiance = path.radiance + path.throughput * sky_radiance;
+                    }
+                }
+                active.resize(hit_count);
+
+                // Shade hits grouped by material, shadow tests are queued
+                order.clear();
+                for (std::uint32_t index : active)
+                    order.push_back((std::uint64_t)(std::uint32_t)(reinterpret_cast<std::uintptr_t>(paths[index].hit.hit_material.get()) >> 4) << 32 | index);
+                std::sort(order.begin(), order.end());
+
+                shadows.clear();
+                for (std::uint64_t entry : order) {
+                    const std::uint32_t index = (std::uint32_t)entry;
+                    wavefront_path &path = paths[index];
+
+                    const vec3 point = path.r.at(path.hit.distance);
+                    const vec3 normal = get_facing_normal(path.hit.normal, path.r.direction);
+                    const vec3 weight = path.throughput * get_albedo(shading, path.hit, path.path_length * spread);
+
+                    path.radiance = path.radiance + weight * get_local_lighting(shading, has_lights, max_bounces, path.hit.normal);
+
+                    shadow_query query;
+                    if (has_lights && sample_light(object, point, normal, path.random, query)) {
+                        query.contribution = weight * query.contribution;
+                        shadows.push_back(wavefront_shadow {
+                            .path_index = index,
+                            .query = query,
+                        });
+                    }
+
+                    if (depth < max_bounces) {
+                        if (is_sky_sampled && sample_environment(point, normal, path.random, query)) {
+                            query.contribution = weight * query.contribution;
+                            shadows.push_back(wavefront_shadow {
+                                .path_index = index,
+                                .query = query,
+                            });
+                        }
+
+                        path.throughput = weight;
+                        path.r = get_bounce_ray(point, normal, path.random);
+                        path.bounce_pdf = get_bounce_pdf(is_sky_sampled, normal, path.r);
+                    }
+                }
+
+                // Trace shadow batch, contributions are added in queue order (light before sky, as `trace_path` does)
+                if (!shadows.empty()) {
+                    sort_rays(shadows.size(), [&](std::size_t i) -> const ray & { return shadows[i].query.shadow_ray; }, order);
+                    for (std::uint64_t entry : order) {
+                        wavefront_shadow &shadow = shadows[(std::uint32_t)entry];
+                        shadow.is_visible = !object.check_intersection(shadow.query.shadow_ray, shadow.query.max_distance);
+                    }
+                    for (const wavefront_shadow &shadow : shadows)
+                        if (shadow.is_visible)
+                            paths[shadow.path_index].radiance = paths[shadow.path_index].radiance + shadow.query.contribution;
+                }
+
+                if (depth == max_bounces)
+                    break;
+            }
+        }
+
+        /// Trace sample `sample_index` of every pixel in row `y`, writing `source` plus sample to `destination`.
+        /// First-hit AOVs are accumulated the same way if `aov_destination` is not null.
+        /// If `first_hits` is not null, camera ray hits are read from it if `is_first_hit_cached` is set
+        /// (they must be traced for the same camera and geometry) and written to it otherwise.
+        /// Returns false if some ray needed non-resident geometry, row sample must be dropped then.
+        bool trace_row(
+            const shape::scene &object,
+            const render_settings &settings,
+            const shading_settings &shading,
+            const camera &camera,
+            const frame_projection &projection,
+            std::size_t y,
+            std::uint32_t sample_index,
+            random::xoshiro256pp &random,
+            const vec3 *source,
+            vec3 *destination,
+            const aov_sample *aov_source = nullptr,
+            aov_sample *aov_destination = nullptr,
+            first_hit *first_hits = nullptr,
+            bool is_first_hit_cached = false
+        ) const {
+            RT_PROFILE_ZONE("trace row");
+
+            shape::query_context &context = shape::query_context::get();
+            const std::uint32_t initial_deferred_count = context.deferred_count;
+
+            constexpr double bias_norm = (double)std::numeric_limits<std::uint64_t>::max();
+            const float row_bias_y = (double)random.next() / bias_norm;
+
+            // Deterministic pixel stream covers camera ray jitter too, shared row stream is used otherwise
+            const std::uint64_t row_seed = random::mix_seed(random::mix_seed(settings.seed, y), sample_index);
+            const auto get_pixel_random = [&](std::size_t x) {
+                return random::xoshiro256pp {settings.is_deterministic ? random::mix_seed(row_seed, x) : random.next()};
+            };
+
+            const auto get_camera_ray = [&](std::size_t x, random::xoshiro256pp &ray_random) {
+                const float bias_y = settings.is_deterministic ? (double)ray_random.next() / bias_norm : row_bias_y;
+                const float y_float = projection.y_scale - (bias_y + y) * projection.y_mul;
+                const float x_float = ((double)ray_random.next() / bias_norm + x) * projection.x_mul - projection.x_scale;
+                const vec3 direction = camera.forward + camera.up * vec3(y_float) + camera.right * vec3(x_float);
+                return ray {
+                    .origin = camera.location,
+                    .direction = IS_FAST_MATH ? direction.normalized_fast() : direction.normalized(),
+                };
+            };
+
+            if (settings.mode == render_mode::wavefront) {
+                thread_local wavefront_buffers buffers;
+                buffers.paths.resize(projection.width);
+                buffers.aovs.resize(projection.width);
+
+                // Paths are shaded in material order, so every path has own stream
+                for (std::size_t x = 0; x < projection.width; x++) {
+                    random::xoshiro256pp path_random = get_pixel_random(x);
+                    const ray camera_ray = get_camera_ray(x, path_random);
+                    buffers.paths[x] = wavefront_path {
+                        .r = camera_ray,
+                        .random = path_random,
+                    };
+                }
+
+                trace_wavefront(object, shading, settings.max_bounces, projection.x_mul, buffers, first_hits, is_first_hit_cached);
+
+                for (std::size_t x = 0; x < projection.width; x++) {
+                    *destination++ = *source++ + buffers.paths[x].radiance;
+                    if (aov_destination != nullptr)
+                        *aov_destination++ = *aov_source++ + buffers.aovs[x];
+                }
+            } else {
+                const auto trace_pixel = [&](std::size_t x, random::xoshiro256pp &pixel_random) {
+                    aov_sample aov;
+                    const vec3 color = trace_path(
+                        object,
+                        shading,
+                        settings.max_bounces,
+                        get_camera_ray(x, pixel_random),
+                        projection.x_mul,
+                        pixel_random,
+                        aov,
+                        first_hits != nullptr ? first_hits + x : nullptr,
+                        is_first_hit_cached
+                    );
+
+                    *destination++ = *source++ + color;
+                    if (aov_destination != nullptr)
+                        *aov_destination++ = *aov_source++ + aov;
+                };
+
+                for (std::size_t x = 0; x < projection.width; x++) {
+                    if (settings.is_deterministic) {
+                        random::xoshiro256pp pixel_random = get_pixel_random(x);
+                        trace_pixel(x, pixel_random);
+                    } else
+                        trace_pixel(x, random);
+                }
+            }
+
+            return context.deferred_count == initial_deferred_count;
+        }
+
+        /// Single frame render request, rows are rendered in parallel until every row collects its samples
+        class render_request_job : public executor_job {
+        public:
+
+            /// Construct request job
+            render_request_job(
+                engine &owner,
+                std::shared_ptr<scene_frame_state> frame_scene_state,
+                std::shared_ptr<const shading_settings> frame_shading,
+                camera render_camera,
+                frame_projection projection,
+                std::uint32_t samples,
+                std::optional<denoiser::settings> denoising,
+                std::shared_ptr<render_task_state> state
+            ) :
+                owner(owner),
+                frame_scene_state(std::move(frame_scene_state)),
+                frame_shading(std::move(frame_shading)),
+                render_camera(render_camera),
+                projection(projection),
+                samples(samples),
+                denoising(denoising),
+                state(std::move(state)),
+                request_rows(projection.height),
+                remaining_rows(projection.height)
+            {
+                // AOVs are accumulated only for denoiser
+                for (request_row &row : request_rows) {
+                    row.accumulator = std::make_unique<vec3[]>(projection.width);
+                    if (denoising.has_value())
+                        row.aov_accumulator = std::make_unique<aov_sample[]>(projection.width);
+                }
+            }
+
+            /// Job destructor, request is completed without result if job was dropped unfinished
+            ~render_request_job() {
+                state->complete(std::nullopt);
+            }
+
+            /// Trace single sample of some unfinished row
+            virtual status run_task(std::size_t) override {
+                if (state->get_is_cancelled())
+                    return status::finished;
+
+                for (std::size_t attempt = 0; attempt < request_rows.size(); attempt++) {
+                    const std::size_t y = next_row.fetch_add(1, std::memory_order_relaxed) % request_rows.size();
+                    request_row &row = request_rows[y];
+
+                    if (row.is_done.load(std::memory_order_relaxed) || !row.lock.try_lock())
+                        continue;
+                    std::lock_guard row_guard {row.lock, std::adopt_lock};
+
+                    if (row.collected_count >= samples)
+                        continue;
+
+                    // Random state depends only on row and sample index, so result doesn't depend on scheduling
+                    // (deferred samples are retried with the same state)
+                    random::xoshiro256pp random {(std::uint64_t)y * samples + row.collected_count};
+                    thread_local std::vector<vec3> sample;
+                    thread_local std::vector<aov_sample> aov;
+                    sample.resize(projection.width);
+                    aov.resize(projection.width);
+
+                    shape::query_context::get().is_blocking = row.deferral_count >= MAX_ROW_DEFERRALS;
+                    const bool is_complete = owner.trace_row(
+                        *frame_scene_state->render_scene,
+                        frame_scene_state->settings,
+                        *frame_shading,
+                        render_camera,
+                        projection,
+                        y,
+                        row.collected_count,
+                        random,
+                        row.accumulator.get(),
+                        sample.data(),
+                        row.aov_accumulator.get(),
+                        row.aov_accumulator != nullptr ? aov.data() : nullptr
+                    );
+                    row.deferral_count = is_complete ? 0 : row.deferral_count + 1;
+                    if (!is_complete)
+                        return status::done;
+                    std::copy_n(sample.data(), projection.width, row.accumulator.get());
+                    if (row.aov_accumulator != nullptr)
+                        std::copy_n(aov.data(), projection.width, row.aov_accumulator.get());
+
+                    if (++row.collected_count < samples)
+                        return status::done;
+
+                    row.is_done.store(true, std::memory_order_relaxed);
+                    if (remaining_rows.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                        resolve();
+                    return status::done;
+                }
+
+                return remaining_rows.load(std::memory_order_acquire) == 0 ? status::finished : status::idle;
+            }
+
+        private:
+
+            /// Request row accumulation state
+            struct request_row {
+                /// Row access lock (busy rows are skipped, not waited for)
+                spinlock lock;
+
+                /// True if row collected all samples
+                std::atomic_bool is_done = false;
+
+                /// Count of collected samples
+                std::uint32_t collected_count = 0;
+
+                /// Count of successive samples deferred because of non-resident geometry
+                std::uint32_t deferral_count = 0;
+
+                /// Accumulated samples
+                std::unique_ptr<vec3[]> accumulator;
+
+                /// Accumulated first-hit AOVs (null if request isn't denoised)
+                std::unique_ptr<aov_sample[]> aov_accumulator;
+            };
+
+            /// Build result image and complete request (called by the thread that finished the last row)
+            void resolve() {
+                RT_PROFILE_ZONE("resolve request");
+
+                image frame {projection.width, projection.height};
+                const vec3 scale {1.0f / samples};
+
+                // Resolving thread filters rows together with free executor threads
+                if (denoising.has_value()) {
+                    denoiser filter {&owner.render_executor};
+                    filter.set_settings(*denoising);
+                    filter.resize(projection.width, projection.height);
+                    for (std::size_t y = 0; y < projection.height; y++)
+                        filter.load_row(y, request_rows[y].accumulator.get(), request_rows[y].aov_accumulator.get(), 1.0f / samples);
+                    filter.run();
+
+                    for (std::size_t y = 0; y < projection.height; y++)
+                        for (std::size_t x = 0; x < projection.width; x++)
+                            frame.set(x, y, filter.get(x, y));
+                    state->complete(std::move(frame));
+                    return;
+                }
+
+                for (std::size_t y = 0; y < projection.height; y++) {
+                    std::span<vec3> output = frame.get_row(y);
+                    const vec3 *accumulator = request_rows[y].accumulator.get();
+                    for (std::size_t x = 0; x < projection.width; x++)
+                        output[x] = accumulator[x] * scale;
+                }
+
+                state->complete(std::move(frame));
+            }
+
+            /// Engine (used for tracing and denoising)
+            engine &owner;
+
+            /// Rendered scene
+            std::shared_ptr<scene_frame_state> frame_scene_state;
+
+            /// Shading parameters
+            std::shared_ptr<const shading_settings> frame_shading;
+
+            /// Rendered camera
+            camera render_camera;
+
+            /// Frame projection
+            frame_projection projection;
+
+            /// Per-pixel sample budget
+            std::uint32_t samples;
+
+            /// Denoiser settings (result isn't denoised if they are absent)
+            std::optional<denoiser::settings> denoising;
+
+            /// Request state
+            std::shared_ptr<render_task_state> state;
+
+            /// Rows
+            std::vector<request_row> request_rows;
+
+            /// Row scan cursor
+            std::atomic_size_t next_row = 0;
+
+            /// Count of rows that didn't collect all samples yet
+            std::atomic_size_t remaining_rows;
+        };
+
+        /// Commit scene acceleration structure and publish it (must be called under `scene_update_lock`)
+        std::uint32_t publish_scene(shape::scene new_scene, bool is_geometry_kept) {
+            new_scene.commit();
+
+            const std::shared_ptr current_state = scene_state.load();
+            return publish_state(
+                std::make_shared<const shape::scene>(std::move(new_scene)),
+                current_state != nullptr ? current_state->settings : render_settings {},
+                is_geometry_kept
+            );
+        }
+
+        /// Publish new scene state with new revision (must be called under `scene_update_lock`).
+        /// Geometry revision is kept if `is_geometry_kept` is set, so rays hit the same as in the current state.
+        std::uint32_t publish_state(std::shared_ptr<const shape::scene> render_scene, render_settings settings, bool is_geometry_kept) {
+            const std::shared_ptr current_state = scene_state.load();
+            const std::uint32_t revision = get_dynamic_state_revision();
+            scene_state.store(std::make_shared<scene_frame_state>(scene_frame_state {
+                .render_scene = std::move(render_scene),
+                .settings = settings,
+                .revision = revision,
+                .geometry_revision = is_geometry_kept && current_state != nullptr ? current_state->geometry_revision : revision,
+            }));
+            return revision;
+        }
+
+        /// Current scene state
+        std::atomic<std::shared_ptr<scene_frame_state>> scene_state = nullptr;
+
+        /// Shading of new viewports and renders (guarded by `scene_update_lock`)
+        std::shared_ptr<const shading_settings> shading = std::make_shared<const shading_settings>();
+
+        /// Scene modification lock (serializes concurrent scene updates)
+        std::mutex scene_update_lock;
+
+        /// Last revision of the dynamic state
+        std::atomic_uint32_t last_dynamic_state_revision = 1;
+
+        /// Generate new unique dynamic state revision
+        std::uint32_t get_dynamic_state_revision() noexcept {
+            return last_dynamic_state_revision.fetch_add(1, std::memory_order::relaxed);
+        }
 
-        /// Sky tracing function
-        std::function<vec3(vec3)> sky_trace_function;
+        /// Sky radiance map
+        environment_map sky;
 
-        /// Rendered 'lines'
-        std::vector<render_row> rows;
+        /// Rendering thread pool, shared by viewports, sequences and render requests
+        executor render_executor;
 
-        /// Rendering task executor
-        std::optional<executor> render_executor = std::nullopt;
+        /// Viewports (null for removed ones), destroyed before executor
+        std::vector<std::unique_ptr<viewport>> viewports {};
     };
 }
 
@@ -0,0 +1,309 @@
+//! Environment (sky) map implementation file
+
+#ifndef RT_ENVIRONMENT_HPP_
+#define RT_ENVIRONMENT_HPP_
+
+#include <numbers>
+
+#include "rt_image.hpp"
+
+namespace rt {
+    /// Environment map importance sample
+    struct environment_sample {
+        /// Sampled direction (unit)
+        vec3 direction;
+
+        /// Radiance coming from the direction
+        vec3 radiance;
+
+        /// Solid angle probability density of the direction
+        float pdf;
+    };
+
+    /// Environment radiance stored in octahedral map with prebuilt importance sampling tables.
+    /// Sampling distribution is MIS-compensated: it covers only radiance above the map average, the rest
+    /// is left to cosine-distributed bounce rays (so constant maps aren't sampled at all).
+    class environment_map {
+    public:
+
+        /// Default map resolution
+        constexpr static std::size_t DEFAULT_RESOLUTION = 128;
+
+        /// Distributions holding less than this share of map power are dropped
+        constexpr static float MIN_DISTRIBUTION_WEIGHT = 1.0e-3f;
+
+        /// Bake radiance function into map (function is called once per texel)
+        static environment_map bake(const std::function<vec3(vec3)> &radiance, std::size_t resolution = DEFAULT_RESOLUTION) {
+            environment_map map {resolution};
+
+            for (std::size_t y = 0; y < resolution; y++)
+                for (std::size_t x = 0; x < resolution; x++)
+                    map.texels[y * resolution + x] = radiance(map.texel_direction(x + 0.5f, y + 0.5f));
+
+            map.build_distribution();
+            return map;
+        }
+
+        /// Resample equirectangular (latitude-longitude) image into map
+        static environment_map from_equirectangular(const image &source, std::size_t resolution = DEFAULT_RESOLUTION) {
+            if (source.is_empty())
+                return bake([](vec3) { return vec3(0.0f); }, 1);
+
+            const float width = source.get_width();
+            const float height = source.get_height();
+
+            return bake([&](vec3 direction) {
+                float u = (std::atan2(direction.z, direction.x) * std::numbers::inv_pi_v<float> * 0.5f + 0.5f) * width - 0.5f;
+                float v = std::acos(std::clamp(direction.y, -1.0f, 1.0f)) * std::numbers::inv_pi_v<float> * height - 0.5f;
+
+                float x0 = std::floor(u), y0 = std::floor(v);
+                float tx = u - x0, ty = v - y0;
+
+                // Longitude wraps around, latitude is clamped
+                auto texel = [&](float x, float y) {
+                    std::size_t ix = (std::size_t)(std::fmod(x + width, width));
+                    std::size_t iy = (std::size_t)std::clamp(y, 0.0f, height - 1.0f);
+                    return source.get(std::min<std::size_t>(ix, source.get_width() - 1), iy);
+                };
+
+                return (texel(x0, y0) * vec3(1.0f - tx) + texel(x0 + 1, y0) * vec3(tx)) * vec3(1.0f - ty)
+                    + (texel(x0, y0 + 1) * vec3(1.0f - tx) + texel(x0 + 1, y0 + 1) * vec3(tx)) * vec3(ty);
+            }, resolution);
+        }
+
+        /// Load equirectangular Radiance HDR image into map
+        static std::optional<environment_map> load_hdr(const std::string &path, std::size_t resolution = DEFAULT_RESOLUTION) {
+            std::optional<image> source = image::load_hdr(path);
+            if (!source.has_value())
+                return std::nullopt;
+            return from_equirectangular(*source, resolution);
+        }
+
+        /// Get radiance coming from the direction (bilinearly filtered, filter footprint wraps across octahedral folds)
+        vec3 lookup(vec3 direction) const {
+            float u, v;
+            direction_texel(direction, u, v);
+
+            u = std::clamp(u - 0.5f, -0.5f, max_coordinate + 0.5f);
+            v = std::clamp(v - 0.5f, -0.5f, max_coordinate + 0.5f);
+
+            const float fx = std::floor(u), fy = std::floor(v);
+            const std::ptrdiff_t x0 = (std::ptrdiff_t)fx, y0 = (std::ptrdiff_t)fy;
+            const float tx = u - fx, ty = v - fy;
+
+            return (texel(x0, y0) * vec3(1.0f - tx) + texel(x0 + 1, y0) * vec3(tx)) * vec3(1.0f - ty)
+                + (texel(x0, y0 + 1) * vec3(1.0f - tx) + texel(x0 + 1, y0 + 1) * vec3(tx)) * vec3(ty);
+        }
+
+        /// Sample direction proportionally to incoming radiance above the average (`u0`, `u1` are uniform in [0, 1)).
+        /// Map must have sampling distribution.
+        environment_sample sample(float u0, float u1) const {
+            // Select row by marginal distribution, then texel in it
+            std::size_t y = sample_cdf(std::span<const float>(marginal_cdf), u0);
+            float row_begin = marginal_cdf[y];
+            float row_width = marginal_cdf[y + 1] - row_begin;
+            float v_offset = row_width > 0.0f ? (u0 - row_begin) / row_width : 0.5f;
+
+            std::span<const float> row_cdf = std::span<const float>(conditional_cdf).subspan(y * (resolution + 1), resolution + 1);
+            std::size_t x = sample_cdf(row_cdf, u1);
+            float texel_begin = row_cdf[x];
+            float texel_width = row_cdf[x + 1] - texel_begin;
+            float u_offset = texel_width > 0.0f ? (u1 - texel_begin) / texel_width : 0.5f;
+
+            vec3 direction = texel_direction(x + std::clamp(u_offset, 0.0f, 1.0f), y + std::clamp(v_offset, 0.0f, 1.0f));
+
+            return environment_sample {
+                .direction = direction,
+                .radiance = lookup(direction),
+                .pdf = texel_pdf(x, y),
+            };
+        }
+
+        /// Get solid angle probability density of sampling the direction with `sample` (zero if map has no distribution)
+        float pdf(vec3 direction) const {
+            float u, v;
+            direction_texel(direction, u, v);
+            return texel_pdf(
+                std::min((std::size_t)u, resolution - 1),
+                std::min((std::size_t)v, resolution - 1)
+            );
+        }
+
+        /// Get total radiant power of the map (radiance luminance integrated over the sphere)
+        float get_power() const noexcept {
+            return power;
+        }
+
+        /// Check if map has sampling distribution (nearly constant maps don't have it)
+        bool has_distribution() const noexcept {
+            return total_weight > 0.0f;
+        }
+
+        /// Get map resolution
+        std::size_t get_resolution() const noexcept {
+            return resolution;
+        }
+
+    private:
+
+        /// Construct map of specified resolution
+        environment_map(std::size_t resolution):
+            resolution(std::max<std::size_t>(resolution, 1)),
+            max_coordinate((float)(this->resolution - 1)),
+            texels(this->resolution * this->resolution)
+        {
+        }
+
+        /// Radiance luminance
+        static float luminance(vec3 color) {
+            return color.dot(vec3(0.2126f, 0.7152f, 0.0722f));
+        }
+
+        /// Get texel, coordinates may be one texel outside of the map. Map border is a fold of the octahedron,
+        /// so texel across the edge is the one mirrored along it (corners meet at the opposite corner).
+        vec3 texel(std::ptrdiff_t x, std::ptrdiff_t y) const {
+            const std::ptrdiff_t last = (std::ptrdiff_t)resolution - 1;
+
+            if (y < 0 || y > last) {
+                y = std::clamp<std::ptrdiff_t>(y, 0, last);
+                x = last - x;
+            }
+            if (x < 0 || x > last) {
+                x = std::clamp<std::ptrdiff_t>(x, 0, last);
+                y = last - y;
+            }
+
+            return texels[y * resolution + x];
+        }
+
+        /// Find CDF interval that contains `u`
+        static std::size_t sample_cdf(std::span<const float> cdf, float u) {
+            auto upper = std::upper_bound(cdf.begin() + 1, cdf.end(), u);
+            return std::min<std::size_t>(upper - cdf.begin() - 1, cdf.size() - 2);
+        }
+
+        /// Convert continuous texel coordinates to direction (octahedral mapping, Y axis is up)
+        vec3 texel_direction(float x, float y) const {
+            float u = x / resolution * 2.0f - 1.0f;
+            float v = y / resolution * 2.0f - 1.0f;
+            float up = 1.0f - std::abs(u) - std::abs(v);
+
+            if (up < 0.0f) {
+                float fu = (1.0f - std::abs(v)) * std::copysign(1.0f, u);
+                float fv = (1.0f - std::abs(u)) * std::copysign(1.0f, v);
+                u = fu;
+                v = fv;
+            }
+
+            return vec3(u, up, v).normalized();
+        }
+
+        /// Convert direction to continuous texel coordinates
+        void direction_texel(vec3 direction, float &x, float &y) const {
+            float inv_norm = 1.0f / (std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z));
+            float u = direction.x * inv_norm;
+            float v = direction.z * inv_norm;
+
+            if (direction.y < 0.0f) {
+                float fu = (1.0f - std::abs(v)) * std::copysign(1.0f, u);
+                float fv = (1.0f - std::abs(u)) * std::copysign(1.0f, v);
+                u = fu;
+                v = fv;
+            }
+
+            x = (u * 0.5f + 0.5f) * resolution;
+            y = (v * 0.5f + 0.5f) * resolution;
+        }
+
+        /// Approximate solid angle covered by texel
+        float texel_solid_angle(std::size_t x, std::size_t y) const {
+            vec3 d00 = texel_direction(x, y);
+            vec3 d10 = texel_direction(x + 1.0f, y);
+            vec3 d01 = texel_direction(x, y + 1.0f);
+            vec3 d11 = texel_direction(x + 1.0f, y + 1.0f);
+
+            // Texel is approximated by two triangles
+            return 0.5f * ((d10 - d00).cross(d01 - d00).length() + (d10 - d11).cross(d01 - d11).length());
+        }
+
+        /// Texel sampling density, luminance excess over the map average
+        float texel_density(std::size_t x, std::size_t y) const {
+            return std::max(luminance(texels[y * resolution + x]) - average_luminance, 0.0f);
+        }
+
+        /// Solid angle probability density of texel
+        float texel_pdf(std::size_t x, std::size_t y) const {
+            if (total_weight <= 0.0f)
+                return 0.0f;
+            return texel_density(x, y) / total_weight;
+        }
+
+        /// Build importance sampling tables (texel weight is its density times solid angle)
+        void build_distribution() {
+            conditional_cdf.assign(resolution * (resolution + 1), 0.0f);
+            marginal_cdf.assign(resolution + 1, 0.0f);
+
+            // Flat texel approximation underestimates solid angles, so they're normalized to the full sphere
+            std::vector<float> solid_angles(texels.size());
+            float solid_angle_sum = 0.0f;
+            for (std::size_t y = 0; y < resolution; y++)
+                for (std::size_t x = 0; x < resolution; x++)
+                    solid_angle_sum += solid_angles[y * resolution + x] = texel_solid_angle(x, y);
+            const float solid_angle_scale = 4.0f * std::numbers::pi_v<float> / solid_angle_sum;
+
+            power = 0.0f;
+            for (std::size_t index = 0; index < texels.size(); index++)
+                power += std::max(luminance(texels[index]), 0.0f) * solid_angles[index] * solid_angle_scale;
+            average_luminance = power * 0.25f * std::numbers::inv_pi_v<float>;
+
+            for (std::size_t y = 0; y < resolution; y++) {
+                float *cdf = &conditional_cdf[y * (resolution + 1)];
+                for (std::size_t x = 0; x < resolution; x++)
+                    cdf[x + 1] = cdf[x] + texel_density(x, y) * solid_angles[y * resolution + x] * solid_angle_scale;
+                marginal_cdf[y + 1] = marginal_cdf[y] + cdf[resolution];
+            }
+
+            // Excess that is rounding error of the average is dropped
+            total_weight = marginal_cdf[resolution] > power * MIN_DISTRIBUTION_WEIGHT ? marginal_cdf[resolution] : 0.0f;
+
+            // Maps without distribution get uniform tables (they're not sampled anyway)
+            auto normalize = [](float *cdf, std::size_t count) {
+                float total = cdf[count];
+                for (std::size_t i = 1; i <= count; i++)
+                    cdf[i] = total > 0.0f ? cdf[i] / total : (float)i / count;
+            };
+
+            for (std::size_t y = 0; y < resolution; y++)
+                normalize(&conditional_cdf[y * (resolution + 1)], resolution);
+            normalize(marginal_cdf.data(), resolution);
+        }
+
+        /// Map side size (in texels)
+        std::size_t resolution;
+
+        /// Maximal texel coordinate
+        float max_coordinate;
+
+        /// Map radiance values (row-major)
+        std::vector<vec3> texels;
+
+        /// Per-row texel CDFs (`resolution + 1` values per row)
+        std::vector<float> conditional_cdf {};
+
+        /// Row CDF
+        std::vector<float> marginal_cdf {};
+
+        /// Sum of texel weights (zero if map has no distribution)
+        float total_weight = 0.0f;
+
+        /// Radiance luminance integrated over the sphere
+        float power = 0.0f;
+
+        /// Average radiance luminance (subtracted from texel densities)
+        float average_luminance = 0.0f;
+    };
+}
+
+#endif // !defined(RT_ENVIRONMENT_HPP_)
+
+// rt_environment.hpp
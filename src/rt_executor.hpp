@@ -0,0 +1,393 @@
+//! Parallel execution primitives
+
+#ifndef RT_EXECUTOR_HPP_
+#define RT_EXECUTOR_HPP_
+
+#include "rt_common.hpp"
+#include "rt_random.hpp"
+#include "rt_profiler.hpp"
+
+namespace rt {
+
+    /// 'Mutex' synchronization primitive
+    class spinlock {
+    public:
+
+        /// Lock
+        void lock() {
+            if (try_lock())
+                return;
+
+            RT_PROFILE_ZONE("spinlock wait");
+            for (;;) {
+                if (!lock_.exchange(true, std::memory_order_acquire))
+                    break;
+
+                while (lock_.load(std::memory_order_relaxed))
+                    pause(); // something like _mm_pause
+            }
+        }
+
+        /// Try to lock without waiting, returns true if locked
+        bool try_lock() {
+            return !lock_.load(std::memory_order_relaxed) && !lock_.exchange(true, std::memory_order_acquire);
+        }
+
+        /// Unlock
+        void unlock() {
+            lock_.store(false, std::memory_order_release);
+        }
+
+    private:
+
+        /// Function that does nothing
+        static void pause() {
+            static volatile unsigned int counter = 0;
+            counter += 4;
+            counter += 4;
+            counter += 4;
+            counter += 4;
+        }
+
+        /// Spinlock state
+        std::atomic_bool lock_ = false;
+    };
+
+    /// Set of tasks executed by executor threads
+    class executor_job {
+    public:
+
+        /// Task execution status
+        enum class status {
+            /// Task was executed
+            done,
+
+            /// Job has no task to run now (other jobs are tried)
+            idle,
+
+            /// Job is finished and may be removed from executor
+            finished,
+        };
+
+        /// Run single task on executor thread `thread_index`
+        virtual status run_task(std::size_t thread_index) = 0;
+
+        /// Job destructor
+        virtual ~executor_job() = default;
+    };
+
+    /// Job that cycles over fixed set of tasks in randomized order forever
+    class task_cycle_job : public executor_job {
+    public:
+
+        /// Maximal ratio of the largest task weight to the smallest one
+        constexpr static float MAX_WEIGHT_RATIO = 64.0f;
+
+        /// Construct job (`thread_functions` are indexed by executor thread index)
+        task_cycle_job(
+            std::size_t task_count,
+            std::vector<std::function<void(std::size_t)>> thread_functions,
+            std::uint64_t task_random_seed = 47
+        ) :
+            thread_functions(std::move(thread_functions))
+        {
+            // Construct task vector
+            tasks.reserve(task_count);
+            for (std::size_t i = 0; i < task_count; i++)
+                tasks.push_back(i);
+
+            /// Randomize rendering order
+            random::xoshiro256pp random {task_random_seed};
+            for (std::size_t i = 0; i < tasks.size(); i++)
+                std::swap(
+                    tasks[random.next() % tasks.size()],
+                    tasks[random.next() % tasks.size()]
+                );
+
+            schedule = std::make_shared<const std::vector<std::uint32_t>>(tasks);
+        }
+
+        /// Set relative task weights (empty span makes them equal), tasks are visited proportionally to their weights.
+        /// May be called while job runs, new visit order is used starting with the next task.
+        void set_task_weights(std::span<const float> weights) {
+            schedule.store(std::make_shared<const std::vector<std::uint32_t>>(build_schedule(weights)), std::memory_order_release);
+        }
+
+        /// Run next task
+        virtual status run_task(std::size_t thread_index) override {
+            const std::shared_ptr<const std::vector<std::uint32_t>> current = schedule.load(std::memory_order_acquire);
+            if (current->empty())
+                return status::finished;
+
+            thread_functions[thread_index]((*current)[task_index.fetch_add(1, std::memory_order_relaxed) % current->size()]);
+            return status::done;
+        }
+
+    private:
+
+        /// Build visit order: every task is repeated proportionally to its weight,
+        /// repeats are spread evenly (stride scheduling) so the same task rarely runs on two threads at once
+        std::vector<std::uint32_t> build_schedule(std::span<const float> weights) const {
+            float min_weight = std::numeric_limits<float>::infinity();
+            for (float weight : weights)
+                if (weight > 0.0f)
+                    min_weight = std::min(min_weight, weight);
+
+            // Task at shuffled position `p` with `c` repeats is visited at times (k + (p + 0.5) / n) / c
+            std::vector<std::pair<float, std::uint32_t>> visits;
+            visits.reserve(tasks.size());
+            for (std::size_t position = 0; position < tasks.size(); position++) {
+                const std::uint32_t task = tasks[position];
+                const float weight = task < weights.size() ? weights[task] : min_weight;
+                const std::uint32_t repeat_count = weight > min_weight
+                    ? (std::uint32_t)std::min(std::round(weight / min_weight), MAX_WEIGHT_RATIO)
+                    : 1;
+
+                const float phase = (position + 0.5f) / tasks.size();
+                for (std::uint32_t k = 0; k < repeat_count; k++)
+                    visits.push_back({(k + phase) / repeat_count, task});
+            }
+            std::sort(visits.begin(), visits.end());
+
+            std::vector<std::uint32_t> order;
+            order.reserve(visits.size());
+            for (const auto &[time, task] : visits)
+                order.push_back(task);
+            return order;
+        }
+
+        /// Current task index
+        std::atomic_uint32_t task_index = 0;
+
+        /// Tasks in shuffled order
+        std::vector<std::uint32_t> tasks = {};
+
+        /// Current visit order (tasks repeated according to their weights)
+        std::atomic<std::shared_ptr<const std::vector<std::uint32_t>>> schedule;
+
+        /// Per-thread task functions
+        std::vector<std::function<void(std::size_t)>> thread_functions;
+    };
+
+    /// Parallel execution handler, shares fixed set of threads between jobs.
+    /// Jobs are scheduled by stride scheduling: every job gets share of tasks proportional to its weight.
+    class executor {
+    public:
+
+        /// Construct executor with specified count of threads
+        executor(std::size_t thread_count) {
+            threads.reserve(thread_count);
+            for (std::size_t thread_index = 0; thread_index < thread_count; thread_index++)
+                threads.push_back(std::thread([this, thread_index]() { run_worker(thread_index); }));
+        }
+
+        /// Executor destructor
+        ~executor() {
+            {
+                std::lock_guard guard {lock};
+                do_continue = false;
+            }
+            jobs_changed.notify_all();
+
+            /// Join all threads
+            for (auto &thr : threads)
+                thr.join();
+        }
+
+        /// Get count of executor threads
+        std::size_t get_thread_count() const noexcept {
+            return threads.size();
+        }
+
+        /// Add job, `weight` is relative share of executor time the job gets
+        void add_job(std::shared_ptr<executor_job> job, float weight = 1.0f) {
+            {
+                std::lock_guard guard {lock};
+
+                // New job starts from the current virtual time, so it doesn't monopolize threads
+                double pass = 0.0;
+                if (!entries.empty())
+                    pass = std::min_element(entries.begin(), entries.end(), [](const entry &l, const entry &r) {
+                        return l.pass < r.pass;
+                    })->pass;
+
+                entries.push_back(entry {
+                    .job = std::move(job),
+                    .stride = 1.0 / std::max(weight, MIN_WEIGHT),
+                    .pass = pass,
+                });
+                wake_generation++;
+            }
+            jobs_changed.notify_all();
+        }
+
+        /// Change job weight
+        void set_job_weight(const executor_job *job, float weight) {
+            std::lock_guard guard {lock};
+            for (entry &e : entries)
+                if (e.job.get() == job)
+                    e.stride = 1.0 / std::max(weight, MIN_WEIGHT);
+        }
+
+        /// Remove job, waits until none of threads runs its tasks
+        void remove_job(const executor_job *job) {
+            std::unique_lock guard {lock};
+
+            auto found = std::find_if(entries.begin(), entries.end(), [&](const entry &e) { return e.job.get() == job; });
+            if (found == entries.end())
+                return;
+            found->is_removed = true;
+
+            RT_PROFILE_ZONE("executor job removal wait");
+            jobs_changed.wait(guard, [&]() {
+                auto current = std::find_if(entries.begin(), entries.end(), [&](const entry &e) { return e.job.get() == job; });
+                return current == entries.end() || current->active_count == 0;
+            });
+
+            std::erase_if(entries, [&](const entry &e) { return e.job.get() == job; });
+        }
+
+        /// Wake up idle threads (e.g. when some idle job got new tasks)
+        void notify() {
+            {
+                std::lock_guard guard {lock};
+                wake_generation++;
+            }
+            jobs_changed.notify_all();
+        }
+
+    private:
+
+        /// Minimal job weight
+        constexpr static float MIN_WEIGHT = 1.0e-3f;
+
+        /// Executor job entry
+        struct entry {
+            /// Job
+            std::shared_ptr<executor_job> job;
+
+            /// Virtual time increment per task
+            double stride = 1.0;
+
+            /// Job virtual time
+            double pass = 0.0;
+
+            /// Count of threads running job tasks
+            std::size_t active_count = 0;
+
+            /// True if job must not be scheduled anymore
+            bool is_removed = false;
+
+            /// True if job reported it's finished (entry is dropped once no thread runs it)
+            bool is_finished = false;
+        };
+
+        /// Worker thread function
+        void run_worker(std::size_t thread_index) {
+            std::unique_lock guard {lock};
+
+            // Jobs that were idle for this thread since the last wake up
+            std::vector<const executor_job *> idle_jobs;
+            std::uint64_t seen_generation = wake_generation;
+
+            while (do_continue) {
+                if (seen_generation != wake_generation) {
+                    seen_generation = wake_generation;
+                    idle_jobs.clear();
+                }
+
+                // Job with minimal virtual time runs next
+                entry *selected = nullptr;
+                for (entry &e : entries)
+                    if (!e.is_removed && std::find(idle_jobs.begin(), idle_jobs.end(), e.job.get()) == idle_jobs.end())
+                        if (selected == nullptr || e.pass < selected->pass)
+                            selected = &e;
+
+                // Sleep until job table changes or some job makes progress (idle jobs may have got new tasks)
+                if (selected == nullptr) {
+                    RT_PROFILE_ZONE("executor idle");
+                    idle_waiter_count += !idle_jobs.empty();
+                    jobs_changed.wait(guard, [&]() { return !do_continue || seen_generation != wake_generation; });
+                    idle_waiter_count -= !idle_jobs.empty();
+                    continue;
+                }
+
+                std::shared_ptr<executor_job> job = selected->job;
+                selected->active_count++;
+
+                guard.unlock();
+                executor_job::status result;
+                {
+                    RT_PROFILE_ZONE("executor task");
+                    result = job->run_task(thread_index);
+                }
+                guard.lock();
+
+                // Entries may be reallocated while the lock is released
+                auto current = std::find_if(entries.begin(), entries.end(), [&](const entry &e) { return e.job == job; });
+                current->active_count--;
+
+                switch (result) {
+                case executor_job::status::done:
+                    current->pass += current->stride;
+                    idle_jobs.clear();
+                    if (idle_waiter_count != 0) {
+                        wake_generation++;
+                        jobs_changed.notify_all();
+                    }
+                    break;
+
+                case executor_job::status::idle:
+                    idle_jobs.push_back(job.get());
+                    break;
+
+                case executor_job::status::finished:
+                    current->is_removed = true;
+                    current->is_finished = true;
+                    break;
+                }
+
+                // Finished jobs are dropped by the last thread leaving them, removers are notified
+                if (current->is_removed && current->active_count == 0) {
+                    const bool is_erased = current->is_finished;
+                    if (is_erased)
+                        entries.erase(current);
+                    jobs_changed.notify_all();
+
+                    // Last job reference is dropped without lock: job destructor may complete requests,
+                    // and their continuations may add jobs
+                    if (is_erased) {
+                        guard.unlock();
+                        job.reset();
+                        guard.lock();
+                    }
+                }
+            }
+        }
+
+        /// Job table lock
+        std::mutex lock;
+
+        /// Job table change notification
+        std::condition_variable jobs_changed;
+
+        /// Executor jobs
+        std::vector<entry> entries {};
+
+        /// Incremented to make threads retry idle jobs (and on every job table change)
+        std::uint64_t wake_generation = 0;
+
+        /// Count of sleeping threads that have idle jobs
+        std::size_t idle_waiter_count = 0;
+
+        /// Continue if true (used to stop worker thread execution on destruction)
+        bool do_continue = true;
+
+        /// Array of threads
+        std::vector<std::thread> threads = {};
+    };
+}
+
+#endif // !defined(RT_EXECUTOR_HPP_)
+
+// rt_executor.hpp
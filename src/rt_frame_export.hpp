@@ -0,0 +1,286 @@
+//! Shared memory frame export implementation file
+
+#ifndef RT_FRAME_EXPORT_HPP_
+#define RT_FRAME_EXPORT_HPP_
+
+#include "rt_mapped_file.hpp"
+
+namespace rt {
+    /// Ring of BGRX frames in POSIX shared memory, written by single producer and read by any count of consumer processes.
+    /// Consumers read frames in place. Every slot is guarded by sequence number (seqlock), so consumer that was
+    /// overtaken by producer detects it by validating frame after reading instead of blocking the producer.
+    class frame_export {
+    public:
+
+        /// Size of pixel (BGRX, 8 bits per channel)
+        constexpr static std::size_t BYTES_PER_PIXEL = 4;
+
+        /// Default count of slots
+        constexpr static std::uint32_t DEFAULT_SLOT_COUNT = 3;
+
+        /// Frame published by producer (points into shared memory)
+        struct frame {
+            /// Frame sequence number (the first published frame has 1)
+            std::uint64_t sequence = 0;
+
+            /// Pixel rows (`pitch` bytes apart)
+            const std::byte *data = nullptr;
+
+            /// Width in pixels
+            std::size_t width = 0;
+
+            /// Height in pixels
+            std::size_t height = 0;
+
+            /// Distance between rows (in bytes)
+            std::size_t pitch = 0;
+
+            /// Minimal count of samples per pixel
+            std::uint32_t sample_count = 0;
+
+            /// Publication time (steady clock is system-wide, so it's comparable between processes)
+            std::chrono::steady_clock::time_point publish_time {};
+        };
+
+        /// Create ring `name` (e.g. "/name") for frames up to `max_width` x `max_height`, null on failure.
+        /// Ring name is removed when producer is destroyed, consumers that opened it keep their mapping.
+        static std::unique_ptr<frame_export> create(const std::string &name, std::size_t max_width, std::size_t max_height, std::uint32_t slot_count = DEFAULT_SLOT_COUNT) {
+            if (max_width == 0 || max_height == 0 || slot_count < 2)
+                return nullptr;
+
+            const std::size_t slot_size = get_slot_size(max_width, max_height);
+            std::unique_ptr<mapped_file> file = mapped_file::open_shared(name, SLOT_OFFSET + slot_count * slot_size);
+            if (file == nullptr)
+                return nullptr;
+
+            // Object may be left by previous producer, so everything except pixels is reset
+            std::memset(file->get_data(), 0, SLOT_OFFSET);
+            ring_header &header = *new (file->get_data()) ring_header {};
+            header.slot_count = slot_count;
+            header.max_width = max_width;
+            header.max_height = max_height;
+            header.slot_size = slot_size;
+            for (std::uint32_t slot = 0; slot < slot_count; slot++)
+                new (file->get_data() + SLOT_OFFSET + slot * slot_size) slot_header {};
+
+            std::atomic_thread_fence(std::memory_order_release);
+            std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+            return std::unique_ptr<frame_export>(new frame_export(std::move(file), name, true));
+        }
+
+        /// Open existing ring for reading, null if it is missing or invalid
+        static std::unique_ptr<frame_export> open(const std::string &name) {
+            std::unique_ptr<mapped_file> file = mapped_file::open_shared(name);
+            if (file == nullptr || file->get_size() < SLOT_OFFSET)
+                return nullptr;
+
+            const ring_header &header = *reinterpret_cast<const ring_header *>(file->get_data());
+            // Ring needs at least two slots, and slot index is taken modulo slot count
+            if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+                || header.slot_count < 2
+                || header.max_width == 0 || header.max_height == 0
+                || header.max_width > file->get_size() / BYTES_PER_PIXEL / header.max_height
+                || header.slot_size != get_slot_size(header.max_width, header.max_height)
+                || header.slot_size > (file->get_size() - SLOT_OFFSET) / header.slot_count
+                || file->get_size() != SLOT_OFFSET + header.slot_count * header.slot_size)
+                return nullptr;
+
+            return std::unique_ptr<frame_export>(new frame_export(std::move(file), name, false));
+        }
+
+        /// Ring is not copyable
+        frame_export(const frame_export &) = delete;
+        frame_export & operator=(const frame_export &) = delete;
+
+        /// Destroy ring, producer removes its name
+        ~frame_export() {
+            if (is_producer)
+                mapped_file::remove_shared(name);
+        }
+
+        /// Get maximal frame width
+        std::size_t get_max_width() const noexcept {
+            return get_header().max_width;
+        }
+
+        /// Get maximal frame height
+        std::size_t get_max_height() const noexcept {
+            return get_header().max_height;
+        }
+
+        /// Get distance between frame rows (in bytes)
+        std::size_t get_pitch() const noexcept {
+            return get_header().max_width * BYTES_PER_PIXEL;
+        }
+
+        /// Get count of slots
+        std::uint32_t get_slot_count() const noexcept {
+            return get_header().slot_count;
+        }
+
+        /// Start writing the next frame, returns its pixels (`get_pitch()` bytes between rows) or null if frame doesn't fit.
+        /// Slot is invalid for consumers until `publish_frame` is called.
+        std::byte * begin_frame(std::size_t width, std::size_t height) {
+            const ring_header &header = get_header();
+            if (width > header.max_width || height > header.max_height)
+                return nullptr;
+
+            const std::uint64_t sequence = header.latest_sequence.load(std::memory_order_relaxed) + 1;
+            slot_header &slot = get_slot(sequence);
+            slot.sequence.store(0, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            slot.width = width;
+            slot.height = height;
+            return get_slot_pixels(sequence);
+        }
+
+        /// Publish frame started by the last `begin_frame`
+        void publish_frame(std::uint32_t sample_count) {
+            ring_header &header = get_header();
+            const std::uint64_t sequence = header.latest_sequence.load(std::memory_order_relaxed) + 1;
+            slot_header &slot = get_slot(sequence);
+
+            slot.sample_count = sample_count;
+            slot.publish_time = std::chrono::steady_clock::now().time_since_epoch().count();
+            slot.sequence.store(sequence, std::memory_order_release);
+            header.latest_sequence.store(sequence, std::memory_order_release);
+        }
+
+        /// Get sequence number of the latest published frame (0 if nothing was published yet)
+        std::uint64_t get_latest_sequence() const noexcept {
+            return get_header().latest_sequence.load(std::memory_order_acquire);
+        }
+
+        /// Get published frame, nullopt if it was already overwritten (or is being overwritten).
+        /// Frame pixels may be overwritten while they're read, `is_frame_valid` tells if it happened.
+        std::optional<frame> get_frame(std::uint64_t sequence) const {
+            if (sequence == 0)
+                return std::nullopt;
+
+            const slot_header &slot = get_slot(sequence);
+            if (slot.sequence.load(std::memory_order_acquire) != sequence)
+                return std::nullopt;
+
+            frame result {
+                .sequence = sequence,
+                .data = get_slot_pixels(sequence),
+                .width = slot.width,
+                .height = slot.height,
+                .pitch = get_pitch(),
+                .sample_count = slot.sample_count,
+                .publish_time = std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(slot.publish_time)),
+            };
+            return is_frame_valid(result) ? std::optional(result) : std::nullopt;
+        }
+
+        /// Check that producer didn't start overwriting frame (everything read from frame before the call is consistent)
+        bool is_frame_valid(const frame &f) const noexcept {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return get_slot(f.sequence).sequence.load(std::memory_order_relaxed) == f.sequence;
+        }
+
+    private:
+
+        /// Ring signature
+        constexpr static char MAGIC[8] = {'R', 'T', 'F', 'R', 'M', 'X', '0', '1'};
+
+        /// Alignment of slots (page size, so slot pixels never share pages with headers of other slots)
+        constexpr static std::size_t SLOT_ALIGNMENT = 4096;
+
+        /// Offset of the first slot
+        constexpr static std::size_t SLOT_OFFSET = SLOT_ALIGNMENT;
+
+        static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "shared memory sequence numbers require lock-free atomics");
+
+        /// Ring header
+        struct ring_header {
+            /// Ring signature (written last)
+            char magic[8];
+
+            /// Count of slots
+            std::uint32_t slot_count;
+
+            /// Padding
+            std::uint32_t reserved;
+
+            /// Maximal frame width
+            std::uint64_t max_width;
+
+            /// Maximal frame height
+            std::uint64_t max_height;
+
+            /// Slot size (header and pixels)
+            std::uint64_t slot_size;
+
+            /// Sequence number of the latest published frame (on separate cache line, it's polled by consumers)
+            alignas(64) std::atomic_uint64_t latest_sequence;
+        };
+
+        /// Slot header (pixels follow it)
+        struct slot_header {
+            /// Sequence number of frame in slot, zero while slot is written
+            std::atomic_uint64_t sequence;
+
+            /// Frame width
+            std::uint64_t width;
+
+            /// Frame height
+            std::uint64_t height;
+
+            /// Steady clock ticks of publication
+            std::int64_t publish_time;
+
+            /// Minimal count of samples per pixel
+            std::uint32_t sample_count;
+        };
+
+        /// Size of slot header with padding
+        constexpr static std::size_t SLOT_HEADER_SIZE = 64;
+
+        static_assert(sizeof(ring_header) <= SLOT_OFFSET && sizeof(slot_header) <= SLOT_HEADER_SIZE);
+
+        /// Get slot size (aligned)
+        static constexpr std::size_t get_slot_size(std::size_t max_width, std::size_t max_height) noexcept {
+            const std::size_t size = SLOT_HEADER_SIZE + max_width * max_height * BYTES_PER_PIXEL;
+            return (size + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+        }
+
+        /// Construct ring of mapped shared memory
+        frame_export(std::unique_ptr<mapped_file> file, std::string name, bool is_producer):
+            file(std::move(file)),
+            name(std::move(name)),
+            is_producer(is_producer)
+        {
+        }
+
+        /// Get ring header
+        ring_header & get_header() const noexcept {
+            return *reinterpret_cast<ring_header *>(file->get_data());
+        }
+
+        /// Get header of slot that holds frame `sequence`
+        slot_header & get_slot(std::uint64_t sequence) const noexcept {
+            const ring_header &header = get_header();
+            return *reinterpret_cast<slot_header *>(file->get_data() + SLOT_OFFSET + sequence % header.slot_count * header.slot_size);
+        }
+
+        /// Get pixels of slot that holds frame `sequence`
+        std::byte * get_slot_pixels(std::uint64_t sequence) const noexcept {
+            return reinterpret_cast<std::byte *>(&get_slot(sequence)) + SLOT_HEADER_SIZE;
+        }
+
+        /// Mapped ring
+        std::unique_ptr<mapped_file> file;
+
+        /// Ring name
+        std::string name;
+
+        /// True if ring was created by this object
+        bool is_producer;
+    };
+}
+
+#endif // !defined(RT_FRAME_EXPORT_HPP_)
+
+// rt_frame_export.hpp
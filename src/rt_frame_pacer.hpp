@@ -0,0 +1,62 @@
+//! Main loop frame pacing implementation file
+
+#ifndef RT_FRAME_PACER_HPP_
+#define RT_FRAME_PACER_HPP_
+
+#include "rt_common.hpp"
+
+namespace rt {
+    /// Limits loop to target rate, sleeping (not spinning) between frames, so rendering threads get the core
+    class frame_pacer {
+    public:
+
+        /// Construct pacer with target rate (frames per second)
+        frame_pacer(float rate) {
+            set_rate(rate);
+        }
+
+        /// Set target rate (frames per second)
+        void set_rate(float rate) {
+            rate = std::max(rate, 1.0f);
+            interval = std::chrono::duration_cast<clock::duration>(std::chrono::duration<float>(1.0f / rate));
+        }
+
+        /// Get target rate
+        float get_rate() const {
+            return 1.0f / std::chrono::duration<float>(interval).count();
+        }
+
+        /// Wait for the next frame slot. Overrunning frame restarts schedule instead of making next frames catch up.
+        void wait() {
+            const clock::time_point now = clock::now();
+
+            deadline += interval;
+            if (deadline <= now) {
+                deadline = now;
+                return;
+            }
+
+            // Sleep is coarse, so the last part is waited with yields
+            if (deadline - now > YIELD_DURATION)
+                std::this_thread::sleep_until(deadline - YIELD_DURATION);
+            while (clock::now() < deadline)
+                std::this_thread::yield();
+        }
+
+    private:
+        using clock = std::chrono::steady_clock;
+
+        /// Duration waited with yields before deadline
+        constexpr static clock::duration YIELD_DURATION = std::chrono::microseconds(500);
+
+        /// Frame interval
+        clock::duration interval {};
+
+        /// Current frame deadline
+        clock::time_point deadline = clock::now();
+    };
+}
+
+#endif // !defined(RT_FRAME_PACER_HPP_)
+
+// rt_frame_pacer.hpp
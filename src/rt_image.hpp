@@ -0,0 +1,421 @@
+//! HDR image container and image file loading
+
+#ifndef RT_IMAGE_HPP_
+#define RT_IMAGE_HPP_
+
+#include <array>
+#include <bit>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include "rt_shape_common.hpp"
+
+namespace rt {
+    /// Image file format
+    enum class image_format {
+        /// Binary 8-bit PPM (P6)
+        ppm,
+
+        /// 8-bit RGB PNG
+        png,
+
+        /// Uncompressed 32-bit float OpenEXR (lossless HDR)
+        exr,
+    };
+
+    /// Deduce image format from file extension
+    inline std::optional<image_format> image_format_from_path(const std::string &path) {
+        if (path.ends_with(".ppm"))
+            return image_format::ppm;
+        if (path.ends_with(".png"))
+            return image_format::png;
+        if (path.ends_with(".exr"))
+            return image_format::exr;
+        return std::nullopt;
+    }
+
+    /// Floating-point RGB image
+    class image {
+    public:
+
+        /// Construct empty image
+        image() = default;
+
+        /// Construct black image of specified size
+        image(std::size_t width, std::size_t height):
+            width(width),
+            height(height),
+            pixels(width * height)
+        {
+        }
+
+        /// Get image width
+        std::size_t get_width() const noexcept {
+            return width;
+        }
+
+        /// Get image height
+        std::size_t get_height() const noexcept {
+            return height;
+        }
+
+        /// Check if image has no pixels
+        bool is_empty() const noexcept {
+            return pixels.empty();
+        }
+
+        /// Get pixel
+        vec3 get(std::size_t x, std::size_t y) const {
+            return pixels[y * width + x];
+        }
+
+        /// Set pixel
+        void set(std::size_t x, std::size_t y, vec3 color) {
+            pixels[y * width + x] = color;
+        }
+
+        /// Get image row
+        std::span<vec3> get_row(std::size_t y) {
+            return std::span<vec3>(pixels).subspan(y * width, width);
+        }
+
+        /// Get image row
+        std::span<const vec3> get_row(std::size_t y) const {
+            return std::span<const vec3>(pixels).subspan(y * width, width);
+        }
+
+        /// Get all pixels (row-major order)
+        std::span<const vec3> get_pixels() const {
+            return pixels;
+        }
+
+        /// Load Radiance RGBE (.hdr) image
+        static std::optional<image> load_hdr(const std::string &path) {
+            std::ifstream file {path, std::ios::binary};
+            if (!file)
+                return std::nullopt;
+
+            // Header is terminated by an empty line
+            std::string line;
+            bool is_rgbe = false;
+            if (!std::getline(file, line) || !line.starts_with("#?"))
+                return std::nullopt;
+            while (std::getline(file, line) && !line.empty())
+                if (line == "FORMAT=32-bit_rle_rgbe")
+                    is_rgbe = true;
+            if (!is_rgbe || !std::getline(file, line))
+                return std::nullopt;
+
+            // Only standard orientation is supported
+            int width = 0, height = 0;
+            if (std::sscanf(line.c_str(), "-Y %d +X %d", &height, &width) != 2 || width <= 0 || height <= 0)
+                return std::nullopt;
+
+            image result {(std::size_t)width, (std::size_t)height};
+            std::vector<std::uint8_t> scanline(width * 4);
+
+            for (int y = 0; y < height; y++) {
+                if (!read_hdr_scanline(file, scanline))
+                    return std::nullopt;
+
+                for (int x = 0; x < width; x++) {
+                    const std::uint8_t *rgbe = &scanline[x * 4];
+                    vec3 color {0.0f};
+                    if (rgbe[3] != 0) {
+                        float scale = std::ldexp(1.0f, (int)rgbe[3] - (128 + 8));
+                        color = vec3(rgbe[0], rgbe[1], rgbe[2]) * vec3(scale);
+                    }
+                    result.set(x, y, color);
+                }
+            }
+
+            return result;
+        }
+
+        /// Mean squared per-component difference with image of the same size (used for quality measurements)
+        float mean_squared_error(const image &reference) const {
+            if (reference.width != width || reference.height != height || pixels.empty())
+                return std::numeric_limits<float>::infinity();
+
+            double sum = 0.0;
+            for (std::size_t i = 0; i < pixels.size(); i++) {
+                vec3 delta = pixels[i] - reference.pixels[i];
+                sum += delta.length2();
+            }
+            return sum / (pixels.size() * 3);
+        }
+
+        /// Save image in specified format (8-bit formats clamp colors to [0, 1]).
+        /// Empty images can't be saved as EXR (its data window is inclusive, so it has at least one pixel).
+        bool save(const std::string &path, image_format format) const {
+            if (format == image_format::exr && is_empty())
+                return false;
+
+            std::ofstream file {path, std::ios::binary};
+            if (!file)
+                return false;
+
+            switch (format) {
+            case image_format::ppm: write_ppm(file); break;
+            case image_format::png: write_png(file); break;
+            case image_format::exr: write_exr(file); break;
+            }
+
+            return (bool)file.flush();
+        }
+
+        /// Save image, deducing format from path extension
+        bool save(const std::string &path) const {
+            std::optional<image_format> format = image_format_from_path(path);
+            return format.has_value() && save(path, *format);
+        }
+
+    private:
+
+        /// Byte buffer used by encoders
+        using byte_buffer = std::vector<std::uint8_t>;
+
+        /// Append little-endian 32-bit value
+        static void put_le32(byte_buffer &buffer, std::uint32_t value) {
+            for (int i = 0; i < 4; i++)
+                buffer.push_back(value >> (i * 8));
+        }
+
+        /// Append big-endian 32-bit value
+        static void put_be32(byte_buffer &buffer, std::uint32_t value) {
+            for (int i = 3; i >= 0; i--)
+                buffer.push_back(value >> (i * 8));
+        }
+
+        /// Append string with terminating zero
+        static void put_string(byte_buffer &buffer, const char *str) {
+            buffer.insert(buffer.end(), str, str + std::strlen(str) + 1);
+        }
+
+        /// Convert color component to 8-bit value
+        static std::uint8_t to_byte(float value) {
+            return (std::uint8_t)(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+        }
+
+        /// Write binary PPM
+        void write_ppm(std::ofstream &file) const {
+            file << "P6\n" << width << ' ' << height << "\n255\n";
+
+            byte_buffer data;
+            data.reserve(pixels.size() * 3);
+            for (vec3 pixel : pixels) {
+                data.push_back(to_byte(pixel.x));
+                data.push_back(to_byte(pixel.y));
+                data.push_back(to_byte(pixel.z));
+            }
+            file.write(reinterpret_cast<const char *>(data.data()), data.size());
+        }
+
+        /// Write PNG (image data is stored in uncompressed deflate blocks, encoding cost is a single copy)
+        void write_png(std::ofstream &file) const {
+            static constexpr std::array<std::uint32_t, 256> crc_table = [] {
+                std::array<std::uint32_t, 256> table {};
+                for (std::uint32_t n = 0; n < 256; n++) {
+                    std::uint32_t c = n;
+                    for (int k = 0; k < 8; k++)
+                        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                    table[n] = c;
+                }
+                return table;
+            }();
+
+            auto write_chunk = [&](const char *type, const byte_buffer &data) {
+                byte_buffer chunk;
+                put_be32(chunk, data.size());
+                chunk.insert(chunk.end(), type, type + 4);
+                chunk.insert(chunk.end(), data.begin(), data.end());
+
+                std::uint32_t crc = 0xFFFFFFFFu;
+                for (std::size_t i = 4; i < chunk.size(); i++)
+                    crc = crc_table[(crc ^ chunk[i]) & 0xFF] ^ (crc >> 8);
+                put_be32(chunk, crc ^ 0xFFFFFFFFu);
+
+                file.write(reinterpret_cast<const char *>(chunk.data()), chunk.size());
+            };
+
+            static const std::uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+            file.write(reinterpret_cast<const char *>(signature), sizeof(signature));
+
+            byte_buffer header;
+            put_be32(header, width);
+            put_be32(header, height);
+            header.insert(header.end(), {8, 2, 0, 0, 0}); // 8 bit depth, RGB, default compression/filter, no interlace
+            write_chunk("IHDR", header);
+
+            // Filtered scanlines (filter type 0)
+            byte_buffer raw;
+            raw.reserve(height * (width * 3 + 1));
+            for (std::size_t y = 0; y < height; y++) {
+                raw.push_back(0);
+                for (vec3 pixel : get_row(y)) {
+                    raw.push_back(to_byte(pixel.x));
+                    raw.push_back(to_byte(pixel.y));
+                    raw.push_back(to_byte(pixel.z));
+                }
+            }
+
+            // zlib stream of stored blocks
+            byte_buffer stream {0x78, 0x01};
+            std::size_t offset = 0;
+            do {
+                std::size_t length = std::min<std::size_t>(raw.size() - offset, 0xFFFF);
+                stream.push_back(offset + length == raw.size() ? 1 : 0);
+                stream.insert(stream.end(), {
+                    (std::uint8_t)length, (std::uint8_t)(length >> 8),
+                    (std::uint8_t)~length, (std::uint8_t)(~length >> 8),
+                });
+                stream.insert(stream.end(), raw.begin() + offset, raw.begin() + offset + length);
+                offset += length;
+            } while (offset < raw.size());
+
+            std::uint32_t adler_a = 1, adler_b = 0;
+            for (std::uint8_t byte : raw) {
+                adler_a = (adler_a + byte) % 65521;
+                adler_b = (adler_b + adler_a) % 65521;
+            }
+            put_be32(stream, adler_b << 16 | adler_a);
+
+            write_chunk("IDAT", stream);
+            write_chunk("IEND", {});
+        }
+
+        /// Write single-part scanline OpenEXR with FLOAT channels and no compression
+        void write_exr(std::ofstream &file) const {
+            assert(!is_empty());
+
+            byte_buffer data;
+            put_le32(data, 20000630); // magic number
+            put_le32(data, 2);        // version 2, scanline image
+
+            auto put_attribute = [&](const char *name, const char *type, const byte_buffer &value) {
+                put_string(data, name);
+                put_string(data, type);
+                put_le32(data, value.size());
+                data.insert(data.end(), value.begin(), value.end());
+            };
+
+            // Channels must be sorted by name
+            byte_buffer channels;
+            for (const char *name : {"B", "G", "R"}) {
+                put_string(channels, name);
+                put_le32(channels, 2); // FLOAT
+                channels.insert(channels.end(), {0, 0, 0, 0}); // pLinear, reserved
+                put_le32(channels, 1); // x sampling
+                put_le32(channels, 1); // y sampling
+            }
+            channels.push_back(0);
+
+            byte_buffer window;
+            put_le32(window, 0);
+            put_le32(window, 0);
+            put_le32(window, width - 1);
+            put_le32(window, height - 1);
+
+            byte_buffer one;
+            put_le32(one, std::bit_cast<std::uint32_t>(1.0f));
+
+            byte_buffer center;
+            put_le32(center, 0);
+            put_le32(center, 0);
+
+            put_attribute("channels", "chlist", channels);
+            put_attribute("compression", "compression", {0});
+            put_attribute("dataWindow", "box2i", window);
+            put_attribute("displayWindow", "box2i", window);
+            put_attribute("lineOrder", "lineOrder", {0});
+            put_attribute("pixelAspectRatio", "float", one);
+            put_attribute("screenWindowCenter", "v2f", center);
+            put_attribute("screenWindowWidth", "float", one);
+            data.push_back(0);
+
+            // Scanline offset table
+            const std::size_t line_size = width * 3 * sizeof(float);
+            const std::uint64_t first_line = data.size() + height * sizeof(std::uint64_t);
+            for (std::size_t y = 0; y < height; y++) {
+                std::uint64_t line_offset = first_line + y * (line_size + 8);
+                put_le32(data, line_offset);
+                put_le32(data, line_offset >> 32);
+            }
+
+            data.reserve(data.size() + height * (line_size + 8));
+            for (std::size_t y = 0; y < height; y++) {
+                put_le32(data, y);
+                put_le32(data, line_size);
+
+                std::span<const vec3> row = get_row(y);
+                for (float vec3::*channel : {&vec3::z, &vec3::y, &vec3::x})
+                    for (const vec3 &pixel : row)
+                        put_le32(data, std::bit_cast<std::uint32_t>(pixel.*channel));
+            }
+
+            file.write(reinterpret_cast<const char *>(data.data()), data.size());
+        }
+
+        /// Read single (possibly run-length encoded) RGBE scanline
+        static bool read_hdr_scanline(std::ifstream &file, std::vector<std::uint8_t> &scanline) {
+            const std::size_t width = scanline.size() / 4;
+
+            std::uint8_t head[4];
+            if (!file.read(reinterpret_cast<char *>(head), 4))
+                return false;
+
+            // Flat scanline
+            if (width < 8 || width > 0x7FFF || head[0] != 2 || head[1] != 2 || (head[2] & 0x80) != 0) {
+                std::memcpy(scanline.data(), head, 4);
+                return (bool)file.read(reinterpret_cast<char *>(scanline.data() + 4), scanline.size() - 4);
+            }
+
+            if (((std::size_t)head[2] << 8 | head[3]) != width)
+                return false;
+
+            // Run-length encoded scanline, channels are stored separately
+            for (std::size_t channel = 0; channel < 4; channel++) {
+                std::size_t x = 0;
+                while (x < width) {
+                    int count = file.get();
+                    if (count == EOF)
+                        return false;
+
+                    if (count > 128) {
+                        count -= 128;
+                        int value = file.get();
+                        if (value == EOF || x + count > width)
+                            return false;
+                        while (count--)
+                            scanline[x++ * 4 + channel] = value;
+                    } else {
+                        if (count == 0 || x + count > width)
+                            return false;
+                        while (count--) {
+                            int value = file.get();
+                            if (value == EOF)
+                                return false;
+                            scanline[x++ * 4 + channel] = value;
+                        }
+                    }
+                }
+            }
+
+            return true;
+        }
+
+        /// Image width
+        std::size_t width = 0;
+
+        /// Image height
+        std::size_t height = 0;
+
+        /// Image pixels
+        std::vector<vec3> pixels {};
+    };
+}
+
+#endif // !defined(RT_IMAGE_HPP_)
+
+// rt_image.hpp
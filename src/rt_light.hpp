@@ -0,0 +1,316 @@
+//! Light sources implementation file
+
+#ifndef RT_LIGHT_HPP_
+#define RT_LIGHT_HPP_
+
+#include <numbers>
+
+#include "rt_bvh.hpp"
+
+namespace rt {
+    /// Light sample
+    struct light_sample {
+        /// Unit direction from shading point to light
+        vec3 direction;
+
+        /// Distance to light along direction (shadow rays must not go further)
+        float distance = 0.0f;
+
+        /// Incoming radiance divided by solid angle sampling density (irradiance estimate without cosine factor)
+        vec3 radiance;
+    };
+
+    /// Light source
+    class light {
+    public:
+
+        /// Light kind
+        enum class kind {
+            /// Isotropic point light
+            point,
+
+            /// Point light with angular falloff
+            spot,
+
+            /// Sphere with uniform surface radiance
+            sphere,
+        };
+
+        /// Construct point light with specified radiant intensity
+        static light point(vec3 position, vec3 intensity) {
+            return light {
+                .type = kind::point,
+                .position = position,
+                .intensity = intensity,
+            };
+        }
+
+        /// Construct spot light, full intensity inside `inner_angle`, no light outside `outer_angle` (angles in radians)
+        static light spot(vec3 position, vec3 direction, vec3 intensity, float inner_angle, float outer_angle) {
+            return light {
+                .type = kind::spot,
+                .position = position,
+                .direction = direction.normalized(),
+                .intensity = intensity,
+                .cos_inner = std::cos(std::min(inner_angle, outer_angle)),
+                .cos_outer = std::cos(outer_angle),
+            };
+        }
+
+        /// Construct emissive sphere with specified surface radiance
+        static light sphere(vec3 center, float radius, vec3 radiance) {
+            return light {
+                .type = kind::sphere,
+                .position = center,
+                .intensity = radiance,
+                .radius = radius,
+            };
+        }
+
+        /// Light kind
+        kind type = kind::point;
+
+        /// Light position (sphere center)
+        vec3 position;
+
+        /// Spot direction (unit)
+        vec3 direction {0.0f, -1.0f, 0.0f};
+
+        /// Radiant intensity (surface radiance for spheres)
+        vec3 intensity;
+
+        /// Sphere radius
+        float radius = 0.0f;
+
+        /// Spot full intensity cone cosine
+        float cos_inner = -1.0f;
+
+        /// Spot cone cosine
+        float cos_outer = -1.0f;
+
+        /// Get bounds of light emitting region
+        aabb get_bounds() const {
+            return aabb {
+                .min = position - vec3(radius),
+                .max = position + vec3(radius),
+            };
+        }
+
+        /// Estimate intensity luminance averaged over all directions (used for importance sampling)
+        float get_average_intensity() const {
+            const float luminance = intensity.dot(vec3(0.2126f, 0.7152f, 0.0722f));
+
+            switch (type) {
+            case kind::point:
+                return luminance;
+            case kind::spot:
+                return luminance * 0.5f * (1.0f - cos_outer);
+            case kind::sphere:
+                return luminance * std::numbers::pi_v<float> * radius * radius;
+            }
+            return 0.0f;
+        }
+
+        /// Sample light from point (`u0`, `u1` are uniform in [0, 1)), radiance is zero if light doesn't reach the point
+        light_sample sample(vec3 point, float u0, float u1) const {
+            const vec3 delta = position - point;
+            const float distance2 = delta.length2();
+            const float distance = std::sqrt(distance2);
+            const vec3 to_light = delta * vec3(1.0f / distance);
+
+            switch (type) {
+            case kind::point:
+                return light_sample {
+                    .direction = to_light,
+                    .distance = distance,
+                    .radiance = intensity * vec3(1.0f / distance2),
+                };
+
+            case kind::spot: {
+                const float cos_angle = -to_light.dot(direction);
+                const float t = std::clamp((cos_angle - cos_outer) / std::max(cos_inner - cos_outer, 1e-6f), 0.0f, 1.0f);
+                return light_sample {
+                    .direction = to_light,
+                    .distance = distance,
+                    .radiance = intensity * vec3(t * t * (3.0f - 2.0f * t) / distance2),
+                };
+            }
+
+            case kind::sphere: {
+                if (distance <= radius)
+                    return light_sample {};
+
+                // Uniform sampling of cone subtended by sphere
+                const float sin2_max = radius * radius / distance2;
+                const float cos_max = std::sqrt(std::max(1.0f - sin2_max, 0.0f));
+                const float cos_theta = 1.0f - u0 * (1.0f - cos_max);
+                const float sin_theta = std::sqrt(std::max(1.0f - cos_theta * cos_theta, 0.0f));
+                const float phi = 2.0f * std::numbers::pi_v<float> * u1;
+
+                vec3 tangent, bitangent;
+                math::make_basis(to_light, tangent, bitangent);
+                const vec3 sampled = tangent * vec3(sin_theta * std::cos(phi))
+                    + bitangent * vec3(sin_theta * std::sin(phi))
+                    + to_light * vec3(cos_theta);
+
+                // Distance to the nearest sphere point along sampled direction
+                const float projection = distance * cos_theta;
+                const float hit = projection - std::sqrt(std::max(radius * radius - distance2 + projection * projection, 0.0f));
+
+                return light_sample {
+                    .direction = sampled,
+                    .distance = hit,
+                    .radiance = intensity * vec3(2.0f * std::numbers::pi_v<float> * (1.0f - cos_max)),
+                };
+            }
+            }
+            return light_sample {};
+        }
+    };
+
+    /// Light hierarchy, selects lights proportionally to their estimated contribution to shading point
+    class light_tree {
+    public:
+
+        /// Build tree over lights
+        void build(std::span<const light> lights) {
+            light_bounds.clear();
+            light_intensities.clear();
+            for (const light &l : lights) {
+                light_bounds.push_back(l.get_bounds());
+                light_intensities.push_back(std::max(l.get_average_intensity(), 0.0f));
+            }
+
+            hierarchy.build(light_bounds);
+
+            // Children always have greater indices than their parents
+            std::span<const bvh::node> nodes = hierarchy.get_nodes();
+            std::span<const std::uint32_t> primitives = hierarchy.get_primitives();
+            node_intensities.assign(nodes.size(), 0.0f);
+            for (std::size_t i = nodes.size(); i-- > 0;) {
+                const bvh::node &n = nodes[i];
+                if (n.count == 0)
+                    node_intensities[i] = node_intensities[n.first] + node_intensities[n.first + 1];
+                else
+                    for (std::uint32_t p = n.first; p < n.first + n.count; p++)
+                        node_intensities[i] += light_intensities[primitives[p]];
+            }
+        }
+
+        /// Check if tree has no lights
+        bool is_empty() const noexcept {
+            return hierarchy.is_empty();
+        }
+
+        /// Select light for shading point with normal `normal` (`u` is uniform in [0, 1)).
+        /// Writes index of selected light and probability of its selection, returns false if no light may contribute.
+        bool select(vec3 point, vec3 normal, float u, std::uint32_t &light_index, float &probability) const {
+            std::span<const bvh::node> nodes = hierarchy.get_nodes();
+            std::span<const std::uint32_t> primitives = hierarchy.get_primitives();
+            if (nodes.empty())
+                return false;
+
+            probability = 1.0f;
+            const bvh::node *n = &nodes[0];
+
+            // Descend choosing children by importance, `u` is rescaled to stay uniform
+            while (n->count == 0) {
+                const float left = importance(nodes[n->first].bounds, node_intensities[n->first], point, normal);
+                const float right = importance(nodes[n->first + 1].bounds, node_intensities[n->first + 1], point, normal);
+                if (left + right <= 0.0f)
+                    return false;
+
+                const float left_probability = left / (left + right);
+                if (u < left_probability) {
+                    u = u / left_probability;
+                    probability *= left_probability;
+                    n = &nodes[n->first];
+                } else {
+                    u = (u - left_probability) / (1.0f - left_probability);
+                    probability *= 1.0f - left_probability;
+                    n = &nodes[n->first + 1];
+                }
+                u = std::min(u, 0.99999994f);
+            }
+
+            // Select light inside leaf (leaves never exceed MAX_LEAF_SIZE * 4 primitives)
+            float total = 0.0f;
+            float weights[bvh::MAX_LEAF_SIZE * 4];
+            const std::uint32_t count = std::min<std::uint32_t>(n->count, std::size(weights));
+            for (std::uint32_t i = 0; i < count; i++) {
+                const std::uint32_t index = primitives[n->first + i];
+                total += weights[i] = importance(light_bounds[index], light_intensities[index], point, normal);
+            }
+            if (total <= 0.0f)
+                return false;
+
+            float threshold = u * total;
+            std::uint32_t selected = count - 1;
+            for (std::uint32_t i = 0; i < count; i++) {
+                if (threshold < weights[i] && weights[i] > 0.0f) {
+                    selected = i;
+                    break;
+                }
+                threshold -= weights[i];
+            }
+            while (weights[selected] <= 0.0f)
+                selected--;
+
+            light_index = primitives[n->first + selected];
+            probability *= weights[selected] / total;
+            return true;
+        }
+
+    private:
+
+        /// Conservative estimate of contribution of lights inside `bounds` with total `intensity` to shading point
+        static float importance(const aabb &bounds, float intensity, vec3 point, vec3 normal) {
+            const vec3 half_extent = (bounds.max - bounds.min) * vec3(0.5f);
+            const float radius2 = half_extent.length2();
+
+            const vec3 delta = bounds.min + half_extent - point;
+            const float distance2 = delta.length2();
+            const float normal_projection = normal.dot(delta);
+
+            // Single point: exact cosine and distance
+            if (radius2 == 0.0f)
+                return normal_projection <= 0.0f ? 0.0f : intensity * normal_projection / (distance2 * std::sqrt(distance2));
+
+            // Shading point inside bounding sphere: no distance or orientation bound
+            if (distance2 <= radius2)
+                return intensity / radius2;
+
+            // Cosine of angle between normal and the closest direction to bounding sphere,
+            // i.e. cos(max(theta_center - theta_bound, 0))
+            const float inv_distance = 1.0f / std::sqrt(distance2);
+            const float cos_center = std::clamp(normal_projection * inv_distance, -1.0f, 1.0f);
+            const float sin2_bound = radius2 / distance2;
+            const float cos_bound = std::sqrt(1.0f - sin2_bound);
+
+            float cos_closest = 1.0f;
+            if (cos_center < cos_bound) {
+                cos_closest = cos_center * cos_bound + std::sqrt((1.0f - cos_center * cos_center) * sin2_bound);
+                if (cos_closest <= 0.0f)
+                    return 0.0f;
+            }
+
+            return intensity * cos_closest / std::max(distance2 - radius2, radius2);
+        }
+
+        /// Light hierarchy
+        bvh hierarchy {};
+
+        /// Bounds of lights
+        std::vector<aabb> light_bounds {};
+
+        /// Average intensities of lights
+        std::vector<float> light_intensities {};
+
+        /// Sum of light intensities of node subtrees
+        std::vector<float> node_intensities {};
+    };
+}
+
+#endif // !defined(RT_LIGHT_HPP_)
+
+// rt_light.hpp
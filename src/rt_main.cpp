@@ -7,8 +7,23 @@
 
 #include "rt.hpp"
 
-// Main function
-int main() {
+// Main function. Options:
+//   `--fps <rate>` sets presentation rate, display refresh rate is used by default;
+//   `--checkpoint <path>` resumes accumulation from checkpoint file and updates it every 30 seconds;
+//   `--export <name>` publishes every presented frame to shared memory ring `name` (e.g. "/cpprt").
+int main(int argc, char **argv) {
+    float configured_rate = 0.0f;
+    std::string checkpoint_path;
+    std::string export_name;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string_view(argv[i]) == "--fps")
+            configured_rate = std::strtof(argv[i + 1], nullptr);
+        if (std::string_view(argv[i]) == "--checkpoint")
+            checkpoint_path = argv[i + 1];
+        if (std::string_view(argv[i]) == "--export")
+            export_name = argv[i + 1];
+    }
+
     if (!SDL_Init(SDL_INIT_VIDEO)) {
         std::println("SDL Initialization failed: {}", SDL_GetError());
         return 0;
@@ -25,10 +40,10 @@ int main() {
     auto sphere2_material = std::make_shared<rt::material>(rt::vec3(0.6f, 0.6f, 0.6f));
     auto plane_material = std::make_shared<rt::material>(rt::vec3(0.80f, 0.47f, 0.30f));
 
-    auto scene = std::make_unique<rt::shape::scene>();
+    rt::shape::scene scene;
 
     // Fill scene with objects
-    *scene
+    scene
         << std::make_unique<rt::shape::sphere>(rt::vec3(0.0f), 1.0f, sphere1_material)
         << std::make_unique<rt::shape::sphere>(rt::vec3(1.4f), 0.3f, sphere2_material)
         << std::make_unique<rt::shape::plane>(
@@ -40,8 +55,37 @@ int main() {
 
     rt::engine engine {std::move(scene)};
 
+    // Display refresh rate (60 if unknown)
+    auto get_display_rate = [&]() {
+        const SDL_DisplayMode *mode = SDL_GetCurrentDisplayMode(SDL_GetDisplayForWindow(window));
+        return mode != nullptr && mode->refresh_rate > 0.0f ? mode->refresh_rate : 60.0f;
+    };
+    rt::frame_pacer pacer {configured_rate > 0.0f ? configured_rate : get_display_rate()};
+
+    // Export ring fits window of any size up to the display one
+    std::unique_ptr<rt::frame_export> exporter;
+    if (!export_name.empty()) {
+        const SDL_DisplayMode *mode = SDL_GetCurrentDisplayMode(SDL_GetDisplayForWindow(window));
+        exporter = mode != nullptr
+            ? rt::frame_export::create(export_name, mode->w, mode->h)
+            : rt::frame_export::create(export_name, 1920, 1080);
+        if (exporter == nullptr)
+            std::println("Frame export ring creation failed: {}", export_name);
+    }
+
+    // Frame is presented only if something changed since the last present
+    std::uint64_t presented_sample_count = 0;
+    bool is_present_forced = true;
+
     rt::input input {SDL_SCANCODE_COUNT};
     rt::timer timer;
+    rt::frame_writer writer;
+    std::size_t capture_index = 0;
+    bool is_denoising = false;
+
+    // Region under cursor gets more samples while focus is enabled
+    constexpr float FOCUS_SIZE = 128.0f;
+    bool is_focused = false;
 
     // Current camera state
     rt::camera camera = rt::camera::from_loc_dir_up(
@@ -53,6 +97,14 @@ int main() {
     // Update engine camera
     engine.set_camera(camera);
 
+    // Checkpoint sets render resolution, if window size differs the first present resamples resumed samples to it
+    // (accumulation continues with reduced sample count instead of restarting)
+    if (!checkpoint_path.empty()) {
+        if (engine.resume_from_checkpoint(checkpoint_path))
+            camera = engine.get_camera();
+        engine.start_checkpointing(checkpoint_path, std::chrono::seconds(30));
+    }
+
     bool do_quit = false;
     while (!do_quit) {
         SDL_Event event = {};
@@ -68,6 +120,16 @@ int main() {
                     event.window.data1,
                     event.window.data2
                 );
+                is_present_forced = true;
+                break;
+
+            case SDL_EVENT_WINDOW_EXPOSED:
+                is_present_forced = true;
+                break;
+
+            case SDL_EVENT_WINDOW_DISPLAY_CHANGED:
+                if (configured_rate <= 0.0f)
+                    pacer.set_rate(get_display_rate());
                 break;
 
             case SDL_EVENT_KEY_DOWN:
@@ -151,26 +213,117 @@ int main() {
             }
         }
 
+        // Toggle denoiser (N)
+        if (input.is_key_clicked(SDL_SCANCODE_N)) {
+            is_denoising = !is_denoising;
+            engine.set_denoising(is_denoising);
+            is_present_forced = true;
+        }
+
+        // Toggle wavefront mode (M), cycle diffuse bounce count (B)
+        if (input.is_key_clicked(SDL_SCANCODE_M) || input.is_key_clicked(SDL_SCANCODE_B)) {
+            rt::render_settings settings = engine.get_render_settings();
+            if (input.is_key_clicked(SDL_SCANCODE_M))
+                settings.mode = settings.mode == rt::render_mode::wavefront ? rt::render_mode::per_pixel : rt::render_mode::wavefront;
+            if (input.is_key_clicked(SDL_SCANCODE_B))
+                settings.max_bounces = settings.max_bounces >= 8 ? 0 : std::max(settings.max_bounces * 2, 1u);
+            engine.set_render_settings(settings);
+        }
+
+        // Rotate preview light around vertical axis (L), camera rays are not traced again for it
+        if (input.is_key_clicked(SDL_SCANCODE_L)) {
+            constexpr float LIGHT_STEP = std::numbers::pi_v<float> / 8.0f;
+
+            rt::shading_settings shading = engine.get_shading();
+            const rt::vec3 d = shading.preview_light_direction;
+            shading.preview_light_direction = rt::vec3(
+                d.x * std::cos(LIGHT_STEP) - d.z * std::sin(LIGHT_STEP),
+                d.y,
+                d.x * std::sin(LIGHT_STEP) + d.z * std::cos(LIGHT_STEP)
+            );
+            engine.set_shading(shading);
+        }
+
+        // Toggle sampling focus under cursor (G)
+        if (input.is_key_clicked(SDL_SCANCODE_G)) {
+            is_focused = !is_focused;
+            if (!is_focused)
+                engine.set_priority_regions({});
+        }
+        if (is_focused) {
+            float cursor_x, cursor_y;
+            SDL_GetMouseState(&cursor_x, &cursor_y);
+            engine.set_priority_regions({rt::priority_region {
+                .x = (std::size_t)std::max(cursor_x - FOCUS_SIZE / 2, 0.0f),
+                .y = (std::size_t)std::max(cursor_y - FOCUS_SIZE / 2, 0.0f),
+                .width = (std::size_t)FOCUS_SIZE,
+                .height = (std::size_t)FOCUS_SIZE,
+                .weight = 8.0f,
+            }});
+        }
+
+        // Capture (F12), encoding is done in background
+        if (input.is_key_clicked(SDL_SCANCODE_F12)) {
+            rt::image frame = engine.capture_frame();
+            writer.submit(frame, std::format("capture_{:04}.png", capture_index));
+            writer.submit(std::move(frame), std::format("capture_{:04}.exr", capture_index));
+            capture_index++;
+        }
+
+        // Dump profiler zones (F11), does nothing unless built with RT_PROFILE
+        if (input.is_key_clicked(SDL_SCANCODE_F11))
+            rt::profiler::write_chrome_trace("trace.json");
+
         input.clear_change_flags();
 
-        // Render
-        SDL_Surface *surface = SDL_GetWindowSurface(window);
+        // Render (skipped if no row collected new samples since the last present)
+        const std::uint64_t sample_count = engine.get_sample_count();
+        timer.set_sample_count(sample_count);
 
-        if (!SDL_MUSTLOCK(surface) || SDL_LockSurface(surface)) {
-            // Display only if pixelformats is good enough
-            if (surface->format == SDL_PIXELFORMAT_BGRX32) {
-                engine.set_render_resolution(surface->w, surface->h);
-                engine.display_frame(
-                    reinterpret_cast<std::byte *>(surface->pixels),
-                    surface->pitch
-                );
+        if (is_present_forced || sample_count != presented_sample_count) {
+            SDL_Surface *surface = SDL_GetWindowSurface(window);
+
+            if (!SDL_MUSTLOCK(surface) || SDL_LockSurface(surface)) {
+                // Display only if pixelformats is good enough and framebuffer matches surface size
+                // (failed resize keeps the previous framebuffer, which doesn't fit surface)
+                const bool is_displayable = surface->format == SDL_PIXELFORMAT_BGRX32 && engine.set_render_resolution(surface->w, surface->h);
+
+                // Frame is resolved (and denoised) once: exported frame is copied to surface
+                const bool is_exported = exporter != nullptr && engine.export_frame(*exporter);
+
+                if (is_displayable) {
+                    std::byte *pixels = reinterpret_cast<std::byte *>(surface->pixels);
+
+                    if (is_exported) {
+                        const rt::frame_export::frame exported = *exporter->get_frame(exporter->get_latest_sequence());
+                        for (std::size_t y = 0; y < exported.height; y++)
+                            std::memcpy(pixels + y * surface->pitch, exported.data + y * exported.pitch, exported.width * rt::frame_export::BYTES_PER_PIXEL);
+                    } else {
+                        engine.display_frame(pixels, surface->pitch);
+                    }
+                }
+
+                if (SDL_MUSTLOCK(surface))
+                    SDL_UnlockSurface(surface);
             }
 
-            if (SDL_MUSTLOCK(surface))
-                SDL_UnlockSurface(surface);
+            SDL_UpdateWindowSurface(window);
+            timer.on_present();
+
+            presented_sample_count = sample_count;
+            is_present_forced = false;
         }
 
-        SDL_UpdateWindowSurface(window);
+        // Report render progress
+        if (timer.is_fps_new())
+            SDL_SetWindowTitle(window, std::format(
+                "RT - {:.0f}/{:.0f} presents/s, {:.2f} Msamples/s",
+                timer.get_present_rate(),
+                pacer.get_rate(),
+                timer.get_sample_rate() * 1e-6f
+            ).c_str());
+
+        pacer.wait();
     }
 
     SDL_DestroyWindow(window);
@@ -0,0 +1,127 @@
+//! Memory-mapped file implementation file
+
+#ifndef RT_MAPPED_FILE_HPP_
+#define RT_MAPPED_FILE_HPP_
+
+#include <string>
+
+#include "rt_common.hpp"
+
+#if defined(__unix__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace rt {
+    /// File (or shared memory object) mapped to memory with shared (write-through) mapping, available on POSIX systems only
+    class mapped_file {
+    public:
+
+        /// Map whole existing file (`size` is zero) or create file and resize it to `size` bytes, null on failure
+        static std::unique_ptr<mapped_file> open(const std::string &path, std::size_t size = 0) {
+#if defined(__unix__)
+            return map(::open(path.c_str(), size != 0 ? O_RDWR | O_CREAT : O_RDWR, 0644), size);
+#else
+            return nullptr;
+#endif
+        }
+
+        /// Same as `open`, but for POSIX shared memory object `name` (e.g. "/name"), which has no storage behind it
+        static std::unique_ptr<mapped_file> open_shared(const std::string &name, std::size_t size = 0) {
+#if defined(__unix__)
+            return map(shm_open(name.c_str(), size != 0 ? O_RDWR | O_CREAT : O_RDWR, 0644), size);
+#else
+            return nullptr;
+#endif
+        }
+
+        /// Remove shared memory object name, existing mappings stay valid
+        static bool remove_shared(const std::string &name) {
+#if defined(__unix__)
+            return shm_unlink(name.c_str()) == 0;
+#else
+            return false;
+#endif
+        }
+
+        /// File is not copyable
+        mapped_file(const mapped_file &) = delete;
+        mapped_file & operator=(const mapped_file &) = delete;
+
+        /// Unmap and close file
+        ~mapped_file() {
+#if defined(__unix__)
+            munmap(data, size);
+            close(descriptor);
+#endif
+        }
+
+        /// Get mapped data
+        std::byte * get_data() const noexcept {
+            return data;
+        }
+
+        /// Get file size
+        std::size_t get_size() const noexcept {
+            return size;
+        }
+
+        /// Write range of mapped data to storage (blocks until done)
+        bool sync(std::size_t offset, std::size_t range_size) const {
+#if defined(__unix__)
+            // msync range must start at page boundary
+            const std::size_t page_size = sysconf(_SC_PAGESIZE);
+            const std::size_t begin = offset / page_size * page_size;
+            return msync(data + begin, offset + range_size - begin, MS_SYNC) == 0;
+#else
+            return false;
+#endif
+        }
+
+    private:
+
+#if defined(__unix__)
+        /// Map file of `descriptor` (resized to `size` bytes if it isn't zero), descriptor is closed on failure
+        static std::unique_ptr<mapped_file> map(int descriptor, std::size_t size) {
+            if (descriptor < 0)
+                return nullptr;
+
+            struct stat info;
+            const bool is_sized = size != 0
+                ? ftruncate(descriptor, size) == 0
+                : fstat(descriptor, &info) == 0 && (size = info.st_size) != 0;
+
+            void *data = is_sized ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0) : MAP_FAILED;
+            if (data == MAP_FAILED) {
+                close(descriptor);
+                return nullptr;
+            }
+
+            return std::unique_ptr<mapped_file>(new mapped_file(descriptor, static_cast<std::byte *>(data), size));
+        }
+#endif
+
+        /// Construct mapping
+        mapped_file(int descriptor, std::byte *data, std::size_t size):
+            descriptor(descriptor),
+            data(data),
+            size(size)
+        {
+        }
+
+        /// File descriptor
+        int descriptor;
+
+        /// Mapped data
+        std::byte *data;
+
+        /// Mapped size
+        std::size_t size;
+    };
+}
+
+#endif // !defined(RT_MAPPED_FILE_HPP_)
+
+// rt_mapped_file.hpp
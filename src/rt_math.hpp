@@ -3,7 +3,13 @@
 #ifndef RT_MATH_HPP_
 #define RT_MATH_HPP_
 
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace rt::math {
     /// Generic 3-component vector class
@@ -84,7 +90,177 @@ namespace rt::math {
         vec3 normalized() const {
             return *this * vec3(1.0f / length());
         }
+
+        /// With approximately unit length (same as `normalized` for generic vectors)
+        vec3 normalized_fast() const {
+            return normalized();
+        }
+
+        /// Component-wise minimum
+        vec3 min(const vec3 &v) const {
+            return vec3(std::min(x, v.x), std::min(y, v.y), std::min(z, v.z));
+        }
+
+        /// Component-wise maximum
+        vec3 max(const vec3 &v) const {
+            return vec3(std::max(x, v.x), std::max(y, v.y), std::max(z, v.z));
+        }
+
+        /// Component by axis index (0 - x, 1 - y, 2 - z)
+        type operator[](std::size_t axis) const {
+            return axis == 0 ? x : axis == 1 ? y : z;
+        }
+    };
+
+#if defined(__SSE2__)
+    /// Single precision 3-component vector, kept in 16-byte aligned SSE register layout (fourth lane is zero)
+    template <>
+    class alignas(16) vec3<float> {
+    public:
+
+        /// X component
+        float x;
+
+        /// Y component
+        float y;
+
+        /// Z component
+        float z;
+
+        /// Padding lane
+        float w;
+
+
+        /// Construct default 3-component vector
+        vec3() {
+            _mm_store_ps(&x, _mm_setzero_ps());
+        }
+
+        /// Construct 3-component vector from components (single vector store avoids store forwarding stalls)
+        vec3(float x, float y, float z) {
+            _mm_store_ps(&this->x, _mm_set_ps(0.0f, z, y, x));
+        }
+
+        /// Construct 3-component vector from single number
+        explicit vec3(float c) {
+            _mm_store_ps(&x, _mm_set_ps(0.0f, c, c, c));
+        }
+
+        /// Addition
+        vec3 operator+(const vec3 &v) const {
+            return vec3(_mm_add_ps(load(), v.load()));
+        }
+
+        /// Substraction
+        vec3 operator-(const vec3 &v) const {
+            return vec3(_mm_sub_ps(load(), v.load()));
+        }
+
+        /// Multiplication
+        vec3 operator*(const vec3 &v) const {
+            return vec3(_mm_mul_ps(load(), v.load()));
+        }
+
+        /// Division (padding lane is kept zero)
+        vec3 operator/(const vec3 &v) const {
+            return vec3(_mm_and_ps(_mm_div_ps(load(), v.load()), xyz_mask()));
+        }
+
+        /// Dot product
+        float dot(const vec3 &v) const {
+            return horizontal_sum(_mm_mul_ps(load(), v.load()));
+        }
+
+        /// Squared length
+        float length2() const {
+            return dot(*this);
+        }
+
+        /// Length
+        float length() const {
+            return std::sqrt(length2());
+        }
+
+        /// Cross product
+        vec3 cross(const vec3 &v) const {
+            const __m128 a = load();
+            const __m128 b = v.load();
+            const __m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+            const __m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+            const __m128 c = _mm_sub_ps(_mm_mul_ps(a, b_yzx), _mm_mul_ps(a_yzx, b));
+            return vec3(_mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1)));
+        }
+
+        /// With unit length
+        vec3 normalized() const {
+            return *this * vec3(1.0f / length());
+        }
+
+        /// With approximately unit length: hardware reciprocal square root refined by single Newton-Raphson step,
+        /// relative error is below 1e-6 (compared to 1.2e-7 of `normalized`)
+        vec3 normalized_fast() const {
+            const __m128 v = load();
+            const __m128 l2 = _mm_set1_ps(length2());
+            const __m128 r = _mm_rsqrt_ps(l2);
+
+            // r' = r * (1.5 - 0.5 * l2 * r * r)
+            const __m128 refined = _mm_mul_ps(r, _mm_sub_ps(
+                _mm_set1_ps(1.5f),
+                _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), l2), _mm_mul_ps(r, r))
+            ));
+            return vec3(_mm_mul_ps(v, refined));
+        }
+
+        /// Component-wise minimum
+        vec3 min(const vec3 &v) const {
+            return vec3(_mm_min_ps(load(), v.load()));
+        }
+
+        /// Component-wise maximum
+        vec3 max(const vec3 &v) const {
+            return vec3(_mm_max_ps(load(), v.load()));
+        }
+
+        /// Component by axis index (0 - x, 1 - y, 2 - z)
+        float operator[](std::size_t axis) const {
+            return axis == 0 ? x : axis == 1 ? y : z;
+        }
+
+    private:
+
+        /// Construct from register
+        explicit vec3(__m128 v) {
+            _mm_store_ps(&x, v);
+        }
+
+        /// Load into register
+        __m128 load() const {
+            return _mm_load_ps(&x);
+        }
+
+        /// Mask of XYZ lanes
+        static __m128 xyz_mask() {
+            return _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+        }
+
+        /// Sum of XYZ lanes
+        static float horizontal_sum(__m128 v) {
+            const __m128 y = _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1));
+            const __m128 z = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2));
+            return _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(v, y), z));
+        }
     };
+#endif
+
+    /// Build orthonormal basis around unit vector `n` (Duff et al.)
+    template <typename type>
+    void make_basis(const vec3<type> &n, vec3<type> &tangent, vec3<type> &bitangent) {
+        const type sign = std::copysign(type(1), n.z);
+        const type a = type(-1) / (sign + n.z);
+        const type b = n.x * n.y * a;
+        tangent = vec3<type>(type(1) + sign * n.x * n.x * a, sign * b, -sign * n.x);
+        bitangent = vec3<type>(b, sign + n.y * n.y * a, -n.y);
+    }
 }
 
 #endif // !defined(RT_MATH_HPP_)
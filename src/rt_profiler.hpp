@@ -0,0 +1,253 @@
+//! Scoped-zone profiler implementation file
+
+#ifndef RT_PROFILER_HPP_
+#define RT_PROFILER_HPP_
+
+#include <fstream>
+#include <string>
+
+#include "rt_common.hpp"
+
+/// Profiler (zones are compiled only if RT_PROFILE is defined)
+namespace rt::profiler {
+    /// Profiling flag
+    constexpr bool IS_ENABLED =
+        #ifdef RT_PROFILE
+            true
+        #else
+            false
+        #endif
+        ;
+
+    /// Completed zone
+    struct zone_event {
+        /// Zone name (string literal)
+        const char *name = nullptr;
+
+        /// Zone begin time (nanoseconds since profiler epoch)
+        std::uint64_t begin = 0;
+
+        /// Zone end time
+        std::uint64_t end = 0;
+    };
+
+    /// Per-thread zone ring, written only by its owner thread (oldest events are overwritten).
+    /// Every slot is guarded by its own sequence number, so readers skip slots that are being overwritten.
+    class thread_buffer {
+    public:
+
+        /// Count of events kept per thread
+        constexpr static std::size_t CAPACITY = 1 << 16;
+
+        /// Construct buffer of thread with index `thread_index`
+        thread_buffer(std::uint32_t thread_index):
+            thread_index(thread_index),
+            slots(std::make_unique<slot[]>(CAPACITY))
+        {
+        }
+
+        /// Add event (owner thread only, wait-free)
+        void push(const zone_event &event) noexcept {
+            const std::uint64_t index = head.load(std::memory_order_relaxed);
+            slot &s = slots[index % CAPACITY];
+
+            // Odd sequence marks slot being written, even one is `2 * (index + 1)` of the event it holds
+            s.sequence.store(2 * index + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            s.name.store(event.name, std::memory_order_relaxed);
+            s.begin.store(event.begin, std::memory_order_relaxed);
+            s.end.store(event.end, std::memory_order_relaxed);
+            s.sequence.store(2 * index + 2, std::memory_order_release);
+
+            head.store(index + 1, std::memory_order_release);
+        }
+
+        /// Copy events to `destination` (any thread), events overwritten during copy are skipped
+        void collect(std::vector<zone_event> &destination) const {
+            const std::uint64_t end = head.load(std::memory_order_acquire);
+            const std::uint64_t begin = end > CAPACITY ? end - CAPACITY : 0;
+
+            for (std::uint64_t index = begin; index < end; index++) {
+                const slot &s = slots[index % CAPACITY];
+                const std::uint64_t sequence = s.sequence.load(std::memory_order_acquire);
+                if (sequence != 2 * index + 2)
+                    continue;
+
+                const zone_event event {
+                    .name = s.name.load(std::memory_order_relaxed),
+                    .begin = s.begin.load(std::memory_order_relaxed),
+                    .end = s.end.load(std::memory_order_relaxed),
+                };
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (s.sequence.load(std::memory_order_relaxed) == sequence)
+                    destination.push_back(event);
+            }
+        }
+
+        /// Profiler thread index
+        const std::uint32_t thread_index;
+
+    private:
+
+        /// Event slot (fields are atomic, so reading slot while it's overwritten is not a data race)
+        struct slot {
+            /// Slot sequence number
+            std::atomic_uint64_t sequence = 0;
+
+            /// Zone name
+            std::atomic<const char *> name = nullptr;
+
+            /// Zone begin time
+            std::atomic_uint64_t begin = 0;
+
+            /// Zone end time
+            std::atomic_uint64_t end = 0;
+        };
+
+        /// Count of pushed events
+        std::atomic_uint64_t head = 0;
+
+        /// Event ring
+        std::unique_ptr<slot[]> slots;
+    };
+
+    /// Registry of thread buffers (buffers outlive their threads, so exited threads still appear in dumps)
+    class registry {
+    public:
+
+        /// Get global registry
+        static registry & get() {
+            static registry instance;
+            return instance;
+        }
+
+        /// Get buffer of the calling thread
+        thread_buffer & get_thread_buffer() {
+            thread_local thread_buffer *buffer = nullptr;
+
+            if (buffer == nullptr) {
+                std::lock_guard guard {lock};
+                buffers.push_back(std::make_shared<thread_buffer>((std::uint32_t)buffers.size()));
+                buffer = buffers.back().get();
+            }
+            return *buffer;
+        }
+
+        /// Get nanoseconds since profiler epoch
+        std::uint64_t now() const noexcept {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+        }
+
+        /// Write all collected zones in Chrome trace event format (readable by chrome://tracing and Perfetto)
+        bool write_chrome_trace(const std::string &path) {
+            std::vector<std::shared_ptr<thread_buffer>> snapshot;
+            {
+                std::lock_guard guard {lock};
+                snapshot = buffers;
+            }
+
+            std::ofstream file {path};
+            if (!file)
+                return false;
+
+            file << "{\"traceEvents\":[";
+            bool is_first = true;
+            std::vector<zone_event> events;
+
+            for (const std::shared_ptr<thread_buffer> &buffer : snapshot) {
+                events.clear();
+                buffer->collect(events);
+
+                for (const zone_event &event : events) {
+                    file
+                        << (is_first ? "\n" : ",\n")
+                        << "{\"name\":\"" << event.name
+                        << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread_index
+                        << ",\"ts\":" << event.begin / 1000 << '.' << event.begin % 1000 / 100
+                        << ",\"dur\":" << (event.end - event.begin) / 1000 << '.' << (event.end - event.begin) % 1000 / 100
+                        << '}';
+                    is_first = false;
+                }
+            }
+
+            file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+            return (bool)file.flush();
+        }
+
+    private:
+
+        /// Registry constructor
+        registry():
+            epoch(std::chrono::steady_clock::now())
+        {
+        }
+
+        /// Time origin
+        std::chrono::steady_clock::time_point epoch;
+
+        /// Buffer list lock (taken only on thread registration and dump)
+        std::mutex lock;
+
+        /// Thread buffers
+        std::vector<std::shared_ptr<thread_buffer>> buffers {};
+    };
+
+    /// Zone that lasts until the end of scope
+    class scoped_zone {
+    public:
+
+        /// Begin zone (`name` must be string literal)
+        scoped_zone(const char *name) noexcept:
+            name(name),
+            begin(registry::get().now())
+        {
+        }
+
+        /// Zone is not copyable
+        scoped_zone(const scoped_zone &) = delete;
+        scoped_zone & operator=(const scoped_zone &) = delete;
+
+        /// End zone
+        ~scoped_zone() {
+            registry &profiler_registry = registry::get();
+            const std::uint64_t end = profiler_registry.now();
+
+            profiler_registry.get_thread_buffer().push(zone_event {
+                .name = name,
+                .begin = begin,
+                .end = end,
+            });
+        }
+
+    private:
+
+        /// Zone name
+        const char *name;
+
+        /// Zone begin time
+        std::uint64_t begin;
+    };
+
+    /// Write collected zones in Chrome trace format (returns false if profiling is disabled or file can't be written)
+    inline bool write_chrome_trace(const std::string &path) {
+        if constexpr (IS_ENABLED)
+            return registry::get().write_chrome_trace(path);
+        else
+            return false;
+    }
+}
+
+#define RT_PROFILE_CONCAT_IMPL(a, b) a##b
+#define RT_PROFILE_CONCAT(a, b) RT_PROFILE_CONCAT_IMPL(a, b)
+
+#ifdef RT_PROFILE
+/// Profile current scope as zone `name`
+#define RT_PROFILE_ZONE(name) ::rt::profiler::scoped_zone RT_PROFILE_CONCAT(rt_profile_zone_, __LINE__) {name}
+#else
+/// Profile current scope as zone `name` (disabled)
+#define RT_PROFILE_ZONE(name) ((void)0)
+#endif
+
+#endif // !defined(RT_PROFILER_HPP_)
+
+// rt_profiler.hpp
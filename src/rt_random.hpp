@@ -59,11 +59,21 @@ namespace rt::random {
             return result;
         }
 
+        /// Generate uniform float in [0, 1)
+        float next_float() noexcept {
+            return (float)(next() >> 40) * 0x1.0p-24f;
+        }
+
     private:
 
         /// Current generator state
         std::uint64_t s0, s1, s2, s3;
     };
+
+    /// Combine seed with value (e.g. coordinate or index), so every combination gets independent stream
+    inline std::uint64_t mix_seed(std::uint64_t seed, std::uint64_t value) noexcept {
+        return splitmix64(seed ^ value * 0xD1B54A32D192ED03).next();
+    }
 }
 
 #endif // RT_RANDOM_HPP_
@@ -0,0 +1,148 @@
+//! Asynchronous render request handle implementation file
+
+#ifndef RT_RENDER_TASK_HPP_
+#define RT_RENDER_TASK_HPP_
+
+#include <coroutine>
+
+#include "rt_image.hpp"
+
+namespace rt {
+    /// Shared state of asynchronous render request
+    class render_task_state {
+    public:
+
+        /// Complete request (only the first completion has effect), resumes awaiting coroutines
+        void complete(std::optional<image> frame) {
+            std::vector<std::coroutine_handle<>> resumed;
+            {
+                std::lock_guard guard {lock};
+                if (is_done)
+                    return;
+                is_done = true;
+                result = std::move(frame);
+                resumed.swap(waiters);
+            }
+            completed.notify_all();
+
+            for (std::coroutine_handle<> waiter : resumed)
+                waiter.resume();
+        }
+
+        /// Request cancellation, request is completed without result
+        void cancel() {
+            is_cancelled.store(true, std::memory_order_relaxed);
+            complete(std::nullopt);
+        }
+
+        /// Check if request is cancelled
+        bool get_is_cancelled() const noexcept {
+            return is_cancelled.load(std::memory_order_relaxed);
+        }
+
+        /// Check if request is completed
+        bool get_is_done() {
+            std::lock_guard guard {lock};
+            return is_done;
+        }
+
+        /// Wait for completion
+        void wait() {
+            std::unique_lock guard {lock};
+            completed.wait(guard, [this]() { return is_done; });
+        }
+
+        /// Get result (request must be completed)
+        std::optional<image> get_result() {
+            std::lock_guard guard {lock};
+            return result;
+        }
+
+        /// Register coroutine to resume on completion, returns false if request is already completed
+        bool add_waiter(std::coroutine_handle<> waiter) {
+            std::lock_guard guard {lock};
+            if (is_done)
+                return false;
+            waiters.push_back(waiter);
+            return true;
+        }
+
+    private:
+
+        /// State lock
+        std::mutex lock;
+
+        /// Completion notification
+        std::condition_variable completed;
+
+        /// True if request is completed (or cancelled)
+        bool is_done = false;
+
+        /// Cancellation flag (checked by workers without lock)
+        std::atomic_bool is_cancelled = false;
+
+        /// Rendered frame (empty if request is cancelled)
+        std::optional<image> result = std::nullopt;
+
+        /// Coroutines awaiting completion
+        std::vector<std::coroutine_handle<>> waiters {};
+    };
+
+    /// Handle of asynchronous render request.
+    /// May be waited for synchronously or `co_await`-ed; awaiting coroutine is resumed on the worker thread
+    /// that completed the request. Result is empty if request was cancelled.
+    class render_task {
+    public:
+
+        /// Construct handle of the request state
+        render_task(std::shared_ptr<render_task_state> state):
+            state(std::move(state))
+        {
+        }
+
+        /// Check if request is completed
+        bool is_ready() const {
+            return state->get_is_done();
+        }
+
+        /// Wait for request completion
+        void wait() const {
+            state->wait();
+        }
+
+        /// Wait for request completion and get its result
+        std::optional<image> get() const {
+            state->wait();
+            return state->get_result();
+        }
+
+        /// Cancel request, threads rendering it are returned to other jobs after their current row
+        void cancel() const {
+            state->cancel();
+        }
+
+        /// Awaiter interface
+        bool await_ready() const {
+            return is_ready();
+        }
+
+        /// Awaiter interface
+        bool await_suspend(std::coroutine_handle<> waiter) const {
+            return state->add_waiter(waiter);
+        }
+
+        /// Awaiter interface
+        std::optional<image> await_resume() const {
+            return state->get_result();
+        }
+
+    private:
+
+        /// Request state
+        std::shared_ptr<render_task_state> state;
+    };
+}
+
+#endif // !defined(RT_RENDER_TASK_HPP_)
+
+// rt_render_task.hpp
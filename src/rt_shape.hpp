@@ -7,6 +7,8 @@
 #include "rt_shape_sphere.hpp"
 #include "rt_shape_plane.hpp"
 #include "rt_shape_scene.hpp"
+#include "rt_shape_streamed_mesh.hpp"
+#include "rt_shape_sdf.hpp"
 
 #endif // !defined(RT_SHAPE_HPP_)
 
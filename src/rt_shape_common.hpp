@@ -5,10 +5,9 @@
 
 #include "rt_common.hpp"
 #include "rt_math.hpp"
+#include "rt_texture.hpp"
 
 namespace rt {
-    /// Common vec3 definition
-    using vec3 = math::vec3<float>;
 
     /// Ray class
     class ray {
@@ -26,17 +25,152 @@ namespace rt {
         }
     };
 
+    /// Axis-aligned bounding box
+    class aabb {
+    public:
+
+        /// Construct box that contains nothing
+        static aabb empty() {
+            return aabb {
+                .min = vec3(std::numeric_limits<float>::infinity()),
+                .max = vec3(-std::numeric_limits<float>::infinity()),
+            };
+        }
+
+        /// Construct box that contains everything (used by unbounded shapes, e.g. planes)
+        static aabb infinite() {
+            return aabb {
+                .min = vec3(-std::numeric_limits<float>::infinity()),
+                .max = vec3(std::numeric_limits<float>::infinity()),
+            };
+        }
+
+        /// Minimal corner
+        vec3 min;
+
+        /// Maximal corner
+        vec3 max;
+
+        /// Check if box contains nothing
+        bool is_empty() const {
+            return min.x > max.x || min.y > max.y || min.z > max.z;
+        }
+
+        /// Check if box is non-empty and has finite size
+        bool is_finite() const {
+            return !is_empty()
+                && std::isfinite(min.x) && std::isfinite(min.y) && std::isfinite(min.z)
+                && std::isfinite(max.x) && std::isfinite(max.y) && std::isfinite(max.z);
+        }
+
+        /// Extend box to contain another one
+        aabb & extend(const aabb &other) {
+            min = min.min(other.min);
+            max = max.max(other.max);
+            return *this;
+        }
+
+        /// Extend box to contain point
+        aabb & extend(vec3 point) {
+            min = min.min(point);
+            max = max.max(point);
+            return *this;
+        }
+
+        /// Box center
+        vec3 center() const {
+            return (min + max) * vec3(0.5f);
+        }
+
+        /// Box surface area (zero for empty boxes)
+        float surface_area() const {
+            if (is_empty())
+                return 0.0f;
+            vec3 size = max - min;
+            return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+        }
+
+        /// Slab test, writes distance to box entry point in `entry` (`inv_direction` is 1 / r.direction)
+        bool intersect(const ray &r, vec3 inv_direction, float max_distance, float &entry) const {
+            vec3 t0 = (min - r.origin) * inv_direction;
+            vec3 t1 = (max - r.origin) * inv_direction;
+
+            vec3 t_near = t0.min(t1);
+            vec3 t_far = t0.max(t1);
+
+            float near = std::max(std::max(t_near.x, t_near.y), std::max(t_near.z, 0.0f));
+            float far = std::min(std::min(t_far.x, t_far.y), std::min(t_far.z, max_distance));
+
+            entry = near;
+            return near <= far;
+        }
+    };
+
+    /// Content hash builder (FNV-1a), used to check that saved data matches the scene
+    class hasher {
+    public:
+
+        /// Add raw bytes
+        hasher & add(const void *data, std::size_t size) noexcept {
+            const std::uint8_t *bytes = static_cast<const std::uint8_t *>(data);
+            for (std::size_t i = 0; i < size; i++)
+                value = (value ^ bytes[i]) * 0x100000001B3ull;
+            return *this;
+        }
+
+        /// Add integer
+        hasher & add(std::uint64_t v) noexcept {
+            return add(&v, sizeof(v));
+        }
+
+        /// Add float
+        hasher & add(float v) noexcept {
+            return add(&v, sizeof(v));
+        }
+
+        /// Add vector components (padding is not hashed)
+        hasher & add(vec3 v) noexcept {
+            return add(v.x).add(v.y).add(v.z);
+        }
+
+        /// Get hash
+        std::uint64_t get() const noexcept {
+            return value;
+        }
+
+    private:
+
+        /// Current hash value
+        std::uint64_t value = 0xCBF29CE484222325ull;
+    };
+
     /// Material class
     class material {
     public:
 
         /// Construct material
-        material(vec3 color): color(color) {
+        material(vec3 color, std::shared_ptr<const texture> color_texture = nullptr):
+            color(color),
+            color_texture(std::move(color_texture))
+        {
+
+        }
 
+        /// Get color at texture coordinates, `footprint` is size of shaded area in texture coordinates
+        vec3 get_color(float u, float v, float footprint) const {
+            return color_texture == nullptr ? color : color * color_texture->sample(u, v, footprint);
         }
 
-        // Material base color (yeah...)
+        /// Get hash of material parameters
+        std::uint64_t get_hash() const {
+            return hasher {}.add(color).add(color_texture == nullptr ? 0 : color_texture->get_hash()).get();
+        }
+
+        // Material base color (yeah...), multiplied by texture if there is one
         vec3 color;
+
+        /// Color texture (may be null)
+        std::shared_ptr<const texture> color_texture;
     };
 
     /// Intersection descriptor
@@ -51,6 +185,15 @@ namespace rt {
         /// Distance from ray origin to intersection point
         float distance = INF_DISTANCE;
 
+        /// Horizontal texture coordinate
+        float u = 0.0f;
+
+        /// Vertical texture coordinate
+        float v = 0.0f;
+
+        /// Texture coordinate change per unit of surface distance (used to choose texture level)
+        float uv_density = 0.0f;
+
         /// Object material pointer
         std::shared_ptr<material> hit_material = nullptr;
     };
@@ -58,16 +201,39 @@ namespace rt {
     // Shape namespace
     namespace shape {
 
+        /// Per-thread ray query state, used by shapes whose data may be not resident in memory
+        class query_context {
+        public:
+
+            /// Get context of the calling thread
+            static query_context & get() noexcept {
+                thread_local query_context context;
+                return context;
+            }
+
+            /// Count of queries that skipped non-resident data (their results are incomplete and must be retried)
+            std::uint32_t deferred_count = 0;
+
+            /// Wait for non-resident data instead of skipping it
+            bool is_blocking = false;
+        };
+
         /// Shape interface
         class shape {
         public:
 
-            /// Check shape-ray intersection
-            virtual bool check_intersection(ray r) const = 0;
+            /// Check shape-ray intersection closer than `max_distance`
+            virtual bool check_intersection(ray r, float max_distance = intersection::INF_DISTANCE) const = 0;
 
             /// Check shape-ray intersection, writing description in `intr` structure
             virtual bool intersect(ray r, intersection &intr) const = 0;
 
+            /// Get shape bounding box (`aabb::infinite()` for unbounded shapes)
+            virtual aabb get_bounds() const = 0;
+
+            /// Get hash of shape contents (geometry and materials)
+            virtual std::uint64_t get_hash() const = 0;
+
             /// Shape destructor
             virtual ~shape() = default;
         };
@@ -10,18 +10,20 @@ namespace rt::shape {
     class plane : public shape {
     public:
 
-        /// Plane constructor
-        plane(vec3 point, vec3 normal, std::shared_ptr<material> mtl):
+        /// Plane constructor, texture repeats `texture_scale` times per unit of length
+        plane(vec3 point, vec3 normal, std::shared_ptr<material> mtl, float texture_scale = 1.0f):
             normal(normal),
             normal_origin(normal.dot(point)),
+            texture_scale(texture_scale),
             mtl(std::move(mtl))
         {
-
+            math::make_basis(normal, tangent, bitangent);
         }
 
-        /// Check shape-ray intersection
-        virtual bool check_intersection(ray r) const override {
-            return (normal_origin - normal.dot(r.origin)) / normal.dot(r.direction) > 0.0f;
+        /// Check shape-ray intersection closer than `max_distance`
+        virtual bool check_intersection(ray r, float max_distance = intersection::INF_DISTANCE) const override {
+            float dist = (normal_origin - normal.dot(r.origin)) / normal.dot(r.direction);
+            return dist > 0.0f && dist < max_distance;
         }
 
         /// Check shape-ray intersection, writing description in `intr` structure
@@ -30,12 +32,26 @@ namespace rt::shape {
             if (dist < 0.0f)
                 return false;
 
+            const vec3 point = r.at(dist);
             intr.distance = dist;
             intr.normal = normal;
+            intr.u = point.dot(tangent) * texture_scale;
+            intr.v = point.dot(bitangent) * texture_scale;
+            intr.uv_density = texture_scale;
             intr.hit_material = mtl;
             return true;
         }
 
+        /// Get hash of shape contents
+        virtual std::uint64_t get_hash() const override {
+            return hasher {}.add(normal).add(normal_origin).add(texture_scale).add(mtl->get_hash()).get();
+        }
+
+        /// Get shape bounding box
+        virtual aabb get_bounds() const override {
+            return aabb::infinite();
+        }
+
     private:
         /// Normal vector
         vec3 normal;
@@ -43,6 +59,15 @@ namespace rt::shape {
         /// Dot product of normal and plane origin point
         float normal_origin;
 
+        /// Texture repeat count per unit of length
+        float texture_scale;
+
+        /// Texture U axis
+        vec3 tangent;
+
+        /// Texture V axis
+        vec3 bitangent;
+
         /// Plane material
         std::shared_ptr<material> mtl;
     };
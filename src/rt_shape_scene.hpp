@@ -3,43 +3,167 @@
 #ifndef RT_SHAPE_SCENE_HPP_
 #define RT_SHAPE_SCENE_HPP_
 
-#include "rt_shape_common.hpp"
+#include "rt_light.hpp"
 
 namespace rt::shape {
     /// Scene shape
     class scene : public shape {
     public:
+        /// Scene object identifier (stays valid until object removal)
+        using object_id = std::uint32_t;
+
+        /// Object identifier of missed rays
+        constexpr static object_id NO_OBJECT = ~0u;
+
+        /// Count of rays in packet queries
+        constexpr static std::size_t PACKET_SIZE = bvh::PACKET_SIZE;
+
+        /// Hierarchy is rebuilt when its cost exceeds cost at build time this many times
+        constexpr static float REBUILD_COST_RATIO = 1.5f;
+
         /// Scene constructor
         scene() {
 
         }
 
         /// Add new shape to the scene
-        void add_shape(std::unique_ptr<shape> new_shape) {
-            shapes.emplace_back(std::move(new_shape));
+        object_id add_shape(std::shared_ptr<const shape> new_shape) {
+            object_id id;
+            if (free_ids.empty()) {
+                id = objects.size();
+                objects.emplace_back();
+            } else {
+                id = free_ids.back();
+                free_ids.pop_back();
+            }
+
+            set_object_shape(id, std::move(new_shape));
+            return id;
         }
 
         /// `add_shape` method wrapped in nice operator
-        scene & operator<<(std::unique_ptr<shape> new_shape) {
+        scene & operator<<(std::shared_ptr<const shape> new_shape) {
             add_shape(std::move(new_shape));
             return *this;
         }
 
-        /// Check shape-ray intersection
-        virtual bool check_intersection(ray r) const override {
-            for (auto &shape : shapes)
-                if (shape->check_intersection(r))
+        /// Replace shape of existing object (e.g. to move it)
+        bool replace_shape(object_id id, std::shared_ptr<const shape> new_shape) {
+            if (get_shape(id) == nullptr)
+                return false;
+            set_object_shape(id, std::move(new_shape));
+            return true;
+        }
+
+        /// Remove object from the scene
+        bool remove_shape(object_id id) {
+            if (get_shape(id) == nullptr)
+                return false;
+            set_object_shape(id, nullptr);
+            free_ids.push_back(id);
+            return true;
+        }
+
+        /// Get object shape (nullptr if there is no such object)
+        const shape * get_shape(object_id id) const {
+            return id < objects.size() ? objects[id].value.get() : nullptr;
+        }
+
+        /// Add light to the scene (light is used for shading after the next commit)
+        std::uint32_t add_light(const light &new_light) {
+            lights.push_back(new_light);
+            is_light_tree_dirty = true;
+            return lights.size() - 1;
+        }
+
+        /// Remove all lights from the scene
+        void clear_lights() {
+            lights.clear();
+            is_light_tree_dirty = true;
+        }
+
+        /// Get scene lights
+        std::span<const light> get_lights() const noexcept {
+            return lights;
+        }
+
+        /// Get geometry version, incremented by every object modification (light changes keep it).
+        /// Scene copy that still has version of the original has the same geometry, so rays hit the same.
+        std::uint64_t get_geometry_version() const noexcept {
+            return geometry_version;
+        }
+
+        /// Get light hierarchy (built on commit)
+        const light_tree & get_light_tree() const noexcept {
+            return light_hierarchy;
+        }
+
+        /// Update acceleration structures after scene modifications.
+        /// Hierarchy is refitted while it stays good enough and rebuilt incrementally otherwise.
+        void commit() {
+            if (is_light_tree_dirty) {
+                light_hierarchy.build(lights);
+                is_light_tree_dirty = false;
+            }
+
+            if (!is_hierarchy_dirty && pending_ids.empty())
+                return;
+
+            const std::size_t object_count = objects.size() - free_ids.size();
+            bool do_rebuild = pending_ids.size() > std::max<std::size_t>(8, object_count / 8);
+
+            if (!do_rebuild) {
+                hierarchy.refit(bounds);
+                do_rebuild = hierarchy.get_cost() > built_cost * REBUILD_COST_RATIO;
+            }
+
+            if (do_rebuild) {
+                hierarchy.build(bounds);
+                built_cost = hierarchy.get_cost();
+
+                for (std::size_t id = 0; id < objects.size(); id++)
+                    objects[id].is_indexed = !bounds[id].is_empty();
+                pending_ids.clear();
+            }
+
+            is_hierarchy_dirty = false;
+        }
+
+        /// Check shape-ray intersection closer than `max_distance`
+        virtual bool check_intersection(ray r, float max_distance = intersection::INF_DISTANCE) const override {
+            for (object_id id : unbounded_ids)
+                if (objects[id].value->check_intersection(r, max_distance))
+                    return true;
+            for (object_id id : pending_ids)
+                if (objects[id].value->check_intersection(r, max_distance))
                     return true;
-            return false;
+
+            return hierarchy.traverse(r, max_distance, [&](std::uint32_t id, float &) {
+                const shape *object = objects[id].value.get();
+                return object != nullptr && object->check_intersection(r, max_distance);
+            });
         }
 
         /// Check shape-ray intersection writing intersection info in `intr`
         virtual bool intersect(ray r, intersection &intr) const override {
             intersection best {};
 
-            for (auto &shape : shapes)
-                if (shape->intersect(r, intr) && intr.distance <= best.distance)
+            auto test = [&](object_id id) {
+                const shape *object = objects[id].value.get();
+                if (object != nullptr && object->intersect(r, intr) && intr.distance <= best.distance)
                     best = intr;
+            };
+
+            for (object_id id : unbounded_ids)
+                test(id);
+            for (object_id id : pending_ids)
+                test(id);
+
+            hierarchy.traverse(r, best.distance, [&](std::uint32_t id, float &max_distance) {
+                test(id);
+                max_distance = best.distance;
+                return false;
+            });
 
             if (best.distance == intersection::INF_DISTANCE)
                 return false;
@@ -48,9 +172,169 @@ namespace rt::shape {
             return true;
         }
 
+        /// Intersect packet of up to `PACKET_SIZE` rays (coherent rays share hierarchy traversal).
+        /// `intrs[i]` and `ids[i]` get hit of `rays[i]` and its object, `ids[i]` is `NO_OBJECT` if ray missed.
+        void intersect_packet(std::span<const ray> rays, std::span<intersection> intrs, std::span<object_id> ids) const {
+            intersection candidate;
+            float max_distances[PACKET_SIZE];
+
+            auto test = [&](std::size_t lane, object_id id) {
+                const shape *object = objects[id].value.get();
+                if (object != nullptr && object->intersect(rays[lane], candidate) && candidate.distance <= max_distances[lane]) {
+                    intrs[lane] = candidate;
+                    ids[lane] = id;
+                    max_distances[lane] = candidate.distance;
+                }
+            };
+
+            for (std::size_t lane = 0; lane < rays.size(); lane++) {
+                ids[lane] = NO_OBJECT;
+                max_distances[lane] = intersection::INF_DISTANCE;
+                for (object_id id : unbounded_ids)
+                    test(lane, id);
+                for (object_id id : pending_ids)
+                    test(lane, id);
+            }
+
+            hierarchy.traverse_packet(rays, std::span(max_distances, rays.size()), [&](std::size_t lane, std::uint32_t id, float &max_distance) {
+                max_distances[lane] = max_distance;
+                test(lane, id);
+                max_distance = max_distances[lane];
+                return false;
+            });
+        }
+
+        /// Check occlusion of packet of up to `PACKET_SIZE` rays: `occluded[i]` is set if `rays[i]` hits something closer than `max_distances[i]`
+        void check_intersection_packet(std::span<const ray> rays, std::span<const float> max_distances, std::span<bool> occluded) const {
+            float distances[PACKET_SIZE];
+            std::uint32_t unresolved = 0;
+
+            for (std::size_t lane = 0; lane < rays.size(); lane++) {
+                distances[lane] = max_distances[lane];
+                occluded[lane] = false;
+                for (object_id id : unbounded_ids)
+                    occluded[lane] = occluded[lane] || objects[id].value->check_intersection(rays[lane], max_distances[lane]);
+                for (object_id id : pending_ids)
+                    occluded[lane] = occluded[lane] || objects[id].value->check_intersection(rays[lane], max_distances[lane]);
+
+                // Occluded rays are excluded from traversal
+                if (occluded[lane])
+                    distances[lane] = -1.0f;
+                else
+                    unresolved++;
+            }
+            if (unresolved == 0)
+                return;
+
+            hierarchy.traverse_packet(rays, std::span(distances, rays.size()), [&](std::size_t lane, std::uint32_t id, float &) {
+                const shape *object = objects[id].value.get();
+                occluded[lane] = object != nullptr && object->check_intersection(rays[lane], max_distances[lane]);
+                return occluded[lane];
+            });
+        }
+
+        /// Get hash of scene contents (objects and lights)
+        virtual std::uint64_t get_hash() const override {
+            hasher h;
+            for (std::size_t id = 0; id < objects.size(); id++)
+                if (objects[id].value != nullptr)
+                    h.add((std::uint64_t)id).add(objects[id].value->get_hash());
+
+            for (const light &l : lights)
+                h
+                    .add((std::uint64_t)l.type)
+                    .add(l.position)
+                    .add(l.direction)
+                    .add(l.intensity)
+                    .add(l.radius)
+                    .add(l.cos_inner)
+                    .add(l.cos_outer);
+            return h.get();
+        }
+
+        /// Get shape bounding box
+        virtual aabb get_bounds() const override {
+            if (!unbounded_ids.empty())
+                return aabb::infinite();
+
+            aabb box = aabb::empty();
+            for (const auto &object : objects)
+                if (object.value != nullptr)
+                    box.extend(object.value->get_bounds());
+            return box;
+        }
+
     private:
-        /// Set of scene shapes
-        std::vector<std::unique_ptr<shape>> shapes {};
+
+        /// Scene object
+        struct object {
+            /// Object shape (nullptr for removed objects)
+            std::shared_ptr<const shape> value = nullptr;
+
+            /// True if object is referenced by acceleration structure leaves
+            bool is_indexed = false;
+        };
+
+        /// Set object shape, keeping acceleration structure bookkeeping consistent
+        void set_object_shape(object_id id, std::shared_ptr<const shape> new_shape) {
+            std::erase(unbounded_ids, id);
+            std::erase(pending_ids, id);
+
+            aabb box = new_shape == nullptr ? aabb::empty() : new_shape->get_bounds();
+            if (!box.is_empty() && !box.is_finite()) {
+                unbounded_ids.push_back(id);
+                box = aabb::empty();
+            }
+
+            if (bounds.size() <= id)
+                bounds.resize(id + 1, aabb::empty());
+            bounds[id] = box;
+
+            // Indexed objects are handled by refit, new ones are tested linearly until rebuild
+            if (objects[id].is_indexed)
+                is_hierarchy_dirty = true;
+            else if (!box.is_empty())
+                pending_ids.push_back(id);
+
+            objects[id].value = std::move(new_shape);
+            geometry_version++;
+        }
+
+        /// Set of scene objects (indexed by identifier)
+        std::vector<object> objects {};
+
+        /// Bounding boxes of objects, empty for removed and unbounded ones
+        std::vector<aabb> bounds {};
+
+        /// Identifiers of removed objects
+        std::vector<object_id> free_ids {};
+
+        /// Objects with infinite bounds (always tested)
+        std::vector<object_id> unbounded_ids {};
+
+        /// Bounded objects added since last hierarchy rebuild
+        std::vector<object_id> pending_ids {};
+
+        /// Scene acceleration structure
+        bvh hierarchy {};
+
+        /// Hierarchy cost right after the last rebuild
+        float built_cost = 0.0f;
+
+        /// True if bounds of indexed objects changed since last commit
+        bool is_hierarchy_dirty = false;
+
+        /// Count of object modifications
+        std::uint64_t geometry_version = 0;
+
+        /// Scene lights
+        std::vector<light> lights {};
+
+        /// Light sampling hierarchy
+        light_tree light_hierarchy {};
+
+        /// True if lights changed since last commit
+        bool is_light_tree_dirty = false;
     };
 }
 
@@ -0,0 +1,315 @@
+//! Signed distance field shape implementation file
+
+#ifndef RT_SHAPE_SDF_HPP_
+#define RT_SHAPE_SDF_HPP_
+
+#include <array>
+
+#include "rt_shape_common.hpp"
+
+// Shape namespace
+namespace rt::shape {
+    /// Implicit surface given by signed distance function (negative inside), baked into sparse brick grid.
+    /// Only bricks the surface may pass through keep distance samples, so function is evaluated once at load
+    /// and rays are marched through trilinearly interpolated samples. Empty bricks and empty groups of bricks
+    /// are skipped as whole boxes, so marching cost depends on surface crossed, not on distance travelled.
+    class sdf : public shape {
+    public:
+
+        /// Count of voxels along brick side
+        constexpr static std::size_t BRICK_SIZE = 8;
+
+        /// Count of bricks along coarse (skipping) cell side
+        constexpr static std::size_t COARSE_SIZE = 4;
+
+        /// Bake `distance` function over `bounds` with samples `voxel_size` apart.
+        /// Function must be distance bound (it must not exceed distance to the surface), exact distance gives the best skipping.
+        sdf(const std::function<float(vec3)> &distance, aabb bounds, float voxel_size, std::shared_ptr<material> mtl):
+            grid_min(bounds.min),
+            voxel_size(voxel_size),
+            inv_voxel_size(1.0f / voxel_size),
+            brick_extent(voxel_size * BRICK_SIZE),
+            mtl(std::move(mtl))
+        {
+            const vec3 size = bounds.max - bounds.min;
+            for (std::size_t axis = 0; axis < 3; axis++) {
+                brick_counts[axis] = std::max<std::size_t>((std::size_t)std::ceil(size[axis] / brick_extent), 1);
+                coarse_counts[axis] = (brick_counts[axis] + COARSE_SIZE - 1) / COARSE_SIZE;
+            }
+            grid_max = grid_min + vec3(brick_extent) * vec3((float)brick_counts[0], (float)brick_counts[1], (float)brick_counts[2]);
+
+            brick_indices.assign(brick_counts[0] * brick_counts[1] * brick_counts[2], EMPTY_BRICK);
+            brick_distances.assign(brick_indices.size(), 0.0f);
+            coarse_occupancy.assign(coarse_counts[0] * coarse_counts[1] * coarse_counts[2], 0);
+
+            // Surface may cross brick only if center distance is below half diagonal, one voxel margin
+            // keeps interpolation and gradient samples near brick faces inside occupied bricks
+            const float occupancy_radius = brick_extent * std::sqrt(3.0f) * 0.5f + voxel_size;
+
+            for (std::size_t z = 0; z < brick_counts[2]; z++)
+                for (std::size_t y = 0; y < brick_counts[1]; y++)
+                    for (std::size_t x = 0; x < brick_counts[0]; x++) {
+                        const std::size_t brick = get_brick_index(x, y, z);
+                        const vec3 brick_min = grid_min + vec3(brick_extent) * vec3((float)x, (float)y, (float)z);
+                        const float center_distance = distance(brick_min + vec3(brick_extent * 0.5f));
+
+                        brick_distances[brick] = center_distance;
+                        if (std::abs(center_distance) > occupancy_radius)
+                            continue;
+
+                        brick_indices[brick] = (std::uint32_t)(samples.size() / BRICK_SAMPLE_COUNT);
+                        coarse_occupancy[get_coarse_index(x / COARSE_SIZE, y / COARSE_SIZE, z / COARSE_SIZE)] = 1;
+
+                        for (std::size_t k = 0; k <= BRICK_SIZE; k++)
+                            for (std::size_t j = 0; j <= BRICK_SIZE; j++)
+                                for (std::size_t i = 0; i <= BRICK_SIZE; i++)
+                                    samples.push_back(distance(brick_min + vec3(voxel_size) * vec3((float)i, (float)j, (float)k)));
+                    }
+        }
+
+        /// Check for (any) intersection closer than `max_distance`
+        virtual bool check_intersection(ray r, float max_distance = intersection::INF_DISTANCE) const override {
+            float distance;
+            return march(r, max_distance, distance);
+        }
+
+        /// 'Deep' intersection
+        virtual bool intersect(ray r, intersection &intr) const override {
+            float distance;
+            if (!march(r, intersection::INF_DISTANCE, distance))
+                return false;
+
+            // Normal is gradient of interpolated field
+            const vec3 point = r.at(distance);
+            const float h = voxel_size * 0.5f;
+            const vec3 gradient {
+                sample(point + vec3(h, 0.0f, 0.0f)) - sample(point - vec3(h, 0.0f, 0.0f)),
+                sample(point + vec3(0.0f, h, 0.0f)) - sample(point - vec3(0.0f, h, 0.0f)),
+                sample(point + vec3(0.0f, 0.0f, h)) - sample(point - vec3(0.0f, 0.0f, h)),
+            };
+
+            intr.distance = distance;
+            intr.normal = gradient.length2() > 0.0f ? gradient.normalized() : r.direction * vec3(-1.0f);
+            intr.hit_material = mtl;
+            return true;
+        }
+
+        /// Get hash of shape contents
+        virtual std::uint64_t get_hash() const override {
+            return hasher {}
+                .add(grid_min)
+                .add(voxel_size)
+                .add(brick_indices.data(), brick_indices.size() * sizeof(std::uint32_t))
+                .add(samples.data(), samples.size() * sizeof(float))
+                .add(mtl->get_hash())
+                .get();
+        }
+
+        /// Get shape bounding box
+        virtual aabb get_bounds() const override {
+            return aabb {
+                .min = grid_min,
+                .max = grid_max,
+            };
+        }
+
+        /// Get count of bricks with samples
+        std::size_t get_brick_count() const noexcept {
+            return samples.size() / BRICK_SAMPLE_COUNT;
+        }
+
+    private:
+
+        /// Index of brick without samples
+        constexpr static std::uint32_t EMPTY_BRICK = ~0u;
+
+        /// Count of samples stored per brick (brick faces are duplicated, so interpolation never reads neighbors)
+        constexpr static std::size_t BRICK_SAMPLE_COUNT = (BRICK_SIZE + 1) * (BRICK_SIZE + 1) * (BRICK_SIZE + 1);
+
+        /// Distance considered as surface hit (in voxels)
+        constexpr static float HIT_THRESHOLD = 0.02f;
+
+        /// Minimal march step (in voxels), bounds step count at grazing angles
+        constexpr static float MIN_STEP = 0.05f;
+
+        /// Get brick index in grid
+        std::size_t get_brick_index(std::size_t x, std::size_t y, std::size_t z) const noexcept {
+            return (z * brick_counts[1] + y) * brick_counts[0] + x;
+        }
+
+        /// Get coarse cell index
+        std::size_t get_coarse_index(std::size_t x, std::size_t y, std::size_t z) const noexcept {
+            return (z * coarse_counts[1] + y) * coarse_counts[0] + x;
+        }
+
+        /// Get brick coordinates of point (clamped to grid)
+        std::array<std::size_t, 3> get_brick_coordinates(vec3 point) const noexcept {
+            const vec3 local = (point - grid_min) * vec3(1.0f / brick_extent);
+            return {
+                (std::size_t)std::clamp(local.x, 0.0f, brick_counts[0] - 1.0f),
+                (std::size_t)std::clamp(local.y, 0.0f, brick_counts[1] - 1.0f),
+                (std::size_t)std::clamp(local.z, 0.0f, brick_counts[2] - 1.0f),
+            };
+        }
+
+        /// Trilinearly interpolated distance at point of brick
+        float sample_brick(std::uint32_t brick, const std::array<std::size_t, 3> &coordinates, vec3 point) const noexcept {
+            const float *data = samples.data() + (std::size_t)brick * BRICK_SAMPLE_COUNT;
+            const vec3 brick_min = grid_min + vec3(brick_extent) * vec3((float)coordinates[0], (float)coordinates[1], (float)coordinates[2]);
+            const vec3 local = (point - brick_min) * vec3(inv_voxel_size);
+
+            std::size_t index[3];
+            float t[3];
+            for (std::size_t axis = 0; axis < 3; axis++) {
+                const float position = std::clamp(local[axis], 0.0f, (float)BRICK_SIZE);
+                index[axis] = std::min((std::size_t)position, BRICK_SIZE - 1);
+                t[axis] = position - index[axis];
+            }
+
+            constexpr std::size_t SIDE = BRICK_SIZE + 1;
+            const float *c = data + (index[2] * SIDE + index[1]) * SIDE + index[0];
+            const float c00 = c[0] + (c[1] - c[0]) * t[0];
+            const float c10 = c[SIDE] + (c[SIDE + 1] - c[SIDE]) * t[0];
+            const float c01 = c[SIDE * SIDE] + (c[SIDE * SIDE + 1] - c[SIDE * SIDE]) * t[0];
+            const float c11 = c[SIDE * SIDE + SIDE] + (c[SIDE * SIDE + SIDE + 1] - c[SIDE * SIDE + SIDE]) * t[0];
+            const float c0 = c00 + (c10 - c00) * t[1];
+            const float c1 = c01 + (c11 - c01) * t[1];
+            return c0 + (c1 - c0) * t[2];
+        }
+
+        /// Distance at point (center distance is returned for empty bricks)
+        float sample(vec3 point) const noexcept {
+            const std::array<std::size_t, 3> coordinates = get_brick_coordinates(point);
+            const std::size_t brick = get_brick_index(coordinates[0], coordinates[1], coordinates[2]);
+            return brick_indices[brick] == EMPTY_BRICK
+                ? brick_distances[brick]
+                : sample_brick(brick_indices[brick], coordinates, point);
+        }
+
+        /// Distance along ray to exit of box
+        static float get_exit_distance(const ray &r, vec3 inv_direction, vec3 box_min, vec3 box_max) noexcept {
+            const vec3 t0 = (box_min - r.origin) * inv_direction;
+            const vec3 t1 = (box_max - r.origin) * inv_direction;
+            const vec3 t_far = t0.max(t1);
+            return std::min(std::min(t_far.x, t_far.y), t_far.z);
+        }
+
+        /// March ray through grid, writes distance to the first surface point closer than `max_distance`.
+        /// Bricks are visited by 3D DDA, empty coarse cells are left at once.
+        bool march(const ray &r, float max_distance, float &distance) const {
+            const vec3 inv_direction = vec3(1.0f) / r.direction;
+
+            float t;
+            if (!get_bounds().intersect(r, inv_direction, max_distance, t))
+                return false;
+            const float t_end = std::min(get_exit_distance(r, inv_direction, grid_min, grid_max), max_distance);
+
+            // Coarse cells are left with small nudge, so the next point is classified into the next cell
+            const float nudge = voxel_size * 1.0e-3f;
+            const float coarse_extent = brick_extent * COARSE_SIZE;
+
+            std::array<std::size_t, 3> coordinates = get_brick_coordinates(r.at(t));
+            for (;;) {
+                const std::size_t coarse[3] = {coordinates[0] / COARSE_SIZE, coordinates[1] / COARSE_SIZE, coordinates[2] / COARSE_SIZE};
+                if (coarse_occupancy[get_coarse_index(coarse[0], coarse[1], coarse[2])] == 0) {
+                    const vec3 coarse_min = grid_min + vec3(coarse_extent) * vec3((float)coarse[0], (float)coarse[1], (float)coarse[2]);
+                    t = std::max(get_exit_distance(r, inv_direction, coarse_min, coarse_min + vec3(coarse_extent)), t) + nudge;
+                    if (t >= t_end)
+                        return false;
+                    coordinates = get_brick_coordinates(r.at(t));
+                    continue;
+                }
+
+                // Distances to the next brick boundary along every axis
+                float t_next[3], t_delta[3];
+                for (std::size_t axis = 0; axis < 3; axis++) {
+                    if (r.direction[axis] == 0.0f) {
+                        t_next[axis] = t_delta[axis] = std::numeric_limits<float>::infinity();
+                        continue;
+                    }
+                    const float boundary = grid_min[axis] + brick_extent * (coordinates[axis] + (r.direction[axis] > 0.0f ? 1 : 0));
+                    t_next[axis] = (boundary - r.origin[axis]) * inv_direction[axis];
+                    t_delta[axis] = brick_extent * std::abs(inv_direction[axis]);
+                }
+
+                // Walk bricks of coarse cell
+                for (;;) {
+                    const float brick_exit = std::max(std::min(std::min(t_next[0], t_next[1]), t_next[2]), t);
+                    const std::uint32_t brick = brick_indices[get_brick_index(coordinates[0], coordinates[1], coordinates[2])];
+
+                    // Sphere trace inside occupied brick
+                    if (brick != EMPTY_BRICK) {
+                        const float march_end = std::min(brick_exit, t_end);
+                        while (t < march_end) {
+                            const float d = sample_brick(brick, coordinates, r.at(t));
+                            if (d < HIT_THRESHOLD * voxel_size) {
+                                distance = t;
+                                return true;
+                            }
+                            t += std::max(d, MIN_STEP * voxel_size);
+                        }
+                    }
+
+                    t = brick_exit;
+                    if (t >= t_end)
+                        return false;
+
+                    const std::size_t axis = t_next[0] < t_next[1]
+                        ? (t_next[0] < t_next[2] ? 0 : 2)
+                        : (t_next[1] < t_next[2] ? 1 : 2);
+                    if (r.direction[axis] > 0.0f) {
+                        if (++coordinates[axis] >= brick_counts[axis])
+                            return false;
+                    } else {
+                        if (coordinates[axis]-- == 0)
+                            return false;
+                    }
+                    t_next[axis] += t_delta[axis];
+
+                    if (coordinates[axis] / COARSE_SIZE != coarse[axis])
+                        break;
+                }
+            }
+        }
+
+        /// Grid minimal corner
+        vec3 grid_min;
+
+        /// Grid maximal corner
+        vec3 grid_max;
+
+        /// Distance between samples
+        float voxel_size;
+
+        /// Inverse distance between samples
+        float inv_voxel_size;
+
+        /// Brick side length
+        float brick_extent;
+
+        /// Count of bricks along axes
+        std::array<std::size_t, 3> brick_counts {};
+
+        /// Count of coarse cells along axes
+        std::array<std::size_t, 3> coarse_counts {};
+
+        /// Sample block index of every brick (EMPTY_BRICK for bricks without surface)
+        std::vector<std::uint32_t> brick_indices;
+
+        /// Distance at brick centers
+        std::vector<float> brick_distances;
+
+        /// Coarse cell flags, non-zero if any brick of cell is occupied
+        std::vector<std::uint8_t> coarse_occupancy;
+
+        /// Distance samples of occupied bricks
+        std::vector<float> samples;
+
+        /// Shape material
+        std::shared_ptr<material> mtl;
+    };
+}
+
+#endif // !defined(RT_SHAPE_SDF_HPP_)
+
+// rt_shape_sdf.hpp
@@ -3,6 +3,8 @@
 #ifndef RT_SHAPE_SPHERE_HPP_
 #define RT_SHAPE_SPHERE_HPP_
 
+#include <numbers>
+
 #include "rt_shape_common.hpp"
 
 // Shape namespace
@@ -21,13 +23,18 @@ namespace rt::shape {
 
         }
 
-        /// Check for (any) intersection
-        virtual bool check_intersection(ray r) const override {
+        /// Check for (any) intersection closer than `max_distance`
+        virtual bool check_intersection(ray r, float max_distance = intersection::INF_DISTANCE) const override {
             vec3 delta = center - r.origin;
             float proj = delta.dot(r.direction);
             float dist = radius2 - delta.length2() + proj * proj;
 
-            return dist > 0.0f && proj + std::sqrt(dist) > 0.0f;
+            if (dist <= 0.0f)
+                return false;
+            dist = std::sqrt(dist);
+
+            float distance = proj - dist > 0.0f ? proj - dist : proj + dist;
+            return distance > 0.0f && distance < max_distance;
         }
 
         /// 'Deep' intersection
@@ -48,11 +55,30 @@ namespace rt::shape {
                 return false;
 
             intr.normal = (r.at(intr.distance) - center) * vec3(inv_radius);
+
+            // Latitude-longitude mapping, V changes by 1 along half of great circle
+            intr.u = 0.5f + std::atan2(intr.normal.z, intr.normal.x) * (0.5f * std::numbers::inv_pi_v<float>);
+            intr.v = std::acos(std::clamp(intr.normal.y, -1.0f, 1.0f)) * std::numbers::inv_pi_v<float>;
+            intr.uv_density = inv_radius * std::numbers::inv_pi_v<float>;
             intr.hit_material = mtl;
 
             return true;
         }
 
+        /// Get hash of shape contents
+        virtual std::uint64_t get_hash() const override {
+            return hasher {}.add(center).add(radius2).add(mtl->get_hash()).get();
+        }
+
+        /// Get shape bounding box
+        virtual aabb get_bounds() const override {
+            vec3 extent {std::sqrt(radius2)};
+            return aabb {
+                .min = center - extent,
+                .max = center + extent,
+            };
+        }
+
     private:
 
         /// Sphere center
@@ -0,0 +1,703 @@
+//! Out-of-core triangle mesh shape implementation file
+
+#ifndef RT_SHAPE_STREAMED_MESH_HPP_
+#define RT_SHAPE_STREAMED_MESH_HPP_
+
+#include <deque>
+#include <fstream>
+#include <string>
+
+#include "rt_bvh.hpp"
+
+// Shape namespace
+namespace rt::shape {
+    /// Mesh triangle
+    struct mesh_triangle {
+        /// First vertex
+        vec3 v0;
+
+        /// Second vertex
+        vec3 v1;
+
+        /// Third vertex
+        vec3 v2;
+
+        /// Texture coordinates of first vertex (x and y components)
+        vec3 uv0 {};
+
+        /// Texture coordinates of second vertex
+        vec3 uv1 {};
+
+        /// Texture coordinates of third vertex
+        vec3 uv2 {};
+    };
+
+    /// Triangle mesh stored in file and paged in on demand.
+    /// File keeps mesh split into clusters (BVH subtrees with their own hierarchies), only the cluster
+    /// bounds stay resident. Clusters are loaded by background thread into cache of bounded size,
+    /// least recently used ones are evicted. Queries that need non-resident cluster don't wait for it
+    /// (unless `query_context::is_blocking` is set): cluster load is requested and query is reported as deferred.
+    class streamed_mesh : public shape {
+    public:
+
+        /// Maximal count of triangles in single cluster
+        constexpr static std::size_t CLUSTER_SIZE = 4096;
+
+        /// Split mesh into clusters and write it to file
+        static bool write(const std::string &path, std::span<const mesh_triangle> triangles) {
+            std::vector<aabb> triangle_bounds;
+            triangle_bounds.reserve(triangles.size());
+            for (const mesh_triangle &t : triangles)
+                triangle_bounds.push_back(aabb::empty().extend(t.v0).extend(t.v1).extend(t.v2));
+
+            // Clusters are subtrees of the whole mesh hierarchy, so they are spatially coherent
+            bvh mesh_hierarchy;
+            mesh_hierarchy.build(triangle_bounds);
+            std::vector<std::pair<std::uint32_t, std::uint32_t>> ranges;
+            if (!mesh_hierarchy.is_empty())
+                collect_clusters(mesh_hierarchy.get_nodes(), 0, ranges);
+
+            std::span<const std::uint32_t> order = mesh_hierarchy.get_primitives();
+            byte_buffer table;
+            byte_buffer blobs;
+            std::uint64_t blob_offset = HEADER_SIZE + ranges.size() * TABLE_ENTRY_SIZE;
+
+            for (auto [begin, end] : ranges) {
+                std::vector<mesh_triangle> cluster_triangles;
+                std::vector<aabb> cluster_bounds;
+                aabb bounds = aabb::empty();
+                for (std::uint32_t i = begin; i < end; i++) {
+                    cluster_triangles.push_back(triangles[order[i]]);
+                    cluster_bounds.push_back(triangle_bounds[order[i]]);
+                    bounds.extend(triangle_bounds[order[i]]);
+                }
+
+                bvh cluster_hierarchy;
+                cluster_hierarchy.build(cluster_bounds);
+                const std::size_t blob_begin = blobs.size();
+
+                for (const bvh::node &n : cluster_hierarchy.get_nodes()) {
+                    put_vec3(blobs, n.bounds.min);
+                    put_vec3(blobs, n.bounds.max);
+                    put<std::uint32_t>(blobs, n.first);
+                    put<std::uint32_t>(blobs, n.count);
+                }
+                for (std::uint32_t primitive : cluster_hierarchy.get_primitives())
+                    put<std::uint32_t>(blobs, primitive);
+                for (const mesh_triangle &t : cluster_triangles) {
+                    put_vec3(blobs, t.v0);
+                    put_vec3(blobs, t.v1);
+                    put_vec3(blobs, t.v2);
+                    for (vec3 uv : {t.uv0, t.uv1, t.uv2}) {
+                        put<float>(blobs, uv.x);
+                        put<float>(blobs, uv.y);
+                    }
+                }
+
+                put_vec3(table, bounds.min);
+                put_vec3(table, bounds.max);
+                put<std::uint64_t>(table, blob_offset + blob_begin);
+                put<std::uint32_t>(table, (std::uint32_t)cluster_triangles.size());
+                put<std::uint32_t>(table, (std::uint32_t)cluster_hierarchy.get_nodes().size());
+            }
+
+            byte_buffer header;
+            header.insert(header.end(), MAGIC, MAGIC + sizeof(MAGIC));
+            put<std::uint32_t>(header, (std::uint32_t)ranges.size());
+            put<std::uint32_t>(header, (std::uint32_t)triangles.size());
+
+            std::ofstream file {path, std::ios::binary};
+            if (!file)
+                return false;
+            file.write(reinterpret_cast<const char *>(header.data()), header.size());
+            file.write(reinterpret_cast<const char *>(table.data()), table.size());
+            file.write(reinterpret_cast<const char *>(blobs.data()), blobs.size());
+            return (bool)file.flush();
+        }
+
+        /// Open mesh file, at most `cache_size` bytes of clusters are kept resident (null if file is invalid)
+        static std::shared_ptr<streamed_mesh> open(const std::string &path, std::shared_ptr<material> material, std::size_t cache_size) {
+            std::ifstream file {path, std::ios::binary};
+            if (!file)
+                return nullptr;
+
+            // Every table entry is checked against file size, so corrupted file can't request huge reads
+            file.seekg(0, std::ios::end);
+            const std::uint64_t file_size = (std::uint64_t)file.tellg();
+            file.seekg(0, std::ios::beg);
+
+            byte_buffer header(HEADER_SIZE);
+            if (!file || file_size < HEADER_SIZE || !file.read(reinterpret_cast<char *>(header.data()), header.size()) || std::memcmp(header.data(), MAGIC, sizeof(MAGIC)) != 0)
+                return nullptr;
+
+            const std::uint32_t cluster_count = get<std::uint32_t>(header.data() + sizeof(MAGIC));
+            const std::uint64_t blobs_offset = HEADER_SIZE + (std::uint64_t)cluster_count * TABLE_ENTRY_SIZE;
+            if (blobs_offset > file_size)
+                return nullptr;
+
+            byte_buffer table((std::size_t)cluster_count * TABLE_ENTRY_SIZE);
+            if (!file.read(reinterpret_cast<char *>(table.data()), table.size()))
+                return nullptr;
+
+            std::vector<cluster_entry> entries(cluster_count);
+            std::vector<aabb> bounds(cluster_count);
+            for (std::uint32_t i = 0; i < cluster_count; i++) {
+                const std::uint8_t *entry = table.data() + (std::size_t)i * TABLE_ENTRY_SIZE;
+                bounds[i] = aabb {
+                    .min = get_vec3(entry),
+                    .max = get_vec3(entry + 12),
+                };
+                entries[i] = cluster_entry {
+                    .offset = get<std::uint64_t>(entry + 24),
+                    .triangle_count = get<std::uint32_t>(entry + 32),
+                    .node_count = get<std::uint32_t>(entry + 36),
+                };
+
+                // Hierarchy of `n` primitives has less than `2n` nodes
+                const cluster_entry &e = entries[i];
+                if (e.offset < blobs_offset || e.offset > file_size || e.get_blob_size() > file_size - e.offset
+                    || e.node_count > 2 * (std::uint64_t)e.triangle_count)
+                    return nullptr;
+            }
+
+            return std::shared_ptr<streamed_mesh>(new streamed_mesh(std::move(file), std::move(material), cache_size, std::move(entries), bounds));
+        }
+
+        /// Mesh destructor
+        ~streamed_mesh() {
+            {
+                std::lock_guard guard {lock};
+                do_continue = false;
+            }
+            queue_changed.notify_all();
+            loader.join();
+        }
+
+        /// Check for (any) intersection closer than `max_distance`
+        virtual bool check_intersection(ray r, float max_distance = intersection::INF_DISTANCE) const override {
+            bool is_deferred = false;
+
+            const bool is_hit = clusters.traverse(r, max_distance, [&](std::uint32_t cluster_id, float &) {
+                std::shared_ptr<const cluster> data = acquire(cluster_id);
+                if (data == nullptr) {
+                    is_deferred = true;
+                    return false;
+                }
+
+                return data->hierarchy.traverse(r, max_distance, [&](std::uint32_t triangle, float &) {
+                    float distance;
+                    return data->triangles[triangle].intersect(r, max_distance, distance);
+                });
+            });
+
+            if (is_deferred && !is_hit)
+                defer();
+            return is_hit;
+        }
+
+        /// 'Deep' intersection
+        virtual bool intersect(ray r, intersection &intr) const override {
+            bool is_deferred = false;
+            float best_distance = intersection::INF_DISTANCE;
+            const cluster_triangle *best = nullptr;
+
+            // Hit triangle is kept alive by its cluster until normal is computed
+            std::shared_ptr<const cluster> best_cluster;
+
+            clusters.traverse(r, best_distance, [&](std::uint32_t cluster_id, float &max_distance) {
+                std::shared_ptr<const cluster> data = acquire(cluster_id);
+                if (data == nullptr) {
+                    is_deferred = true;
+                    return false;
+                }
+
+                data->hierarchy.traverse(r, max_distance, [&](std::uint32_t triangle, float &cluster_max_distance) {
+                    float distance;
+                    if (data->triangles[triangle].intersect(r, cluster_max_distance, distance)) {
+                        cluster_max_distance = best_distance = distance;
+                        best = &data->triangles[triangle];
+                        best_cluster = data;
+                    }
+                    return false;
+                });
+
+                max_distance = best_distance;
+                return false;
+            });
+
+            if (is_deferred)
+                defer();
+            if (best == nullptr)
+                return false;
+
+            vec3 normal = best->normal;
+            if (normal.dot(r.direction) > 0.0f)
+                normal = vec3(0.0f) - normal;
+
+            float b1, b2;
+            best->get_barycentrics(r.at(best_distance), b1, b2);
+
+            intr.distance = best_distance;
+            intr.normal = normal;
+            intr.u = best->uv[0] + best->uv[2] * b1 + best->uv[4] * b2;
+            intr.v = best->uv[1] + best->uv[3] * b1 + best->uv[5] * b2;
+            intr.uv_density = best->uv_density;
+            intr.hit_material = mtl;
+            return true;
+        }
+
+        /// Get hash of shape contents (cluster table and hierarchy, cluster data is not read)
+        virtual std::uint64_t get_hash() const override {
+            hasher h;
+            for (const cluster_entry &entry : entries)
+                h.add(entry.offset).add((std::uint64_t)entry.triangle_count << 32 | entry.node_count);
+            for (const bvh::node &node : clusters.get_nodes())
+                h.add(node.bounds.min).add(node.bounds.max);
+            return h.add(mtl->get_hash()).get();
+        }
+
+        /// Get shape bounding box
+        virtual aabb get_bounds() const override {
+            return clusters.get_bounds();
+        }
+
+        /// Get size of resident cluster data (in bytes)
+        std::size_t get_resident_size() const noexcept {
+            return resident_size.load(std::memory_order_relaxed);
+        }
+
+        /// Get count of cluster loads
+        std::size_t get_load_count() const noexcept {
+            return load_count.load(std::memory_order_relaxed);
+        }
+
+        /// Get count of deferred queries
+        std::size_t get_deferred_count() const noexcept {
+            return deferred_count.load(std::memory_order_relaxed);
+        }
+
+        /// Get count of clusters that failed to load (they are skipped by queries)
+        std::size_t get_failed_load_count() const noexcept {
+            return failed_load_count.load(std::memory_order_relaxed);
+        }
+
+    private:
+
+        /// Byte buffer used by file encoding
+        using byte_buffer = std::vector<std::uint8_t>;
+
+        /// File signature
+        constexpr static char MAGIC[8] = {'R', 'T', 'M', 'E', 'S', 'H', '0', '2'};
+
+        /// Size of file header (signature, cluster count, triangle count)
+        constexpr static std::size_t HEADER_SIZE = sizeof(MAGIC) + 8;
+
+        /// Size of cluster table entry (bounds, offset, triangle count, node count)
+        constexpr static std::size_t TABLE_ENTRY_SIZE = 40;
+
+        /// Size of serialized hierarchy node
+        constexpr static std::size_t NODE_SIZE = 32;
+
+        /// Size of serialized triangle (vertices and texture coordinates)
+        constexpr static std::size_t TRIANGLE_SIZE = 60;
+
+        /// Cluster location in file
+        struct cluster_entry {
+            /// Cluster data offset
+            std::uint64_t offset = 0;
+
+            /// Count of cluster triangles
+            std::uint32_t triangle_count = 0;
+
+            /// Count of cluster hierarchy nodes
+            std::uint32_t node_count = 0;
+
+            /// Get size of cluster data in file
+            std::uint64_t get_blob_size() const noexcept {
+                return (std::uint64_t)node_count * NODE_SIZE + (std::uint64_t)triangle_count * (4 + TRIANGLE_SIZE);
+            }
+        };
+
+        /// Triangle prepared for intersection
+        struct cluster_triangle {
+            /// First vertex
+            vec3 v0;
+
+            /// First edge
+            vec3 e1;
+
+            /// Second edge
+            vec3 e2;
+
+            /// Unit geometric normal
+            vec3 normal;
+
+            /// First vertex texture coordinates and their changes along edges (u0, v0, du1, dv1, du2, dv2)
+            float uv[6];
+
+            /// Texture coordinate change per unit of surface distance
+            float uv_density;
+
+            /// Get barycentric coordinates of point on triangle plane (weights of second and third vertices)
+            void get_barycentrics(vec3 point, float &b1, float &b2) const {
+                const vec3 d = point - v0;
+                const float d11 = e1.dot(e1), d12 = e1.dot(e2), d22 = e2.dot(e2);
+                const float dp1 = d.dot(e1), dp2 = d.dot(e2);
+                const float inv_det = 1.0f / (d11 * d22 - d12 * d12);
+                b1 = (d22 * dp1 - d12 * dp2) * inv_det;
+                b2 = (d11 * dp2 - d12 * dp1) * inv_det;
+            }
+
+            /// Moller-Trumbore intersection, writes hit distance (must be less than `max_distance`)
+            bool intersect(const ray &r, float max_distance, float &distance) const {
+                const vec3 p = r.direction.cross(e2);
+                const float det = e1.dot(p);
+                if (std::abs(det) < 1e-12f)
+                    return false;
+
+                const float inv_det = 1.0f / det;
+                const vec3 s = r.origin - v0;
+                const float u = s.dot(p) * inv_det;
+                if (u < 0.0f || u > 1.0f)
+                    return false;
+
+                const vec3 q = s.cross(e1);
+                const float v = r.direction.dot(q) * inv_det;
+                if (v < 0.0f || u + v > 1.0f)
+                    return false;
+
+                distance = e2.dot(q) * inv_det;
+                return distance > 0.0f && distance < max_distance;
+            }
+        };
+
+        /// Resident cluster
+        struct cluster {
+            /// Cluster triangles
+            std::vector<cluster_triangle> triangles;
+
+            /// Cluster hierarchy
+            bvh hierarchy;
+
+            /// Size of cluster data in memory
+            std::size_t size = 0;
+        };
+
+        /// Cluster cache slot
+        struct slot {
+            /// Cluster data (null if cluster is not resident)
+            std::atomic<std::shared_ptr<const cluster>> data = nullptr;
+
+            /// True if cluster is resident, its load is requested or failed
+            std::atomic_bool is_requested = false;
+
+            /// True if cluster load failed (cluster is never resident then)
+            std::atomic_bool is_failed = false;
+
+            /// Loader epoch of the last access (used for eviction)
+            std::atomic_uint64_t last_use = 0;
+        };
+
+        /// Construct mesh
+        streamed_mesh(std::ifstream file, std::shared_ptr<material> material, std::size_t cache_size, std::vector<cluster_entry> entries, std::span<const aabb> bounds):
+            mtl(std::move(material)),
+            cache_size(cache_size),
+            file(std::move(file)),
+            entries(std::move(entries)),
+            slots(std::make_unique<slot[]>(this->entries.size()))
+        {
+            clusters.build(bounds);
+            loader = std::thread([this]() { run_loader(); });
+        }
+
+        /// Append value bytes
+        template <typename value_type>
+        static void put(byte_buffer &buffer, value_type value) {
+            const std::size_t offset = buffer.size();
+            buffer.resize(offset + sizeof(value_type));
+            std::memcpy(buffer.data() + offset, &value, sizeof(value_type));
+        }
+
+        /// Append vector components
+        static void put_vec3(byte_buffer &buffer, vec3 v) {
+            put<float>(buffer, v.x);
+            put<float>(buffer, v.y);
+            put<float>(buffer, v.z);
+        }
+
+        /// Read value bytes
+        template <typename value_type>
+        static value_type get(const std::uint8_t *data) {
+            value_type value;
+            std::memcpy(&value, data, sizeof(value_type));
+            return value;
+        }
+
+        /// Read vector components
+        static vec3 get_vec3(const std::uint8_t *data) {
+            return vec3(get<float>(data), get<float>(data + 4), get<float>(data + 8));
+        }
+
+        /// Collect primitive ranges of maximal subtrees with at most CLUSTER_SIZE primitives, returns subtree range
+        static std::pair<std::uint32_t, std::uint32_t> collect_clusters(
+            std::span<const bvh::node> nodes,
+            std::uint32_t index,
+            std::vector<std::pair<std::uint32_t, std::uint32_t>> &ranges
+        ) {
+            auto size = [](std::pair<std::uint32_t, std::uint32_t> range) { return range.second - range.first; };
+
+            const bvh::node &n = nodes[index];
+            std::pair<std::uint32_t, std::uint32_t> range {n.first, n.first + n.count};
+
+            if (n.count == 0) {
+                // Subtree primitives are contiguous, so subtree range is union of children ones
+                auto left = collect_clusters(nodes, n.first, ranges);
+                auto right = collect_clusters(nodes, n.first + 1, ranges);
+                range = {std::min(left.first, right.first), std::max(left.second, right.second)};
+
+                // Small children of large subtree become clusters (large ones have emitted their parts already)
+                if (size(range) > CLUSTER_SIZE) {
+                    for (auto child : {left, right})
+                        if (size(child) <= CLUSTER_SIZE)
+                            ranges.push_back(child);
+                    return range;
+                }
+            }
+
+            if (index == 0)
+                ranges.push_back(range);
+            return range;
+        }
+
+        /// Get cluster if it's resident, otherwise request its load (and wait for it in blocking mode)
+        std::shared_ptr<const cluster> acquire(std::uint32_t cluster_id) const {
+            slot &s = slots[cluster_id];
+
+            const std::uint64_t epoch = load_epoch.load(std::memory_order_relaxed);
+            if (s.last_use.load(std::memory_order_relaxed) != epoch)
+                s.last_use.store(epoch, std::memory_order_relaxed);
+
+            std::shared_ptr<const cluster> data = s.data.load(std::memory_order_acquire);
+            if (data != nullptr)
+                return data;
+            if (s.is_failed.load(std::memory_order_acquire))
+                return failed_cluster;
+
+            if (!query_context::get().is_blocking) {
+                request(cluster_id);
+                return nullptr;
+            }
+
+            std::unique_lock guard {lock};
+            for (;;) {
+                data = s.data.load(std::memory_order_acquire);
+                if (data != nullptr)
+                    return data;
+                if (s.is_failed.load(std::memory_order_acquire))
+                    return failed_cluster;
+
+                if (!s.is_requested.exchange(true, std::memory_order_relaxed)) {
+                    requests.push_back(cluster_id);
+                    queue_changed.notify_all();
+                }
+                cluster_loaded.wait(guard);
+            }
+        }
+
+        /// Request cluster load
+        void request(std::uint32_t cluster_id) const {
+            if (slots[cluster_id].is_requested.exchange(true, std::memory_order_relaxed))
+                return;
+
+            {
+                std::lock_guard guard {lock};
+                requests.push_back(cluster_id);
+            }
+            queue_changed.notify_all();
+        }
+
+        /// Report deferred query
+        void defer() const {
+            query_context::get().deferred_count++;
+            deferred_count.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /// Read cluster from file, null if it can't be read or its hierarchy is invalid (loader thread only)
+        std::shared_ptr<const cluster> read_cluster(std::uint32_t cluster_id) {
+            const cluster_entry &entry = entries[cluster_id];
+            byte_buffer blob(entry.get_blob_size());
+
+            file.clear();
+            file.seekg(entry.offset);
+            if (!file.read(reinterpret_cast<char *>(blob.data()), blob.size()))
+                return nullptr;
+
+            std::vector<bvh::node> nodes(entry.node_count);
+            const std::uint8_t *data = blob.data();
+            for (bvh::node &n : nodes) {
+                n.bounds = aabb {
+                    .min = get_vec3(data),
+                    .max = get_vec3(data + 12),
+                };
+                n.first = get<std::uint32_t>(data + 24);
+                n.count = get<std::uint32_t>(data + 28);
+                data += NODE_SIZE;
+            }
+
+            std::vector<std::uint32_t> primitives(entry.triangle_count);
+            for (std::uint32_t &primitive : primitives) {
+                primitive = get<std::uint32_t>(data);
+                data += 4;
+            }
+
+            std::shared_ptr<cluster> result = std::make_shared<cluster>();
+            result->triangles.reserve(entry.triangle_count);
+            for (std::uint32_t i = 0; i < entry.triangle_count; i++) {
+                const vec3 v0 = get_vec3(data);
+                const vec3 e1 = get_vec3(data + 12) - v0;
+                const vec3 e2 = get_vec3(data + 24) - v0;
+                const vec3 cross = e1.cross(e2);
+
+                float uv[6];
+                for (std::size_t c = 0; c < 6; c++)
+                    uv[c] = get<float>(data + 36 + c * 4);
+                for (std::size_t c = 2; c < 6; c++)
+                    uv[c] -= uv[c % 2];
+
+                // Square root of texture area to surface area ratio
+                const float uv_area = std::abs(uv[2] * uv[5] - uv[3] * uv[4]);
+                const float area = cross.length();
+
+                result->triangles.push_back(cluster_triangle {
+                    .v0 = v0,
+                    .e1 = e1,
+                    .e2 = e2,
+                    .normal = cross * vec3(1.0f / area),
+                    .uv = {uv[0], uv[1], uv[2], uv[3], uv[4], uv[5]},
+                    .uv_density = area > 0.0f ? std::sqrt(uv_area / area) : 0.0f,
+                });
+                data += TRIANGLE_SIZE;
+            }
+
+            result->size = sizeof(cluster)
+                + result->triangles.size() * sizeof(cluster_triangle)
+                + nodes.size() * sizeof(bvh::node)
+                + primitives.size() * sizeof(std::uint32_t);
+
+            std::optional<bvh> hierarchy = bvh::from_data(std::move(nodes), std::move(primitives), entry.triangle_count);
+            if (!hierarchy.has_value())
+                return nullptr;
+            result->hierarchy = std::move(*hierarchy);
+            return result;
+        }
+
+        /// Loader thread function
+        void run_loader() {
+            std::unique_lock guard {lock};
+
+            for (;;) {
+                queue_changed.wait(guard, [this]() { return !requests.empty() || !do_continue; });
+                if (!do_continue)
+                    return;
+
+                const std::uint32_t cluster_id = requests.front();
+                requests.pop_front();
+
+                // File is read without holding the lock
+                guard.unlock();
+                std::shared_ptr<const cluster> data = read_cluster(cluster_id);
+                guard.lock();
+
+                // Failed cluster stays requested, so it isn't read again, and queries skip it
+                if (data == nullptr) {
+                    slots[cluster_id].is_failed.store(true, std::memory_order_release);
+                    failed_load_count.fetch_add(1, std::memory_order_relaxed);
+                    cluster_loaded.notify_all();
+                    continue;
+                }
+
+                slots[cluster_id].data.store(data, std::memory_order_release);
+                slots[cluster_id].last_use.store(load_epoch.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                resident_ids.push_back(cluster_id);
+                resident_size.fetch_add(data->size, std::memory_order_relaxed);
+                load_count.fetch_add(1, std::memory_order_relaxed);
+
+                evict(cluster_id);
+                cluster_loaded.notify_all();
+            }
+        }
+
+        /// Evict least recently used clusters until cache fits its size (`kept_id` is never evicted)
+        void evict(std::uint32_t kept_id) {
+            while (resident_size.load(std::memory_order_relaxed) > cache_size && resident_ids.size() > 1) {
+                std::size_t oldest = resident_ids[0] == kept_id ? 1 : 0;
+                for (std::size_t i = 0; i < resident_ids.size(); i++)
+                    if (resident_ids[i] != kept_id && slots[resident_ids[i]].last_use.load(std::memory_order_relaxed) < slots[resident_ids[oldest]].last_use.load(std::memory_order_relaxed))
+                        oldest = i;
+
+                slot &s = slots[resident_ids[oldest]];
+                resident_size.fetch_sub(s.data.load(std::memory_order_relaxed)->size, std::memory_order_relaxed);
+                s.data.store(nullptr, std::memory_order_release);
+                s.is_requested.store(false, std::memory_order_relaxed);
+
+                resident_ids[oldest] = resident_ids.back();
+                resident_ids.pop_back();
+            }
+        }
+
+        /// Mesh material
+        std::shared_ptr<material> mtl;
+
+        /// Maximal size of resident clusters
+        std::size_t cache_size;
+
+        /// Mesh file (used by loader thread only)
+        std::ifstream file;
+
+        /// Cluster locations
+        std::vector<cluster_entry> entries;
+
+        /// Cluster cache slots
+        std::unique_ptr<slot[]> slots;
+
+        /// Empty cluster returned for clusters that failed to load (it's not resident)
+        std::shared_ptr<const cluster> failed_cluster = std::make_shared<const cluster>();
+
+        /// Hierarchy over cluster bounds
+        bvh clusters;
+
+        /// Loader queue lock
+        mutable std::mutex lock;
+
+        /// Loader queue change notification
+        mutable std::condition_variable queue_changed;
+
+        /// Cluster load notification (used by blocking queries)
+        mutable std::condition_variable cluster_loaded;
+
+        /// Requested clusters
+        mutable std::deque<std::uint32_t> requests {};
+
+        /// Resident clusters (loader thread only)
+        std::vector<std::uint32_t> resident_ids {};
+
+        /// Incremented on every load, used as access time
+        std::atomic_uint64_t load_epoch = 1;
+
+        /// Statistics
+        std::atomic_size_t resident_size = 0;
+        std::atomic_size_t load_count = 0;
+        mutable std::atomic_size_t deferred_count = 0;
+        std::atomic_size_t failed_load_count = 0;
+
+        /// Continue if true (used to stop loader on destruction)
+        bool do_continue = true;
+
+        /// Loader thread
+        std::thread loader;
+    };
+}
+
+#endif // !defined(RT_SHAPE_STREAMED_MESH_HPP_)
+
+// rt_shape_streamed_mesh.hpp
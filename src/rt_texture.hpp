@@ -0,0 +1,267 @@
+//! Mipmapped texture implementation file
+
+#ifndef RT_TEXTURE_HPP_
+#define RT_TEXTURE_HPP_
+
+#include <bit>
+#include <numbers>
+
+#include "rt_common.hpp"
+#include "rt_math.hpp"
+
+namespace rt {
+    /// Common vec3 definition
+    using vec3 = math::vec3<float>;
+
+    /// Color texture with repeat addressing.
+    /// Every mip level is stored in 4x4 texel tiles (single cache line each), so bilinear footprint
+    /// rarely touches more than one line. Texels are 8-bit RGB with gamma 2 encoding (decoded by squaring).
+    class texture {
+    public:
+
+        /// Count of texels along tile side
+        constexpr static std::size_t TILE_SIZE = 4;
+
+        /// Build mip chain of `width` x `height` pixels (row-major, components are clamped to [0, 1]).
+        /// Finest levels are dropped until chain fits into `max_size` bytes (the coarsest 1x1 level is always kept).
+        texture(std::span<const vec3> pixels, std::size_t width, std::size_t height, std::size_t max_size = std::numeric_limits<std::size_t>::max()) {
+            // Level sizes, the whole chain is filtered in float
+            std::vector<std::pair<std::size_t, std::size_t>> sizes {{std::max<std::size_t>(width, 1), std::max<std::size_t>(height, 1)}};
+            while (sizes.back().first > 1 || sizes.back().second > 1)
+                sizes.push_back({std::max<std::size_t>(sizes.back().first / 2, 1), std::max<std::size_t>(sizes.back().second / 2, 1)});
+
+            std::size_t chain_size = 0;
+            for (auto [w, h] : sizes)
+                chain_size += get_level_size(w, h);
+            while (first_level + 1 < sizes.size() && chain_size > max_size) {
+                chain_size -= get_level_size(sizes[first_level].first, sizes[first_level].second);
+                first_level++;
+            }
+
+            level_count = sizes.size();
+            texels.reserve(chain_size / sizeof(std::uint32_t));
+
+            std::vector<vec3> current(sizes[0].first * sizes[0].second, vec3(0.0f));
+            if (width != 0 && height != 0)
+                for (std::size_t i = 0; i < width * height; i++)
+                    current[i] = pixels[i].max(vec3(0.0f)).min(vec3(1.0f));
+
+            for (std::size_t index = 0; index < sizes.size(); index++) {
+                const auto [w, h] = sizes[index];
+                if (index >= first_level) {
+                    const std::size_t tiles_x = (w + TILE_SIZE - 1) / TILE_SIZE;
+                    const std::size_t tiles_y = (h + TILE_SIZE - 1) / TILE_SIZE;
+                    levels.push_back(level {
+                        .width = w,
+                        .height = h,
+                        .tiles_x = tiles_x,
+                        .offset = texels.size(),
+                    });
+                    texels.resize(texels.size() + tiles_x * tiles_y * TILE_SIZE * TILE_SIZE, 0);
+
+                    const level &l = levels.back();
+                    for (std::size_t y = 0; y < h; y++)
+                        for (std::size_t x = 0; x < w; x++)
+                            texels[get_texel_index(l, x, y)] = encode(current[y * w + x]);
+                }
+
+                // 2x2 box filter, odd last row/column is merged into the previous texel (3 taps along that axis)
+                if (index + 1 < sizes.size()) {
+                    const auto [nw, nh] = sizes[index + 1];
+                    std::vector<vec3> next(nw * nh);
+                    for (std::size_t y = 0; y < nh; y++)
+                        for (std::size_t x = 0; x < nw; x++) {
+                            const std::size_t x0 = std::min(2 * x, w - 1), x1 = get_filter_end(x, w, nw);
+                            const std::size_t y0 = std::min(2 * y, h - 1), y1 = get_filter_end(y, h, nh);
+
+                            vec3 sum {0.0f};
+                            for (std::size_t sy = y0; sy < y1; sy++)
+                                for (std::size_t sx = x0; sx < x1; sx++)
+                                    sum = sum + current[sy * w + sx];
+                            next[y * nw + x] = sum * vec3(1.0f / (float)((x1 - x0) * (y1 - y0)));
+                        }
+                    current = std::move(next);
+                }
+            }
+
+            hash = 0xCBF29CE484222325ull;
+            for (std::uint32_t texel : texels)
+                hash = (hash ^ texel) * 0x100000001B3ull;
+        }
+
+        /// Get size of chain of `width` x `height` texture, as if it had no dropped levels
+        static std::size_t get_chain_size(std::size_t width, std::size_t height) {
+            std::size_t size = get_level_size(width, height);
+            while (width > 1 || height > 1) {
+                width = std::max<std::size_t>(width / 2, 1);
+                height = std::max<std::size_t>(height / 2, 1);
+                size += get_level_size(width, height);
+            }
+            return size;
+        }
+
+        /// Bilinearly filtered color at texture coordinates, `footprint` is size of sampled area in texture coordinates
+        vec3 sample(float u, float v, float footprint) const {
+            // Level where footprint covers about one texel (dropped levels are replaced by the finest resident one)
+            const level &base = levels.front();
+            const float texel_footprint = footprint * (float)(std::max(base.width, base.height) << first_level);
+            std::size_t index = 0;
+            if (texel_footprint > 1.0f) {
+                // Biased exponent of footprint * sqrt(2) is round(log2(footprint)) + 127
+                const std::uint32_t exponent = std::bit_cast<std::uint32_t>(texel_footprint * std::numbers::sqrt2_v<float>) >> 23;
+                index = exponent - 127;
+            }
+            const level &l = levels[std::clamp(index, first_level, level_count - 1) - first_level];
+
+            const float x = (u - get_floor(u)) * l.width - 0.5f;
+            const float y = (v - get_floor(v)) * l.height - 0.5f;
+            const float fx = get_floor(x), fy = get_floor(y);
+            const float tx = x - fx, ty = y - fy;
+
+            // Repeat addressing (coordinates are in [-1, size)), tile offsets of columns and rows are summed
+            const std::size_t x0 = fx < 0.0f ? l.width - 1 : (std::size_t)(std::int32_t)fx;
+            const std::size_t y0 = fy < 0.0f ? l.height - 1 : (std::size_t)(std::int32_t)fy;
+            const std::size_t x1 = x0 + 1 == l.width ? 0 : x0 + 1;
+            const std::size_t y1 = y0 + 1 == l.height ? 0 : y0 + 1;
+
+            const std::uint32_t *row0 = texels.data() + l.offset + get_row_offset(l, y0);
+            const std::uint32_t *row1 = texels.data() + l.offset + get_row_offset(l, y1);
+            const std::size_t column0 = get_column_offset(x0), column1 = get_column_offset(x1);
+            const std::uint32_t t00 = row0[column0], t10 = row0[column1];
+            const std::uint32_t t01 = row1[column0], t11 = row1[column1];
+
+            const float w00 = (1.0f - tx) * (1.0f - ty), w10 = tx * (1.0f - ty);
+            const float w01 = (1.0f - tx) * ty, w11 = tx * ty;
+
+#if defined(__SSE2__)
+            // Widen four texels to float lanes at once: bytes -> 16-bit -> 32-bit
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i packed = _mm_set_epi32((int)t11, (int)t01, (int)t10, (int)t00);
+            const __m128i low = _mm_unpacklo_epi8(packed, zero);
+            const __m128i high = _mm_unpackhi_epi8(packed, zero);
+            const __m128 c00 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero));
+            const __m128 c10 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero));
+            const __m128 c01 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero));
+            const __m128 c11 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero));
+
+            const __m128 sum = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_mul_ps(c00, c00), _mm_set1_ps(w00)), _mm_mul_ps(_mm_mul_ps(c10, c10), _mm_set1_ps(w10))),
+                _mm_add_ps(_mm_mul_ps(_mm_mul_ps(c01, c01), _mm_set1_ps(w01)), _mm_mul_ps(_mm_mul_ps(c11, c11), _mm_set1_ps(w11)))
+            );
+
+            alignas(16) float result[4];
+            _mm_store_ps(result, _mm_mul_ps(sum, _mm_set1_ps(DECODE_SCALE)));
+            return vec3(result[0], result[1], result[2]);
+#else
+            return (decode(t00) * vec3(w00) + decode(t10) * vec3(w10)) + (decode(t01) * vec3(w01) + decode(t11) * vec3(w11));
+#endif
+        }
+
+        /// Get width of the finest level (including dropped one)
+        std::size_t get_width() const noexcept {
+            return levels.front().width << first_level;
+        }
+
+        /// Get height of the finest level (including dropped one)
+        std::size_t get_height() const noexcept {
+            return levels.front().height << first_level;
+        }
+
+        /// Get count of levels dropped to fit into size limit
+        std::size_t get_dropped_level_count() const noexcept {
+            return first_level;
+        }
+
+        /// Get size of texel data (in bytes)
+        std::size_t get_memory_size() const noexcept {
+            return texels.size() * sizeof(std::uint32_t);
+        }
+
+        /// Get hash of texel data
+        std::uint64_t get_hash() const noexcept {
+            return hash;
+        }
+
+    private:
+
+        /// Scale from squared 8-bit value to [0, 1]
+        constexpr static float DECODE_SCALE = 1.0f / (255.0f * 255.0f);
+
+        /// Mip level
+        struct level {
+            /// Width in texels
+            std::size_t width = 0;
+
+            /// Height in texels
+            std::size_t height = 0;
+
+            /// Count of tiles in row
+            std::size_t tiles_x = 0;
+
+            /// Index of the first level texel
+            std::size_t offset = 0;
+        };
+
+        /// Get end of source texel range filtered into texel `index` of next level along axis (the last one takes odd remainder)
+        static std::size_t get_filter_end(std::size_t index, std::size_t size, std::size_t next_size) noexcept {
+            return index + 1 == next_size ? size : 2 * index + 2;
+        }
+
+        /// Get size of level with tile padding (in bytes)
+        static std::size_t get_level_size(std::size_t width, std::size_t height) noexcept {
+            return ((width + TILE_SIZE - 1) / TILE_SIZE) * ((height + TILE_SIZE - 1) / TILE_SIZE) * TILE_SIZE * TILE_SIZE * sizeof(std::uint32_t);
+        }
+
+        /// Get offset of texel row `y` from level start
+        static std::size_t get_row_offset(const level &l, std::size_t y) noexcept {
+            return (y / TILE_SIZE) * l.tiles_x * TILE_SIZE * TILE_SIZE + (y % TILE_SIZE) * TILE_SIZE;
+        }
+
+        /// Get offset of texel column `x` from row start
+        static std::size_t get_column_offset(std::size_t x) noexcept {
+            return (x / TILE_SIZE) * TILE_SIZE * TILE_SIZE + x % TILE_SIZE;
+        }
+
+        /// Get index of level texel
+        static std::size_t get_texel_index(const level &l, std::size_t x, std::size_t y) noexcept {
+            return l.offset + get_row_offset(l, y) + get_column_offset(x);
+        }
+
+        /// Floor of value in integer range (doesn't call libm if SSE4.1 isn't available)
+        static float get_floor(float value) noexcept {
+            const float truncated = (float)(std::int64_t)value;
+            return truncated > value ? truncated - 1.0f : truncated;
+        }
+
+        /// Encode color in [0, 1] to texel
+        static std::uint32_t encode(vec3 color) {
+            auto channel = [](float c) { return (std::uint32_t)(std::sqrt(c) * 255.0f + 0.5f); };
+            return channel(color.x) | channel(color.y) << 8 | channel(color.z) << 16;
+        }
+
+        /// Decode texel to color
+        static vec3 decode(std::uint32_t texel) {
+            auto channel = [](std::uint32_t c) { return (float)(c * c) * DECODE_SCALE; };
+            return vec3(channel(texel & 0xFF), channel(texel >> 8 & 0xFF), channel(texel >> 16 & 0xFF));
+        }
+
+        /// Resident levels, finest first
+        std::vector<level> levels;
+
+        /// Count of levels in full chain
+        std::size_t level_count = 0;
+
+        /// Count of dropped finest levels
+        std::size_t first_level = 0;
+
+        /// Texels of all resident levels
+        std::vector<std::uint32_t> texels;
+
+        /// Texel data hash
+        std::uint64_t hash = 0;
+    };
+}
+
+#endif // !defined(RT_TEXTURE_HPP_)
+
+// rt_texture.hpp
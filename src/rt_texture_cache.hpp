@@ -0,0 +1,138 @@
+//! Shared texture cache implementation file
+
+#ifndef RT_TEXTURE_CACHE_HPP_
+#define RT_TEXTURE_CACHE_HPP_
+
+#include <string>
+#include <unordered_map>
+
+#include "rt_image.hpp"
+#include "rt_texture.hpp"
+
+namespace rt {
+    /// Texture set with shared memory budget, textures are shared by key (e.g. file path).
+    /// Textures nobody else references are evicted in least recently requested order when budget is exceeded,
+    /// new texture that still doesn't fit gets its finest mip levels dropped.
+    class texture_cache {
+    public:
+
+        /// Construct cache with `budget` bytes of texel data
+        texture_cache(std::size_t budget):
+            budget(budget)
+        {
+        }
+
+        /// Get texture of Radiance HDR image file, loaded on the first request (null if file can't be loaded)
+        std::shared_ptr<const texture> load(const std::string &path) {
+            if (std::shared_ptr<const texture> cached = find(path))
+                return cached;
+
+            std::optional<image> source = image::load_hdr(path);
+            if (!source.has_value())
+                return nullptr;
+            return insert(path, *source);
+        }
+
+        /// Get texture of key, built from `source` if it's not cached yet
+        std::shared_ptr<const texture> insert(const std::string &key, const image &source) {
+            if (std::shared_ptr<const texture> cached = find(key))
+                return cached;
+
+            std::vector<vec3> pixels;
+            pixels.reserve(source.get_width() * source.get_height());
+            for (std::size_t y = 0; y < source.get_height(); y++)
+                pixels.insert(pixels.end(), source.get_row(y).begin(), source.get_row(y).end());
+
+            // Mip chain is built without holding the lock, so other requests aren't blocked by it
+            std::size_t available;
+            {
+                std::lock_guard guard {lock};
+                evict(texture::get_chain_size(source.get_width(), source.get_height()));
+                available = budget > resident_size ? budget - resident_size : 0;
+            }
+            auto result = std::make_shared<const texture>(pixels, source.get_width(), source.get_height(), available);
+
+            // Key may be inserted by concurrent request meanwhile, its texture is kept then
+            std::lock_guard guard {lock};
+            if (auto found = entries.find(key); found != entries.end()) {
+                found->second.last_use = ++use_epoch;
+                return found->second.value;
+            }
+            evict(result->get_memory_size());
+
+            resident_size += result->get_memory_size();
+            entries[key] = entry {
+                .value = result,
+                .last_use = ++use_epoch,
+            };
+            return result;
+        }
+
+        /// Get size of cached texel data (may exceed budget if the smallest mip levels don't fit)
+        std::size_t get_resident_size() const {
+            std::lock_guard guard {lock};
+            return resident_size;
+        }
+
+        /// Get memory budget
+        std::size_t get_budget() const noexcept {
+            return budget;
+        }
+
+    private:
+
+        /// Cached texture
+        struct entry {
+            /// Texture
+            std::shared_ptr<const texture> value;
+
+            /// Epoch of the last request
+            std::uint64_t last_use = 0;
+        };
+
+        /// Find cached texture, marks it as used
+        std::shared_ptr<const texture> find(const std::string &key) {
+            std::lock_guard guard {lock};
+
+            auto found = entries.find(key);
+            if (found == entries.end())
+                return nullptr;
+            found->second.last_use = ++use_epoch;
+            return found->second.value;
+        }
+
+        /// Evict unreferenced textures until `required` bytes are available or nothing can be evicted
+        void evict(std::size_t required) {
+            while (resident_size + required > budget) {
+                auto victim = entries.end();
+                for (auto it = entries.begin(); it != entries.end(); it++)
+                    if (it->second.value.use_count() == 1 && (victim == entries.end() || it->second.last_use < victim->second.last_use))
+                        victim = it;
+
+                if (victim == entries.end())
+                    return;
+                resident_size -= victim->second.value->get_memory_size();
+                entries.erase(victim);
+            }
+        }
+
+        /// Memory budget
+        const std::size_t budget;
+
+        /// Cache lock
+        mutable std::mutex lock;
+
+        /// Cached textures
+        std::unordered_map<std::string, entry> entries;
+
+        /// Size of cached texel data
+        std::size_t resident_size = 0;
+
+        /// Request counter
+        std::uint64_t use_epoch = 0;
+    };
+}
+
+#endif // !defined(RT_TEXTURE_CACHE_HPP_)
+
+// rt_texture_cache.hpp
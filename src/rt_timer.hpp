@@ -27,6 +27,26 @@ namespace rt {
             return fps_frames_from_measure == 0;
         }
 
+        /// Get count of actually presented frames per second (measured together with fps)
+        float get_present_rate() const noexcept {
+            return present_rate;
+        }
+
+        /// Get count of rendered pixel samples per second (measured together with fps)
+        float get_sample_rate() const noexcept {
+            return sample_rate;
+        }
+
+        /// Account presented frame
+        void on_present() noexcept {
+            presents_from_measure++;
+        }
+
+        /// Set total count of rendered pixel samples
+        void set_sample_count(std::uint64_t count) noexcept {
+            sample_count = count;
+        }
+
         void update() {
             clock::time_point new_now = clock::now();
 
@@ -36,9 +56,15 @@ namespace rt {
 
             fps_frames_from_measure++;
             if (now - fps_last_measure > fps_measure_duration) {
-                fps = fps_frames_from_measure / time_between(fps_last_measure, now);
+                const float measure_time = time_between(fps_last_measure, now);
+                fps = fps_frames_from_measure / measure_time;
+                present_rate = presents_from_measure / measure_time;
+                sample_rate = (sample_count - measured_sample_count) / measure_time;
+
                 fps_last_measure = now;
                 fps_frames_from_measure = 0;
+                presents_from_measure = 0;
+                measured_sample_count = sample_count;
             }
         }
 
@@ -60,6 +86,13 @@ namespace rt {
         clock::time_point fps_last_measure = clock::now();
         std::uint32_t fps_frames_from_measure = 1;
         float fps = 0.0f;
+
+        std::uint32_t presents_from_measure = 0;
+        float present_rate = 0.0f;
+
+        std::uint64_t sample_count = 0;
+        std::uint64_t measured_sample_count = 0;
+        float sample_rate = 0.0f;
     };
 }
 
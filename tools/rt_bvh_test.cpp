@@ -0,0 +1,66 @@
+//! Hierarchy depth test: skewed and degenerate primitive sets must build hierarchies that fit traversal stacks
+
+#include <print>
+
+#include "rt_bvh.hpp"
+
+namespace {
+    /// Get maximal leaf depth of subtree
+    std::size_t get_depth(std::span<const rt::bvh::node> nodes, std::uint32_t index) {
+        const rt::bvh::node &n = nodes[index];
+        return n.count != 0 ? 0 : 1 + std::max(get_depth(nodes, n.first), get_depth(nodes, n.first + 1));
+    }
+
+    /// Build hierarchy over `bounds`, check its depth and that ray through every primitive center visits it.
+    /// Returns false on failure.
+    bool run_test(const char *name, std::span<const rt::aabb> bounds) {
+        rt::bvh hierarchy;
+        hierarchy.build(bounds);
+        const std::size_t depth = get_depth(hierarchy.get_nodes(), 0);
+
+        std::size_t missed_count = 0;
+        for (std::uint32_t primitive = 0; primitive < bounds.size(); primitive++) {
+            const rt::vec3 center = bounds[primitive].center();
+            const rt::ray r {rt::vec3(center.x, center.y, bounds[primitive].max.z + 1.0f), rt::vec3(0.0f, 0.0f, -1.0f)};
+
+            bool is_visited = false;
+            hierarchy.traverse(r, rt::intersection::INF_DISTANCE, [&](std::uint32_t visited, float &) {
+                is_visited = visited == primitive;
+                return is_visited;
+            });
+            if (!is_visited)
+                missed_count++;
+        }
+
+        const bool is_passed = depth <= rt::bvh::MAX_DEPTH && missed_count == 0;
+        std::println("{} ({} primitives): depth {} (limit {}), {} primitives missed: {}",
+            name, bounds.size(), depth, rt::bvh::MAX_DEPTH, missed_count, is_passed ? "passed" : "FAILED");
+        return is_passed;
+    }
+}
+
+// Main function. Returns non-zero on failure.
+int main() {
+    // Centroids grow 13x per primitive along six half-axes, so every binned SAH split peels off single primitive
+    std::vector<rt::aabb> skewed;
+    for (std::size_t axis = 0; axis < 6; axis++) {
+        float offset = 1e-37f;
+        for (std::size_t i = 0; i < 48; i++, offset *= 13.0f) {
+            const float value = axis < 3 ? offset : -offset;
+            const rt::vec3 center(axis % 3 == 0 ? value : 0.0f, axis % 3 == 1 ? value : 0.0f, axis % 3 == 2 ? value : 0.0f);
+            skewed.push_back(rt::aabb {
+                .min = center - rt::vec3(offset * 1e-3f),
+                .max = center + rt::vec3(offset * 1e-3f),
+            });
+        }
+    }
+
+    // Coincident boxes have no centroid extent to split by
+    const std::vector<rt::aabb> degenerate(4096, rt::aabb {.min = rt::vec3(-1.0f), .max = rt::vec3(1.0f)});
+
+    const bool is_skewed_passed = run_test("skewed", skewed);
+    const bool is_degenerate_passed = run_test("degenerate", degenerate);
+    return is_skewed_passed && is_degenerate_passed ? 0 : 1;
+}
+
+// rt_bvh_test.cpp
@@ -0,0 +1,74 @@
+//! Denoiser quality measurement: mean squared error of low sample count renders against high sample count reference
+
+#include <print>
+
+#include "rt_engine.hpp"
+
+namespace {
+    /// Build test scene: ground, spheres of several materials, area and point lights
+    rt::shape::scene make_scene() {
+        auto ground = std::make_shared<rt::material>(rt::vec3(0.7f, 0.65f, 0.6f));
+        auto red = std::make_shared<rt::material>(rt::vec3(0.8f, 0.2f, 0.1f));
+        auto blue = std::make_shared<rt::material>(rt::vec3(0.1f, 0.2f, 0.8f));
+        auto grey = std::make_shared<rt::material>(rt::vec3(0.6f));
+
+        rt::shape::scene scene;
+        scene
+            << std::make_shared<rt::shape::plane>(rt::vec3(0.0f, -1.0f, 0.0f), rt::vec3(0.0f, 1.0f, 0.0f), ground)
+            << std::make_shared<rt::shape::sphere>(rt::vec3(0.0f), 1.0f, red)
+            << std::make_shared<rt::shape::sphere>(rt::vec3(1.6f, -0.5f, 0.5f), 0.5f, grey)
+            << std::make_shared<rt::shape::sphere>(rt::vec3(-1.8f, -0.3f, -0.6f), 0.7f, blue)
+            ;
+        scene.add_light(rt::light::sphere(rt::vec3(2.0f, 4.0f, 3.0f), 0.5f, rt::vec3(40.0f)));
+        scene.add_light(rt::light::point(rt::vec3(-3.0f, 2.0f, 1.0f), rt::vec3(6.0f, 5.0f, 4.0f)));
+        return scene;
+    }
+}
+
+// Main function. Options: `--threads <count>` (hardware-dependent by default), `--size <width> <height>` (160x120 by default),
+// `--reference <samples>` (reference sample count, 1024 by default), `--bounces <count>` (diffuse bounces, 2 by default)
+int main(int argc, char **argv) {
+    std::size_t thread_count = 0, width = 160, height = 120;
+    std::uint32_t reference_samples = 1024, bounces = 2;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string_view(argv[i]) == "--threads")
+            thread_count = std::strtoull(argv[i + 1], nullptr, 10);
+        if (std::string_view(argv[i]) == "--size" && i + 2 < argc) {
+            width = std::strtoull(argv[i + 1], nullptr, 10);
+            height = std::strtoull(argv[i + 2], nullptr, 10);
+        }
+        if (std::string_view(argv[i]) == "--reference")
+            reference_samples = std::strtoul(argv[i + 1], nullptr, 10);
+        if (std::string_view(argv[i]) == "--bounces")
+            bounces = std::strtoul(argv[i + 1], nullptr, 10);
+    }
+
+    rt::engine engine {make_scene(), rt::environment_map::bake(rt::engine::default_sky_trace), thread_count};
+    engine.set_render_resolution(0, 0);
+    rt::render_settings settings = engine.get_render_settings();
+    settings.max_bounces = bounces;
+    engine.set_render_settings(settings);
+
+    const rt::camera camera = rt::camera::from_loc_dir_up(rt::vec3(0.0f, 1.0f, 5.0f), rt::vec3(0.0f, -0.2f, -1.0f).normalized(), rt::vec3(0.0f, 1.0f, 0.0f));
+
+    const auto start = std::chrono::steady_clock::now();
+    const std::optional<rt::image> reference = engine.render(camera, width, height, reference_samples).get();
+    if (!reference.has_value())
+        return 1;
+    std::println("reference {}x{} at {} spp: {:.2f} s", width, height, reference_samples,
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+    for (std::uint32_t samples : {1u, 4u, 16u, 64u}) {
+        const std::optional<rt::image> noisy = engine.render(camera, width, height, samples).get();
+        const std::optional<rt::image> denoised = engine.render(camera, width, height, samples, 1.0f, rt::denoiser::settings {}).get();
+        if (!noisy.has_value() || !denoised.has_value())
+            return 1;
+
+        const float noisy_error = noisy->mean_squared_error(*reference);
+        const float denoised_error = denoised->mean_squared_error(*reference);
+        std::println("{:2} spp: MSE {:.6f} noisy, {:.6f} denoised ({:.2f}x lower)", samples, noisy_error, denoised_error, noisy_error / denoised_error);
+    }
+    return 0;
+}
+
+// rt_denoise_quality.cpp
@@ -0,0 +1,126 @@
+//! Frame export latency benchmark: engine process publishes frames, forked consumer process observes them
+
+#include <print>
+
+#include <sys/wait.h>
+
+#include "rt_engine.hpp"
+
+namespace {
+    /// Print distribution of durations
+    void print_distribution(std::string_view name, std::vector<double> values) {
+        if (values.empty()) {
+            std::println("{}: no data", name);
+            return;
+        }
+
+        std::sort(values.begin(), values.end());
+        auto percentile = [&](double p) { return values[std::min<std::size_t>((std::size_t)(p * values.size()), values.size() - 1)]; };
+        std::println("{}: p50 {:.1f} us, p99 {:.1f} us, max {:.1f} us", name, percentile(0.5), percentile(0.99), values.back());
+    }
+
+    /// Consumer process: busy-polls ring and measures time from publication to observation
+    int run_consumer(const std::string &name, std::uint64_t frame_count) {
+        std::unique_ptr<rt::frame_export> ring = rt::frame_export::open(name);
+        if (ring == nullptr)
+            return 1;
+
+        std::vector<double> observe_latencies, read_latencies;
+        std::uint64_t last_sequence = 0, torn_count = 0, checksum = 0;
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+
+        while (last_sequence < frame_count && std::chrono::steady_clock::now() < deadline) {
+            const std::uint64_t sequence = ring->get_latest_sequence();
+            if (sequence == last_sequence) {
+                std::this_thread::yield();
+                continue;
+            }
+            last_sequence = sequence;
+
+            const auto observe_time = std::chrono::steady_clock::now();
+            const std::optional<rt::frame_export::frame> frame = ring->get_frame(sequence);
+            if (!frame.has_value()) {
+                torn_count++;
+                continue;
+            }
+
+            // Touch every pixel, as encoder would
+            for (std::size_t y = 0; y < frame->height; y++) {
+                const std::byte *row = frame->data + y * frame->pitch;
+                for (std::size_t x = 0; x < frame->width * rt::frame_export::BYTES_PER_PIXEL; x += 4)
+                    checksum += std::to_integer<std::uint64_t>(row[x]);
+            }
+            if (!ring->is_frame_valid(*frame)) {
+                torn_count++;
+                continue;
+            }
+
+            observe_latencies.push_back(std::chrono::duration<double, std::micro>(observe_time - frame->publish_time).count());
+            read_latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - frame->publish_time).count());
+        }
+
+        std::println("consumer: {} frames read, {} torn (checksum {})", observe_latencies.size(), torn_count, checksum);
+        print_distribution("publish -> observed", std::move(observe_latencies));
+        print_distribution("publish -> frame read", std::move(read_latencies));
+        return 0;
+    }
+}
+
+// Main function. Options: `--width <w>`, `--height <h>` (frame size, 1280x720 by default),
+// `--frames <count>` (300 by default), `--interval <ms>` (time between published frames, 10 by default)
+int main(int argc, char **argv) {
+    std::size_t width = 1280, height = 720;
+    std::uint64_t frame_count = 300;
+    std::uint64_t interval = 10;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string_view(argv[i]) == "--width")
+            width = std::strtoull(argv[i + 1], nullptr, 10);
+        if (std::string_view(argv[i]) == "--height")
+            height = std::strtoull(argv[i + 1], nullptr, 10);
+        if (std::string_view(argv[i]) == "--frames")
+            frame_count = std::strtoull(argv[i + 1], nullptr, 10);
+        if (std::string_view(argv[i]) == "--interval")
+            interval = std::strtoull(argv[i + 1], nullptr, 10);
+    }
+
+    const std::string name = std::format("/cpprt_export_benchmark_{}", getpid());
+    std::unique_ptr<rt::frame_export> ring = rt::frame_export::create(name, width, height);
+    if (ring == nullptr) {
+        std::println("Ring creation failed");
+        return 1;
+    }
+
+    // Consumer is forked before engine starts its threads
+    const pid_t consumer = fork();
+    if (consumer == 0)
+        return run_consumer(name, frame_count);
+
+    auto material = std::make_shared<rt::material>(rt::vec3(0.6f, 0.6f, 0.6f));
+    rt::shape::scene scene;
+    scene
+        << std::make_unique<rt::shape::sphere>(rt::vec3(0.0f), 1.0f, material)
+        << std::make_unique<rt::shape::plane>(rt::vec3(0.0f, -1.0f, 0.0f), rt::vec3(0.0f, 1.0f, 0.0f), material)
+        ;
+
+    rt::engine engine {std::move(scene)};
+    engine.set_render_resolution(width, height);
+    engine.set_camera(rt::camera::from_loc_dir_up(rt::vec3(0.0f, 1.0f, 5.0f), rt::vec3(0.0f, -0.2f, -1.0f).normalized(), rt::vec3(0.0f, 1.0f, 0.0f)));
+
+    std::vector<double> export_times;
+    for (std::uint64_t i = 0; i < frame_count; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+
+        const auto start = std::chrono::steady_clock::now();
+        engine.export_frame(*ring);
+        export_times.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    int status = 0;
+    waitpid(consumer, &status, 0);
+
+    std::println("producer: {} frames of {}x{}", frame_count, width, height);
+    print_distribution("export (resolve + publish)", std::move(export_times));
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+// rt_export_benchmark.cpp
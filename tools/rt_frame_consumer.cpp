@@ -0,0 +1,121 @@
+//! Sample consumer of frames exported by `cpprt --export <name>`
+
+#include <print>
+
+#include "rt_frame_export.hpp"
+#include "rt_capture.hpp"
+
+// Main function. Usage: `rt_frame_consumer <name> [--frames <count>] [--save <path>]`,
+// reads frames as they are published and reports rate, latency and drops every second.
+// `--save` writes the last consumed frame to image file on exit.
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::println("Usage: {} <name> [--frames <count>] [--save <path>]", argv[0]);
+        return 1;
+    }
+
+    std::uint64_t frame_limit = ~0ull;
+    std::string save_path;
+    for (int i = 2; i + 1 < argc; i++) {
+        if (std::string_view(argv[i]) == "--frames")
+            frame_limit = std::strtoull(argv[i + 1], nullptr, 10);
+        if (std::string_view(argv[i]) == "--save")
+            save_path = argv[i + 1];
+    }
+
+    // Producer may not be started yet
+    std::unique_ptr<rt::frame_export> ring;
+    while ((ring = rt::frame_export::open(argv[1])) == nullptr)
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::println("Opened {}: up to {}x{}, {} slots", argv[1], ring->get_max_width(), ring->get_max_height(), ring->get_slot_count());
+
+    std::uint64_t last_sequence = ring->get_latest_sequence();
+    std::uint64_t consumed_count = 0;
+    std::uint64_t checksum = 0;
+    rt::image last_frame;
+
+    // Per-report statistics
+    std::uint64_t report_count = 0, report_dropped = 0, report_torn = 0;
+    std::chrono::nanoseconds report_latency {0}, report_max_latency {0};
+    std::uint32_t report_samples = 0;
+    auto report_start = std::chrono::steady_clock::now();
+
+    while (consumed_count < frame_limit) {
+        const std::uint64_t sequence = ring->get_latest_sequence();
+        if (sequence == last_sequence) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            continue;
+        }
+
+        // Frames between the last consumed and the latest one are skipped
+        report_dropped += sequence - last_sequence - 1;
+        last_sequence = sequence;
+
+        const std::optional<rt::frame_export::frame> frame = ring->get_frame(sequence);
+        if (!frame.has_value()) {
+            report_torn++;
+            continue;
+        }
+        const std::chrono::nanoseconds latency = std::chrono::steady_clock::now() - frame->publish_time;
+
+        // Frame is used in place, real consumer would hand rows to encoder or compositor here
+        std::uint64_t frame_checksum = 0;
+        for (std::size_t y = 0; y < frame->height; y++) {
+            const std::byte *row = frame->data + y * frame->pitch;
+            for (std::size_t x = 0; x < frame->width; x += 16)
+                frame_checksum += std::to_integer<std::uint64_t>(row[x * rt::frame_export::BYTES_PER_PIXEL]);
+        }
+
+        if (!save_path.empty()) {
+            rt::image converted {frame->width, frame->height};
+            for (std::size_t y = 0; y < frame->height; y++)
+                for (std::size_t x = 0; x < frame->width; x++) {
+                    const std::byte *pixel = frame->data + y * frame->pitch + x * rt::frame_export::BYTES_PER_PIXEL;
+                    converted.set(x, y, rt::vec3(
+                        std::to_integer<int>(pixel[2]) / 255.0f,
+                        std::to_integer<int>(pixel[1]) / 255.0f,
+                        std::to_integer<int>(pixel[0]) / 255.0f
+                    ));
+                }
+            if (ring->is_frame_valid(*frame))
+                last_frame = std::move(converted);
+        }
+
+        // Frame was overwritten while it was read
+        if (!ring->is_frame_valid(*frame)) {
+            report_torn++;
+            continue;
+        }
+
+        checksum += frame_checksum;
+        consumed_count++;
+        report_count++;
+        report_latency += latency;
+        report_max_latency = std::max(report_max_latency, latency);
+        report_samples = frame->sample_count;
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now - report_start >= std::chrono::seconds(1)) {
+            std::println("{} frames/s, latency {:.1f} us mean / {:.1f} us max, {} dropped, {} torn, {} spp",
+                report_count,
+                std::chrono::duration<double, std::micro>(report_latency).count() / report_count,
+                std::chrono::duration<double, std::micro>(report_max_latency).count(),
+                report_dropped,
+                report_torn,
+                report_samples
+            );
+            report_count = report_dropped = report_torn = 0;
+            report_latency = report_max_latency = std::chrono::nanoseconds(0);
+            report_start = now;
+        }
+    }
+
+    std::println("Consumed {} frames (checksum {})", consumed_count, checksum);
+    if (!save_path.empty() && last_frame.get_width() != 0) {
+        rt::frame_writer writer;
+        writer.submit(std::move(last_frame), save_path);
+    }
+    return 0;
+}
+
+// rt_frame_consumer.cpp
@@ -0,0 +1,97 @@
+//! Golden image regression test: deterministic renders must match at any thread count and match checked-in hashes
+
+#include <print>
+
+#include "rt_engine.hpp"
+
+namespace {
+    /// Frame hashes of deterministic renders (per-pixel and wavefront mode), `--update` prints new ones.
+    /// Both modes do the same arithmetic per path, so they match. Hashes depend on floating-point
+    /// code generation, they are recorded with x86-64 SSE2 build (no FMA contraction) without RT_FAST_MATH.
+    constexpr std::uint64_t GOLDEN_HASHES[2] = {
+        0xcb9997d889a5aef6ull,
+        0xcb9997d889a5aef6ull,
+    };
+
+    /// Build test scene: textured ground, spheres of several materials and two lights
+    rt::shape::scene make_scene() {
+        std::vector<rt::vec3> checker(64 * 64);
+        for (std::size_t y = 0; y < 64; y++)
+            for (std::size_t x = 0; x < 64; x++)
+                checker[y * 64 + x] = (x / 8 + y / 8) % 2 == 0 ? rt::vec3(0.9f) : rt::vec3(0.2f);
+
+        auto ground = std::make_shared<rt::material>(rt::vec3(0.8f, 0.7f, 0.6f), std::make_shared<rt::texture>(checker, 64, 64));
+        auto red = std::make_shared<rt::material>(rt::vec3(0.8f, 0.2f, 0.1f));
+        auto grey = std::make_shared<rt::material>(rt::vec3(0.6f));
+
+        rt::shape::scene scene;
+        scene
+            << std::make_shared<rt::shape::plane>(rt::vec3(0.0f, -1.0f, 0.0f), rt::vec3(0.0f, 1.0f, 0.0f), ground)
+            << std::make_shared<rt::shape::sphere>(rt::vec3(0.0f), 1.0f, red)
+            << std::make_shared<rt::shape::sphere>(rt::vec3(1.6f, -0.5f, 0.5f), 0.5f, grey)
+            << std::make_shared<rt::shape::sphere>(rt::vec3(-1.8f, -0.3f, -0.6f), 0.7f, grey)
+            ;
+        scene.add_light(rt::light::sphere(rt::vec3(2.0f, 4.0f, 3.0f), 0.5f, rt::vec3(40.0f)));
+        scene.add_light(rt::light::point(rt::vec3(-3.0f, 2.0f, 1.0f), rt::vec3(6.0f, 5.0f, 4.0f)));
+        return scene;
+    }
+
+    /// Render test frame with `thread_count` rendering threads, returns hash of its pixels
+    std::uint64_t render_hash(rt::render_mode mode, std::size_t thread_count) {
+        rt::engine engine {make_scene(), rt::environment_map::bake(rt::engine::default_sky_trace), thread_count};
+        engine.set_render_resolution(0, 0);
+        engine.set_render_settings(rt::render_settings {
+            .mode = mode,
+            .max_bounces = 2,
+            .is_deterministic = true,
+            .seed = 46,
+        });
+
+        const rt::camera camera = rt::camera::from_loc_dir_up(rt::vec3(0.0f, 1.0f, 5.0f), rt::vec3(0.0f, -0.2f, -1.0f).normalized(), rt::vec3(0.0f, 1.0f, 0.0f));
+        const std::optional<rt::image> frame = engine.render(camera, 96, 64, 4).get();
+        if (!frame.has_value())
+            return 0;
+
+        rt::hasher h;
+        for (std::size_t y = 0; y < frame->get_height(); y++)
+            for (rt::vec3 pixel : frame->get_row(y))
+                h.add(pixel);
+        return h.get();
+    }
+}
+
+// Main function. Options: `--threads <count>` (thread count compared with single thread, 4 by default),
+// `--update` (print hashes to be checked in instead of failing on mismatch). Returns non-zero on failure.
+int main(int argc, char **argv) {
+    std::size_t thread_count = 4;
+    bool is_update = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::string_view(argv[i]) == "--threads" && i + 1 < argc)
+            thread_count = std::strtoull(argv[i + 1], nullptr, 10);
+        if (std::string_view(argv[i]) == "--update")
+            is_update = true;
+    }
+
+    bool is_passed = true;
+    for (const auto &[index, mode, name] : {
+        std::tuple {0, rt::render_mode::per_pixel, "per_pixel"},
+        std::tuple {1, rt::render_mode::wavefront, "wavefront"},
+    }) {
+        const std::uint64_t single_hash = render_hash(mode, 1);
+        const std::uint64_t parallel_hash = render_hash(mode, std::max<std::size_t>(thread_count, 2));
+
+        if (single_hash != parallel_hash) {
+            std::println("{}: FAILED, 1 thread gives {:016x}, {} threads give {:016x}", name, single_hash, thread_count, parallel_hash);
+            is_passed = false;
+        } else if (is_update)
+            std::println("{}: 0x{:016x}ull", name, single_hash);
+        else if (single_hash != GOLDEN_HASHES[index]) {
+            std::println("{}: FAILED, hash {:016x} doesn't match golden {:016x}", name, single_hash, GOLDEN_HASHES[index]);
+            is_passed = false;
+        } else
+            std::println("{}: passed", name);
+    }
+    return is_passed ? 0 : 1;
+}
+
+// rt_golden_test.cpp
@@ -0,0 +1,166 @@
+//! SSE vector accuracy test against generic vector template, normalization and rendering benchmark
+
+#include <print>
+
+#include "rt_engine.hpp"
+
+namespace {
+    /// Float wrapper, so `math::vec3<scalar_float>` is generic template that does exactly the same float arithmetic
+    struct scalar_float {
+        /// Construct from float
+        scalar_float(float value = 0.0f): value(value) {
+
+        }
+
+        /// Convert to float (all arithmetic is done by float operators)
+        operator float() const noexcept {
+            return value;
+        }
+
+        /// Wrapped value
+        float value;
+    };
+
+    /// Generic vector of floats
+    using scalar_vec3 = rt::math::vec3<scalar_float>;
+
+    /// Convert to generic vector
+    scalar_vec3 to_scalar(rt::vec3 v) {
+        return scalar_vec3(v.x, v.y, v.z);
+    }
+
+    /// Check if vector components are bit-identical
+    bool is_identical(rt::vec3 a, scalar_vec3 b) {
+        return std::bit_cast<std::uint32_t>(a.x) == std::bit_cast<std::uint32_t>((float)b.x)
+            && std::bit_cast<std::uint32_t>(a.y) == std::bit_cast<std::uint32_t>((float)b.y)
+            && std::bit_cast<std::uint32_t>(a.z) == std::bit_cast<std::uint32_t>((float)b.z);
+    }
+
+    /// Get relative error of `value` against `reference` (maximum over components, relative to reference length)
+    float get_relative_error(rt::vec3 value, scalar_vec3 reference) {
+        const float scale = 1.0f / std::max((float)reference.length(), std::numeric_limits<float>::min());
+        return std::max({
+            std::abs(value.x - reference.x) * scale,
+            std::abs(value.y - reference.y) * scale,
+            std::abs(value.z - reference.z) * scale,
+        });
+    }
+
+    /// Documented relative error bound of `normalized_fast`
+    constexpr float FAST_NORMALIZATION_ERROR = 1e-6f;
+
+    /// Compare SSE vectors with generic ones on random vectors of several magnitudes, returns false on failure
+    bool run_accuracy_test(std::size_t count) {
+        rt::random::xoshiro256pp random {34};
+        std::size_t dot_mismatches = 0, cross_mismatches = 0, normalized_mismatches = 0;
+        float max_fast_error = 0.0f;
+
+        for (std::size_t i = 0; i < count; i++) {
+            const float scale = std::exp2((float)(i % 41) - 20.0f);
+            auto get_vector = [&]() {
+                return rt::vec3(random.next_float() - 0.5f, random.next_float() - 0.5f, random.next_float() - 0.5f) * rt::vec3(scale);
+            };
+            const rt::vec3 a = get_vector(), b = get_vector();
+            const scalar_vec3 sa = to_scalar(a), sb = to_scalar(b);
+
+            if (std::bit_cast<std::uint32_t>(a.dot(b)) != std::bit_cast<std::uint32_t>((float)sa.dot(sb)))
+                dot_mismatches++;
+            if (!is_identical(a.cross(b), sa.cross(sb)))
+                cross_mismatches++;
+            if (!is_identical(a.normalized(), sa.normalized()))
+                normalized_mismatches++;
+            max_fast_error = std::max(max_fast_error, get_relative_error(a.normalized_fast(), sa.normalized()));
+        }
+
+        const bool is_passed = dot_mismatches == 0 && cross_mismatches == 0 && normalized_mismatches == 0
+            && max_fast_error < FAST_NORMALIZATION_ERROR;
+        std::println("accuracy ({} vector pairs): dot {} mismatches, cross {} mismatches, normalized {} mismatches, "
+            "normalized_fast max relative error {:.3f}e-7 (bound 1e-6): {}",
+            count, dot_mismatches, cross_mismatches, normalized_mismatches, max_fast_error * 1e7f, is_passed ? "passed" : "FAILED");
+        return is_passed;
+    }
+
+    /// Best of several runs (in seconds)
+    template <typename function_type>
+    double measure(function_type &&function, int run_count = 5) {
+        double best = std::numeric_limits<double>::infinity();
+        for (int run = 0; run < run_count; run++) {
+            const auto start = std::chrono::steady_clock::now();
+            function();
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    }
+
+    /// Time normalization of vector array by generic, SSE and fast SSE kernels
+    void run_kernel_benchmark(std::size_t count) {
+        rt::random::xoshiro256pp random {35};
+        std::vector<rt::vec3> vectors(count), output(count);
+        std::vector<scalar_vec3> scalar_vectors(count), scalar_output(count);
+        for (std::size_t i = 0; i < count; i++) {
+            vectors[i] = rt::vec3(random.next_float() - 0.5f, random.next_float() - 0.5f, random.next_float() - 0.5f);
+            scalar_vectors[i] = to_scalar(vectors[i]);
+        }
+
+        const double generic = measure([&]() {
+            for (std::size_t i = 0; i < count; i++)
+                scalar_output[i] = scalar_vectors[i].normalized();
+        });
+        const double sse = measure([&]() {
+            for (std::size_t i = 0; i < count; i++)
+                output[i] = vectors[i].normalized();
+        });
+        const double fast = measure([&]() {
+            for (std::size_t i = 0; i < count; i++)
+                output[i] = vectors[i].normalized_fast();
+        });
+
+        std::println("normalization kernel: generic {:.2f} ns, SSE {:.2f} ns, SSE fast {:.2f} ns per vector",
+            generic / count * 1e9, sse / count * 1e9, fast / count * 1e9);
+    }
+
+    /// Time fixed render (primary rays use `normalized_fast` if built with RT_FAST_MATH)
+    void run_render_benchmark(std::size_t thread_count) {
+        auto material = std::make_shared<rt::material>(rt::vec3(0.6f));
+        rt::random::xoshiro256pp random {36};
+        rt::shape::scene scene;
+        for (int i = 0; i < 50; i++)
+            scene << std::make_shared<rt::shape::sphere>(
+                rt::vec3(random.next_float() * 8.0f - 4.0f, random.next_float() * 4.0f - 1.0f, random.next_float() * 8.0f - 8.0f),
+                0.2f + 0.4f * random.next_float(),
+                material
+            );
+        scene << std::make_shared<rt::shape::plane>(rt::vec3(0.0f, -1.0f, 0.0f), rt::vec3(0.0f, 1.0f, 0.0f), material);
+
+        rt::engine engine {std::move(scene), rt::environment_map::bake(rt::engine::default_sky_trace), thread_count};
+        engine.set_render_resolution(0, 0);
+
+        const double seconds = measure([&]() { engine.render(rt::camera {}, 640, 480, 16).get(); }, 3);
+        std::println("render 640x480 at 16 spp ({}): {:.3f} s", rt::IS_FAST_MATH ? "RT_FAST_MATH" : "exact normalization", seconds);
+    }
+}
+
+// Main function. Runs accuracy test (returns non-zero on failure), `--benchmark` times normalization kernel
+// and fixed render too (build `rt_math_test_fast` variant to compare rendering with RT_FAST_MATH).
+// Options: `--count <count>` (tested vector pairs, 2^20 by default), `--threads <count>` (rendering threads, 1 by default).
+int main(int argc, char **argv) {
+    std::size_t count = 1 << 20, thread_count = 1;
+    bool is_benchmark = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::string_view(argv[i]) == "--count" && i + 1 < argc)
+            count = std::strtoull(argv[i + 1], nullptr, 10);
+        if (std::string_view(argv[i]) == "--threads" && i + 1 < argc)
+            thread_count = std::strtoull(argv[i + 1], nullptr, 10);
+        if (std::string_view(argv[i]) == "--benchmark")
+            is_benchmark = true;
+    }
+
+    const bool is_passed = run_accuracy_test(count);
+    if (is_benchmark) {
+        run_kernel_benchmark(count);
+        run_render_benchmark(thread_count);
+    }
+    return is_passed ? 0 : 1;
+}
+
+// rt_math_test.cpp
@@ -0,0 +1,95 @@
+//! Batched ray query benchmark: coherent and incoherent batches against single-ray queries
+
+#include <print>
+
+#include "rt_engine.hpp"
+
+namespace {
+    /// Best of several runs (in seconds)
+    template <typename function_type>
+    double measure(function_type &&function, int run_count = 3) {
+        double best = std::numeric_limits<double>::infinity();
+        for (int run = 0; run < run_count; run++) {
+            const auto start = std::chrono::steady_clock::now();
+            function();
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    }
+}
+
+// Main function. Options: `--threads <count>` (hardware-dependent by default),
+// `--objects <count>` (spheres in scene, 20000 by default), `--rays <count>` (batch size, 2^20 by default)
+int main(int argc, char **argv) {
+    std::size_t thread_count = 0, object_count = 20000, ray_count = 1 << 20;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string_view(argv[i]) == "--threads")
+            thread_count = std::strtoull(argv[i + 1], nullptr, 10);
+        if (std::string_view(argv[i]) == "--objects")
+            object_count = std::strtoull(argv[i + 1], nullptr, 10);
+        if (std::string_view(argv[i]) == "--rays")
+            ray_count = std::strtoull(argv[i + 1], nullptr, 10);
+    }
+
+    // Spheres scattered in 40^3 box above ground plane
+    constexpr float EXTENT = 20.0f;
+    rt::random::xoshiro256pp random {47};
+    auto get_point = [&]() {
+        return rt::vec3(random.next_float(), random.next_float(), random.next_float()) * rt::vec3(2.0f * EXTENT) - rt::vec3(EXTENT);
+    };
+
+    auto material = std::make_shared<rt::material>(rt::vec3(0.5f));
+    rt::shape::scene scene;
+    for (std::size_t i = 0; i < object_count; i++)
+        scene << std::make_shared<rt::shape::sphere>(get_point(), 0.2f + 0.3f * random.next_float(), material);
+    scene << std::make_shared<rt::shape::plane>(rt::vec3(0.0f, -EXTENT - 5.0f, 0.0f), rt::vec3(0.0f, 1.0f, 0.0f), material);
+    scene.commit();
+
+    // Coherent batch is camera grid, incoherent one connects random point pairs (occlusion stops at the second point)
+    const std::size_t grid_size = (std::size_t)std::sqrt((double)ray_count);
+    std::vector<rt::ray> coherent(ray_count), incoherent(ray_count);
+    std::vector<float> distances(ray_count);
+    for (std::size_t i = 0; i < ray_count; i++) {
+        const rt::vec3 direction((float)(i % grid_size) / grid_size - 0.5f, (float)(i / grid_size) / grid_size - 0.5f, -1.0f);
+        coherent[i] = rt::ray {rt::vec3(0.0f, 0.0f, EXTENT + 10.0f), direction.normalized()};
+
+        const rt::vec3 origin = get_point(), target = get_point();
+        incoherent[i] = rt::ray {origin, (target - origin).normalized()};
+        distances[i] = (target - origin).length();
+    }
+
+    rt::engine engine {scene, rt::environment_map::bake(rt::engine::default_sky_trace), thread_count};
+    engine.set_render_resolution(0, 0);
+
+    std::vector<rt::ray_hit> hits(ray_count);
+    std::vector<std::uint8_t> occluded(ray_count);
+
+    for (const auto &[name, rays, max_distances] : {
+        std::tuple {"coherent", std::span<const rt::ray>(coherent), std::span<const float>()},
+        std::tuple {"incoherent", std::span<const rt::ray>(incoherent), std::span<const float>(distances)},
+    }) {
+        const double single_closest = measure([&]() {
+            for (std::size_t i = 0; i < rays.size(); i++) {
+                rt::intersection intr;
+                hits[i].distance = scene.intersect(rays[i], intr) ? intr.distance : rt::intersection::INF_DISTANCE;
+            }
+        });
+        const double single_occluded = measure([&]() {
+            for (std::size_t i = 0; i < rays.size(); i++)
+                occluded[i] = scene.check_intersection(rays[i], max_distances.empty() ? rt::intersection::INF_DISTANCE : max_distances[i]);
+        });
+        const double batch_closest = measure([&]() { engine.intersect_batch(rays, hits); });
+        const double batch_occluded = measure([&]() { engine.occluded_batch(rays, max_distances, occluded); });
+
+        std::println("{}: closest hit {:.2f} Mq/s single, {:.2f} Mq/s batch; occlusion {:.2f} Mq/s single, {:.2f} Mq/s batch",
+            name,
+            rays.size() / single_closest * 1e-6,
+            rays.size() / batch_closest * 1e-6,
+            rays.size() / single_occluded * 1e-6,
+            rays.size() / batch_occluded * 1e-6
+        );
+    }
+    return 0;
+}
+
+// rt_ray_query_benchmark.cpp